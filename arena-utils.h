@@ -0,0 +1,122 @@
+#ifndef ARENA_UTILS_H
+#define ARENA_UTILS_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output-utils.h"
+
+/* STATEMENT ARENA: everything that only lives while one statement is parsed and executed
+ * (string literals read by the lexer, the syntax tree, intermediate strings of an expression)
+ * is carved out of a chain of large blocks by bumping a pointer, and is never freed one by one.
+ * Once the statement has completed the whole arena is reset by moving the pointer back to the
+ * first block, so the blocks are reused by the next statements and memory stays flat however
+ * long the session is. Anything that must outlive the statement, like a string assigned to a
+ * variable, has to be copied to the heap first.*/
+struct arena_block{
+    struct arena_block *next;
+    size_t size;
+    char data[];
+};
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* position of the arena, to give back everything allocated after it (see arenaRelease)*/
+struct arena_mark{
+    struct arena_block *block;
+    char *next;
+    char *end;
+};
+
+/*Arena function prototypes*/
+void *arenaAlloc(size_t size);
+char *arenaCopy(const char *chars, size_t length);
+void arenaReset();
+struct arena_mark arenaMark();
+void arenaRelease(struct arena_mark mark);
+void arenaGrow(size_t size);
+void releaseArena();
+
+// returns size bytes (aligned to 8) valid until the next reset
+void *arenaAlloc(size_t size){
+    size = (size + 7) & ~(size_t)7;
+    countArenaAllocation(size);
+    if (session->arenaNext == NULL || (size_t)(session->arenaEnd - session->arenaNext) < size){
+        arenaGrow(size);
+    }
+    void *memory = session->arenaNext;
+    session->arenaNext += size;
+    return memory;
+}
+
+// null-terminated copy of the given characters
+char *arenaCopy(const char *chars, size_t length){
+    char *copy = (char *)arenaAlloc(length + 1);
+    memcpy(copy, chars, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/* releases everything allocated since the last reset, in constant time*/
+void arenaReset(){
+    session->arenaCurrent = session->arenaFirst;
+    if (session->arenaFirst != NULL){
+        session->arenaNext = session->arenaFirst->data;
+        session->arenaEnd = session->arenaFirst->data + session->arenaFirst->size;
+    }
+}
+
+// current position of the arena
+struct arena_mark arenaMark(){
+    struct arena_mark mark = {session->arenaCurrent, session->arenaNext, session->arenaEnd};
+    return mark;
+}
+
+/* releases everything allocated since the mark was taken, keeping what was allocated before it:
+ * loops release the memory used by every iteration before starting the next one (see vm-utils.h)*/
+void arenaRelease(struct arena_mark mark){
+    session->arenaCurrent = mark.block;
+    session->arenaNext = mark.next;
+    session->arenaEnd = mark.end;
+}
+
+/* moves on to the next block that can hold size bytes, reusing the blocks of previous statements
+ * and allocating a new one (linked after the current block) only when none of them is large enough*/
+void arenaGrow(size_t size){
+    struct arena_block *block = session->arenaCurrent != NULL ? session->arenaCurrent->next : session->arenaFirst;
+    if (block == NULL || block->size < size){
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        struct arena_block *newBlock = (struct arena_block *)malloc(sizeof(struct arena_block) + blockSize);
+        countAllocation(sizeof(struct arena_block) + blockSize);
+        if (newBlock == NULL){
+            printError("Error: could not allocate memory for the statement arena!\n");
+            sessionExit(1);
+        }
+        newBlock->size = blockSize;
+        newBlock->next = block;
+        if (session->arenaCurrent != NULL){
+            session->arenaCurrent->next = newBlock;
+        } else {
+            session->arenaFirst = newBlock;
+        }
+        block = newBlock;
+    }
+    session->arenaCurrent = block;
+    session->arenaNext = block->data;
+    session->arenaEnd = block->data + block->size;
+}
+
+// gives every block back to the system, when the session ends
+void releaseArena(){
+    struct arena_block *block = session->arenaFirst;
+    while (block != NULL){
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    session->arenaFirst = session->arenaCurrent = NULL;
+    session->arenaNext = session->arenaEnd = NULL;
+}
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef ARITHMETIC_UTILS_H
+#define ARITHMETIC_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "symboltable-utils.h"
+#include "ast-utils.h"
+
+/* EXTENDED ARITHMETIC FUNCTIONS
+ * implementation of the four basic operations as well as the increase/decrease operator and string concatenation.
+ * Instead of testing the types of the operands on every operation, every combination of operator and operand
+ * types has its own specialised kernel, generated by the macros below, and the kernels are collected in
+ * dispatch tables indexed by (operator, type of the left operand, type of the right operand).
+ * Performing an operation is therefore a single indirect call.
+ * All kernels follow the same rules:
+ * - integers are computed on 64 bits and checked for overflow, falling back to big integers (see integer-utils.h)
+ *   when an operand is big or the result overflows
+ * - integers are promoted to doubles when the other operand is a double
+ * - an undefined operand counts as 0 of the type of the other operand
+ * - when both operands are undefined, or the operation is not possible, the result is undefined
+ * - adding a string and anything else concatenates the two
+ * - dividing by 0 is reported and gives an undefined result*/
+enum{
+    TYPE_COUNT = 4,             // UNDEFINED_TYPE, INTEGER_TYPE, DOUBLE_TYPE, STRING_TYPE
+    ARITHMETIC_OPERATORS = 4,   // ADD_OP, SUB_OP, MUL_OP, DIV_OP
+    UNARY_OPERATORS = 2         // INC_OP, DEC_OP
+};
+
+typedef struct variable (*binary_kernel)(struct variable n1, struct variable n2);
+typedef struct variable (*unary_kernel)(struct variable n);
+
+/*Arithmetic function prototypes*/
+struct variable sumOrConcat(struct variable n1, struct variable n2);
+struct variable sub(struct variable n1, struct variable n2);
+struct variable multi(struct variable n1, struct variable n2);
+struct variable divide(struct variable n1, struct variable n2);
+struct variable inc(struct variable n);
+struct variable dec(struct variable n);
+
+/* COMPARISONS: the six comparison operators share a single three-way comparison, see compareValues()*/
+enum ordering{
+    ORDER_LESS, ORDER_EQUAL, ORDER_GREATER, ORDER_UNORDERED
+};
+
+/*truth of every comparison operator (same order as LT_OP ... NEQ_OP, see ast-utils.h) for every ordering*/
+const bool COMPARISON_TRUTH[6][4] = {
+    //less, equal, greater, unordered
+    {true, false, false, false},    // <
+    {false, false, true, false},    // >
+    {true, true, false, false},     // <=
+    {false, true, true, false},     // >=
+    {false, true, false, false},    // ==
+    {true, false, true, true}       // !=
+};
+
+enum ordering compareValues(struct variable n1, struct variable n2);
+bool compareOperation(char op, struct variable n1, struct variable n2);
+
+/* KERNEL GENERATORS*/
+
+// one numeric combination of operand types
+#define NUMERIC_KERNEL(name, operator, make, lhs, rhs) \
+    struct variable name(struct variable n1, struct variable n2){ \
+        return make(lhs operator rhs); \
+    }
+
+// same as NUMERIC_KERNEL, but reporting a division by 0 instead of performing it
+#define DIVISION_KERNEL(name, make, lhs, rhs) \
+    struct variable name(struct variable n1, struct variable n2){ \
+        if (rhs == 0){ \
+            outPrintf("ERROR: cannot divide by 0\n"); \
+            return undefinedValue(); \
+        } \
+        return make(lhs / rhs); \
+    }
+
+/* integer combination of an operator: the 64-bit operation, checked for overflow by the compiler builtin,
+ * when both operands are stored in the value itself and so is the result, the operation on big integers otherwise.
+ * TAG_BIG_INTEGER is TAG_INTEGER with one more bit set, so a single test on both tags tells if either is big.
+ * The fast path calls nothing, and the slow one is a tail call, so the kernel needs no stack frame*/
+#define INTEGER_KERNEL(name, builtin, bigOperation) \
+    struct variable name(struct variable n1, struct variable n2){ \
+        int64_t result; \
+        if (((n1.bits | n2.bits) >> 48) == TAG_INTEGER && !builtin(asInteger(n1), asInteger(n2), &result) \
+            && isSmallInteger(result)){ \
+            return boxValue(TAG_INTEGER, (uint64_t)result & PAYLOAD_MASK); \
+        } \
+        return bigOperation(n1, n2); \
+    }
+
+// the four numeric combinations of an operator
+#define NUMERIC_KERNELS(name, operator, builtin, bigOperation) \
+    INTEGER_KERNEL(name##IntInt, builtin, bigOperation) \
+    NUMERIC_KERNEL(name##IntDouble, operator, doubleValue, integerToDouble(n1), asDouble(n2)) \
+    NUMERIC_KERNEL(name##DoubleInt, operator, doubleValue, asDouble(n1), integerToDouble(n2)) \
+    NUMERIC_KERNEL(name##DoubleDouble, operator, doubleValue, asDouble(n1), asDouble(n2))
+
+#define DIVISION_KERNELS(name) \
+    DIVISION_KERNEL(name##IntDouble, doubleValue, integerToDouble(n1), asDouble(n2)) \
+    DIVISION_KERNEL(name##DoubleInt, doubleValue, asDouble(n1), integerToDouble(n2)) \
+    DIVISION_KERNEL(name##DoubleDouble, doubleValue, asDouble(n1), asDouble(n2))
+
+// combinations with one undefined operand, which is replaced by 0 of the type of the other one
+#define UNDEFINED_KERNELS(name) \
+    struct variable name##UndefinedInt(struct variable n1, struct variable n2){ \
+        return name##IntInt(integerValue(0), n2); \
+    } \
+    struct variable name##UndefinedDouble(struct variable n1, struct variable n2){ \
+        return name##DoubleDouble(doubleValue(0), n2); \
+    } \
+    struct variable name##IntUndefined(struct variable n1, struct variable n2){ \
+        return name##IntInt(n1, integerValue(0)); \
+    } \
+    struct variable name##DoubleUndefined(struct variable n1, struct variable n2){ \
+        return name##DoubleDouble(n1, doubleValue(0)); \
+    }
+
+// combinations with a string operand, for the operators that do not support strings
+#define STRING_ERROR_KERNEL(name, verb) \
+    struct variable name##String(struct variable n1, struct variable n2){ \
+        printError("ERROR: it is not currently possible to " verb " strings\n"); \
+        return undefinedValue(); \
+    }
+
+// the dispatch table of an operator that only supports numbers
+#define NUMERIC_ROWS(name) { \
+    /*                UNDEFINED              INTEGER               DOUBLE                   STRING*/ \
+    /*UNDEFINED*/   { undefinedOperands,     name##UndefinedInt,   name##UndefinedDouble,   name##String }, \
+    /*INTEGER*/     { name##IntUndefined,    name##IntInt,         name##IntDouble,         name##String }, \
+    /*DOUBLE*/      { name##DoubleUndefined, name##DoubleInt,      name##DoubleDouble,      name##String }, \
+    /*STRING*/      { name##String,          name##String,         name##String,            name##String } }
+
+/* KERNELS*/
+
+struct variable undefinedOperands(struct variable n1, struct variable n2){
+    return undefinedValue();
+}
+
+NUMERIC_KERNELS(add, +, __builtin_add_overflow, addIntegers)
+UNDEFINED_KERNELS(add)
+NUMERIC_KERNELS(sub, -, __builtin_sub_overflow, subIntegers)
+UNDEFINED_KERNELS(sub)
+STRING_ERROR_KERNEL(sub, "subtract")
+NUMERIC_KERNELS(mul, *, __builtin_mul_overflow, mulIntegers)
+UNDEFINED_KERNELS(mul)
+STRING_ERROR_KERNEL(mul, "multiply")
+// a big integer is never 0, and small ones are too short to overflow when divided
+struct variable divIntInt(struct variable n1, struct variable n2){
+    if (!isBigInteger(n2) && asInteger(n2) == 0){
+        outPrintf("ERROR: cannot divide by 0\n");
+        return undefinedValue();
+    }
+    if (isBigInteger(n1) || isBigInteger(n2)){
+        return divIntegers(n1, n2);
+    }
+    return integerValue(asInteger(n1) / asInteger(n2));
+}
+DIVISION_KERNELS(div)
+UNDEFINED_KERNELS(div)
+STRING_ERROR_KERNEL(div, "divide")
+
+/*concatenation kernels, numbers are converted to strings first.
+ * A string produced by a previous operation of the same expression is extended in place,
+ * so a chain of concatenations only copies each piece once*/
+struct variable concatStringAny(struct variable n1, struct variable n2){
+    if (isShared(n1)){
+        n1 = copyString(&n1);
+    }
+    appendValue(&n1, &n2);
+    return n1;
+}
+struct variable concatNumberString(struct variable n1, struct variable n2){
+    struct variable result = makeString("", 0);
+    appendValue(&result, &n1);
+    appendValue(&result, &n2);
+    return result;
+}
+struct variable concatStringUndefined(struct variable n1, struct variable n2){
+    return n1;
+}
+struct variable concatUndefinedString(struct variable n1, struct variable n2){
+    return n2;
+}
+
+/*unary kernels*/
+struct variable incInt(struct variable n){
+    return isBigInteger(n) ? addIntegers(n, integerValue(1)) : integerValue(asInteger(n) + 1);
+}
+struct variable incDouble(struct variable n){
+    return doubleValue(asDouble(n) + 1);
+}
+struct variable incUndefined(struct variable n){
+    return integerValue(1);
+}
+struct variable incString(struct variable n){
+    printError("ERROR: it is not currently possible to increment strings\n");
+    return undefinedValue();
+}
+struct variable decInt(struct variable n){
+    return isBigInteger(n) ? subIntegers(n, integerValue(1)) : integerValue(asInteger(n) - 1);
+}
+struct variable decDouble(struct variable n){
+    return doubleValue(asDouble(n) - 1);
+}
+struct variable decUndefined(struct variable n){
+    return integerValue(-1);
+}
+struct variable decString(struct variable n){
+    printError("ERROR: it is not currently possible to decrement strings\n");
+    return undefinedValue();
+}
+
+/* DISPATCH TABLES*/
+
+const binary_kernel arithmeticTable[ARITHMETIC_OPERATORS][TYPE_COUNT][TYPE_COUNT] = {
+    [ADD_OP] = {
+        /*                UNDEFINED              INTEGER               DOUBLE                   STRING*/
+        /*UNDEFINED*/   { undefinedOperands,     addUndefinedInt,      addUndefinedDouble,      concatUndefinedString },
+        /*INTEGER*/     { addIntUndefined,       addIntInt,            addIntDouble,            concatNumberString },
+        /*DOUBLE*/      { addDoubleUndefined,    addDoubleInt,         addDoubleDouble,         concatNumberString },
+        /*STRING*/      { concatStringUndefined, concatStringAny,      concatStringAny,         concatStringAny } },
+    [SUB_OP] = NUMERIC_ROWS(sub),
+    [MUL_OP] = NUMERIC_ROWS(mul),
+    [DIV_OP] = NUMERIC_ROWS(div)
+};
+
+const unary_kernel unaryTable[UNARY_OPERATORS][TYPE_COUNT] = {
+    /*          UNDEFINED     INTEGER  DOUBLE     STRING*/
+    /*INC*/   { incUndefined, incInt,  incDouble, incString },
+    /*DEC*/   { decUndefined, decInt,  decDouble, decString }
+};
+
+/* entry points of the dispatch tables, op is one of ADD_OP ... DIV_OP or INC_OP, DEC_OP*/
+#define BINARY_OPERATION(op, n1, n2) (countOperation(op, n1, n2), arithmeticTable[(int)(op)][(int)valueType(n1)][(int)valueType(n2)]((n1), (n2)))
+#define UNARY_OPERATION(op, n) (unaryTable[(op) - INC_OP][(int)valueType(n)]((n)))
+
+struct variable sumOrConcat(struct variable n1, struct variable n2){
+    return BINARY_OPERATION(ADD_OP, n1, n2);
+}
+
+struct variable sub(struct variable n1, struct variable n2){
+    return BINARY_OPERATION(SUB_OP, n1, n2);
+}
+
+struct variable multi(struct variable n1, struct variable n2){
+    return BINARY_OPERATION(MUL_OP, n1, n2);
+}
+
+struct variable divide(struct variable n1, struct variable n2){
+    return BINARY_OPERATION(DIV_OP, n1, n2);
+}
+
+struct variable inc(struct variable n){
+    return UNARY_OPERATION(INC_OP, n);
+}
+
+struct variable dec(struct variable n){
+    return UNARY_OPERATION(DEC_OP, n);
+}
+
+/* compares two values once, whatever the comparison operator:
+ * - numbers are compared by value, integers exactly (also big ones) and mixed pairs as doubles,
+ *   undefined values count as 0 and two undefined values are equal
+ * - strings are compared by their characters, in the order of their bytes
+ * - a string and a number, or a NaN, are not ordered, so only != holds between them*/
+enum ordering compareValues(struct variable n1, struct variable n2){
+    char type1 = valueType(n1);
+    char type2 = valueType(n2);
+    if (type1 == INTEGER_TYPE && type2 == INTEGER_TYPE){
+        if (isBigInteger(n1) || isBigInteger(n2)){
+            int order = compareIntegers(n1, n2);
+            return order < 0 ? ORDER_LESS : order > 0 ? ORDER_GREATER : ORDER_EQUAL;
+        }
+        int64_t i1 = asInteger(n1);
+        int64_t i2 = asInteger(n2);
+        return i1 < i2 ? ORDER_LESS : i1 > i2 ? ORDER_GREATER : ORDER_EQUAL;
+    }
+    if (type1 == STRING_TYPE || type2 == STRING_TYPE){
+        if (type1 != type2){
+            return ORDER_UNORDERED;
+        }
+        size_t length1 = stringLength(&n1);
+        size_t length2 = stringLength(&n2);
+        int order = memcmp(stringChars(&n1), stringChars(&n2), length1 < length2 ? length1 : length2);
+        if (order == 0){
+            return length1 < length2 ? ORDER_LESS : length1 > length2 ? ORDER_GREATER : ORDER_EQUAL;
+        }
+        return order < 0 ? ORDER_LESS : ORDER_GREATER;
+    }
+    double d1 = type1 == INTEGER_TYPE ? integerToDouble(n1) : type1 == DOUBLE_TYPE ? asDouble(n1) : 0;
+    double d2 = type2 == INTEGER_TYPE ? integerToDouble(n2) : type2 == DOUBLE_TYPE ? asDouble(n2) : 0;
+    return d1 < d2 ? ORDER_LESS : d1 > d2 ? ORDER_GREATER : d1 == d2 ? ORDER_EQUAL : ORDER_UNORDERED;
+}
+
+// whether the comparison operator (LT_OP ... NEQ_OP) holds between the two values
+bool compareOperation(char op, struct variable n1, struct variable n2){
+    return COMPARISON_TRUTH[op - LT_OP][compareValues(n1, n2)];
+}
+
+#endif
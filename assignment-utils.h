@@ -0,0 +1,206 @@
+#ifndef ASSIGNMENT_UTILS_H
+#define ASSIGNMENT_UTILS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "symboltable-utils.h"
+#include "ast-utils.h"
+#include "arithmetic-utils.h"
+#include "binding-utils.h"
+
+/* ASSIGNMENTS: the four forms of assignment (type ID = expr, type ID op= val, ID = expr, ID op= val)
+ * all go through assign(), which takes the declared type (UNDEFINED_TYPE when there is none) and the operator
+ * (ASSIGN_OP for =, ADD_OP ... DIV_OP for the shorthands) as enum values, and works in three steps:
+ * 1. the type of the variable is the one it was declared with, otherwise the one of the statement,
+ *    otherwise the one of the expression; declaring a different type than the variable already has is an error
+ * 2. a shorthand combines the value of the variable with the expression through the arithmetic kernels
+ *    (see arithmetic-utils.h), except += on a string variable, which appends to it in place;
+ *    a shorthand on a variable holding no value simply assigns the expression, with a warning
+ * 3. the result is converted to the type of the variable by the conversion kernel for that pair of types:
+ *    doubles are truncated to integers with a warning, integers become doubles, anything else is an error
+ *    and leaves the variable as it was
+ * Assigning a value to a variable bound to a formula replaces the formula, and the bindings reading the variable
+ * are marked to be computed again (see binding-utils.h).
+ * On a shared table (see shared-utils.h) assignments and declarations hold the write lock, the variable changes
+ * between beginUpdate() and endUpdate(), and += builds a new string rather than growing the one readers may be reading.
+ * Every change is then appended to the journal of the table, when it has one (see journal-utils.h)*/
+typedef bool (*conversion_kernel)(symbol_table *node, char type, struct variable *value);
+
+/*Assignment function prototypes*/
+void assign(symbol_table *node, char declaredType, char op, struct variable expression);
+void applyAssignment(symbol_table *node, char declaredType, char op, struct variable expression);
+void declare(symbol_table *node, char type);
+bool storeValue(symbol_table *node, char type, struct variable result);
+bool storeBig(symbol_table *node, char type, struct variable result);
+void updateBinding(symbol_table *node, struct variable result);
+bool keepValue(symbol_table *node, char type, struct variable *value);
+bool truncateToInteger(symbol_table *node, char type, struct variable *value);
+bool widenToDouble(symbol_table *node, char type, struct variable *value);
+bool typeMismatch(symbol_table *node, char type, struct variable *value);
+bool undefinedResult(symbol_table *node, char type, struct variable *value);
+void journalNode(symbol_table *node);       // defined in journal-utils.h
+
+/*conversion of a result (columns) to the type of the variable (rows)*/
+const conversion_kernel conversionTable[TYPE_COUNT][TYPE_COUNT] = {
+    /*                  UNDEFINED         INTEGER             DOUBLE              STRING*/
+    /*UNDEFINED*/   { undefinedResult,  keepValue,          keepValue,          keepValue },
+    /*INTEGER*/     { undefinedResult,  keepValue,          truncateToInteger,  typeMismatch },
+    /*DOUBLE*/      { undefinedResult,  widenToDouble,      keepValue,          typeMismatch },
+    /*STRING*/      { undefinedResult,  typeMismatch,       typeMismatch,       keepValue }
+};
+
+void assign(symbol_table *node, char declaredType, char op, struct variable expression){
+    lockTable();
+    applyAssignment(node, declaredType, op, expression);
+    unlockTable();
+}
+
+void applyAssignment(symbol_table *node, char declaredType, char op, struct variable expression){
+    char type = node->type_declared ? valueType(node->value) : declaredType;
+    if (declaredType != UNDEFINED_TYPE && type != declaredType){
+        outPrintf("Error: the type of the node does not match the type declared!\n");
+        return;
+    }
+    if (node->binding != NULL){
+        printInfo("Info: %s is no longer bound to its formula\n", node->id);
+        unbind(node);
+    }
+
+    struct variable result = expression;
+    if (op != ASSIGN_OP){
+        if (!node->initialised){
+            printWarning("Warning: the variable you declared was not holding any value! Assigning the value to the variable itself\n");
+        } else if (type == STRING_TYPE && op == ADD_OP && !session->table->shared){
+            appendValue(&node->value, &expression);     // the variable owns its string, so it grows in place
+            invalidate(node);
+            journalNode(node);
+            return;
+        } else {
+            result = BINARY_OPERATION(op, node->value, expression);
+            if (valueType(result) == UNDEFINED_TYPE){
+                return;     // the kernel has already reported the error
+            }
+        }
+    }
+
+    //the new value is only formatted if it is shown, since big integers take a while to format
+    bool updated = node->initialised && op == ASSIGN_OP && declaredType == UNDEFINED_TYPE && !session->quietMode;
+    if (!storeValue(node, type, result)){
+        return;
+    }
+    invalidate(node);
+    journalNode(node);
+    if (updated){
+        char text[NUMBER_TEXT_SIZE];
+        const char *shown = text;
+        if (valueType(node->value) == INTEGER_TYPE){
+            formatIntegerValue(node->value, text, &shown);
+        } else if (valueType(node->value) == DOUBLE_TYPE){
+            formatDouble(text, asDouble(node->value));
+        } else {
+            shown = stringChars(&node->value);
+        }
+        printInfo("Info: Updated variable %s to the new value %s\n", node->id, shown);
+    }
+}
+
+/* converts the result to the type of the variable and stores it, returning false if it could not be converted.
+ * Big integers, which have to be copied to the heap or released, are left to storeBig() before anything else,
+ * so that storing an ordinary value stays as short as it was*/
+bool storeValue(symbol_table *node, char type, struct variable result){
+    if (isBigInteger(result) || isBigInteger(node->value)){
+        return storeBig(node, type, result);
+    }
+    if (!conversionTable[(int)type][(int)valueType(result)](node, type, &result)){
+        return false;
+    }
+    beginUpdate(node);
+    if (valueType(result) == STRING_TYPE){
+        storeString(node, result);
+    } else if (isBigInteger(result)){
+        storeInteger(node, result);     // a double too large for 64 bits, truncated
+    } else {
+        setValue(node, result);
+    }
+    node->type_declared = true;
+    node->initialised = true;
+    endUpdate(node);
+    return true;
+}
+
+// same as storeValue(), when the result or the value the variable held before is a big integer
+bool storeBig(symbol_table *node, char type, struct variable result){
+    if (!conversionTable[(int)type][(int)valueType(result)](node, type, &result)){
+        return false;
+    }
+    beginUpdate(node);
+    if (valueType(result) == STRING_TYPE){
+        storeString(node, result);
+    } else {
+        storeInteger(node, result);
+    }
+    node->type_declared = true;
+    node->initialised = true;
+    endUpdate(node);
+    return true;
+}
+
+/* stores the value just computed by the formula of a bound node, with the same conversions as assignments*/
+void updateBinding(symbol_table *node, struct variable result){
+    storeValue(node, node->type_declared ? valueType(node->value) : UNDEFINED_TYPE, result);
+}
+
+/* gives a type to a variable without a value (type ID)*/
+void declare(symbol_table *node, char type){
+    lockTable();
+    if (!node->type_declared){
+        printInfo("Set the variable type to %s\n", type == INTEGER_TYPE ? "integer" : "double");
+        beginUpdate(node);
+        setValue(node, type == INTEGER_TYPE ? integerValue(0) : doubleValue(0));
+        node->type_declared = true;
+        endUpdate(node);
+        invalidate(node);
+        journalNode(node);
+    } else if (valueType(node->value) != type){
+        outPrintf("Error: the variable you specified is already defined with type %s!\n", varType(node->value));
+    } else {
+        printInfo("Info: the variable you specified is already defined with the same type!\n");
+    }
+    unlockTable();
+}
+
+/* CONVERSION KERNELS: each one returns false when the value cannot be stored in the variable*/
+
+bool keepValue(symbol_table *node, char type, struct variable *value){
+    return true;
+}
+
+bool truncateToInteger(symbol_table *node, char type, struct variable *value){
+    struct variable integer = integerFromDouble(asDouble(*value));
+    if (valueType(integer) == UNDEFINED_TYPE){
+        outPrintf("Error: %s is an integer, but the expression is not a finite number!\n", node->id);
+        return false;
+    }
+    printWarning("Warning: casting double to integer, approximation may occur!\n");
+    *value = integer;
+    return true;
+}
+
+bool widenToDouble(symbol_table *node, char type, struct variable *value){
+    *value = doubleValue(integerToDouble(*value));
+    return true;
+}
+
+bool typeMismatch(symbol_table *node, char type, struct variable *value){
+    static const char *typeNames[] = {"none", "int", "double", "string"};
+    outPrintf("Error: type mismatch! Node %s has type %s, but the expression has type %s instead!\n",
+              node->id, typeNames[(int)type], varType(*value));
+    return false;
+}
+
+bool undefinedResult(symbol_table *node, char type, struct variable *value){
+    outPrintf("Error: the type of the expression could not be recognised!\n");
+    return false;
+}
+
+#endif
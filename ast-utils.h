@@ -0,0 +1,168 @@
+#ifndef AST_UTILS_H
+#define AST_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "symboltable-utils.h"
+#include "arena-utils.h"
+
+/* ABSTRACT SYNTAX TREE: the semantic actions of the grammar no longer compute any result,
+ * they build a tree for every statement, which is then compiled to bytecode and executed
+ * by the virtual machine (see vm-utils.h).
+ * Identifiers are resolved to their symbol-table node while the tree is built, the compiler
+ * then only needs the slot of that node.
+ * Trees are allocated in the statement arena (see arena-utils.h), so they are released together
+ * with everything else the statement allocated.*/
+enum ast_kind{
+    /*expressions and conditions*/
+    AST_VALUE,          // literal value
+    AST_ID,             // value stored in a variable
+    AST_BINARY,         // + - * /
+    AST_UNARY,          // ++ --
+    AST_COMPARE,        // < > <= >= == !=
+    AST_LOGIC,          // && ||
+    AST_CONDITIONAL,    // cond ? expr : expr
+    AST_PARAM,          // parameter of the function being defined
+    AST_CALL,           // ID(expr, ...)
+    /*statements*/
+    AST_PRINT_EXPR,     // expr: prints the result of the expression
+    AST_PRINT_COND,     // cond: prints true or false
+    AST_PRINT_TABLE,    // print
+    AST_PRINT_NODE,     // print ID
+    AST_PRINT_TYPE,     // type ID
+    AST_PRINT_STATS,    // stats
+    AST_IF,             // if (cond) then {"string"}
+    AST_TYPED_ASSIGN,   // type ID = expr
+    AST_TYPED_SHORTHAND,// type ID op= val
+    AST_ASSIGN,         // ID = expr
+    AST_SHORTHAND,      // ID op= val
+    AST_DECLARE,        // type ID
+    AST_WHILE,          // while (cond) {statements}
+    AST_FOR,            // for (ass; cond; ass) {statements}
+    AST_DEFINE,         // def ID(ID, ...) = expr
+    AST_BIND,           // ID := expr
+    AST_SAVE,           // save "file"
+    AST_LOAD            // load "file"
+};
+
+/* operators of expressions, conditions and shorthand assignments*/
+enum ast_operator{
+    ADD_OP, SUB_OP, MUL_OP, DIV_OP,
+    INC_OP, DEC_OP,
+    LT_OP, GT_OP, LEQ_OP, GEQ_OP, EQ_OP, NEQ_OP,
+    AND_OP, OR_OP,
+    ASSIGN_OP           // plain assignments, as opposed to shorthand ones (see assignment-utils.h)
+};
+
+struct ast_node{
+    char kind;                  // one of enum ast_kind
+    char op;                    // one of enum ast_operator, for operators and shorthand assignments
+    char type;                  // declared type (INTEGER_TYPE or DOUBLE_TYPE) for typed assignments
+    struct variable value;      // literal value (AST_VALUE), string to print (AST_IF) or path of a snapshot
+    symbol_table *node;         // resolved identifier
+    struct ast_node *left;      // left operand, the expression/condition of a statement or the first argument of a call
+    struct ast_node *right;     // right operand, the initialisation of a for loop or the parameters of a definition
+    struct ast_node *body;      // first statement of a loop (the step of a for loop is its last statement),
+                                // or the expression of a conditional when the condition is false
+    struct ast_node *next;      // next statement of the same loop, or next argument or parameter
+    char *name;                 // name of a parameter
+    int index;                  // position of a parameter, or index of the function called or defined
+};
+
+/*AST construction function prototypes*/
+struct ast_node *newAstNode(char kind);
+struct ast_node *newValue(struct variable value);
+struct ast_node *newId(symbol_table *node);
+struct ast_node *newOperation(char kind, char op, struct ast_node *left, struct ast_node *right);
+struct ast_node *newStatement(char kind, symbol_table *node, struct ast_node *expression);
+struct ast_node *newConditional(struct ast_node *condition, struct ast_node *whenTrue, struct ast_node *whenFalse);
+struct ast_node *newCall(int function, struct ast_node *arguments);
+struct ast_node *newLoop(char kind, struct ast_node *condition, struct ast_node *body);
+struct ast_node *appendNode(struct ast_node *list, struct ast_node *tree);
+const char *statementName(int kind);
+
+struct ast_node *newAstNode(char kind){
+    struct ast_node *tree = (struct ast_node *)arenaAlloc(sizeof(struct ast_node));
+    memset(tree, 0, sizeof(struct ast_node));
+    tree->kind = kind;
+    return tree;
+}
+
+struct ast_node *newValue(struct variable value){
+    struct ast_node *tree = newAstNode(AST_VALUE);
+    tree->value = value;
+    return tree;
+}
+
+struct ast_node *newId(symbol_table *node){
+    struct ast_node *tree = newAstNode(AST_ID);
+    tree->node = node;
+    return tree;
+}
+
+/* builds a binary or unary operation, comparison or logic connective (right is NULL for unary ones)*/
+struct ast_node *newOperation(char kind, char op, struct ast_node *left, struct ast_node *right){
+    struct ast_node *tree = newAstNode(kind);
+    tree->op = op;
+    tree->left = left;
+    tree->right = right;
+    return tree;
+}
+
+/* builds a statement acting on the given node (if any) with the given expression or condition (if any),
+ * operator and declared type are filled in by the caller when needed*/
+struct ast_node *newStatement(char kind, symbol_table *node, struct ast_node *expression){
+    struct ast_node *tree = newAstNode(kind);
+    tree->node = node;
+    tree->left = expression;
+    return tree;
+}
+
+struct ast_node *newConditional(struct ast_node *condition, struct ast_node *whenTrue, struct ast_node *whenFalse){
+    struct ast_node *tree = newOperation(AST_CONDITIONAL, 0, condition, whenTrue);
+    tree->body = whenFalse;
+    return tree;
+}
+
+// builds a call to the function with the given index (see function-utils.h), arguments are linked by next
+struct ast_node *newCall(int function, struct ast_node *arguments){
+    struct ast_node *tree = newAstNode(AST_CALL);
+    tree->index = function;
+    tree->left = arguments;
+    return tree;
+}
+
+/* builds a loop running the statements of body (a list linked by next) for as long as the condition holds*/
+struct ast_node *newLoop(char kind, struct ast_node *condition, struct ast_node *body){
+    struct ast_node *tree = newAstNode(kind);
+    tree->left = condition;
+    tree->body = body;
+    return tree;
+}
+
+/* appends a statement or an argument to a list linked by next (NULL when empty) and returns the list*/
+struct ast_node *appendNode(struct ast_node *list, struct ast_node *tree){
+    if (list == NULL){
+        return tree;
+    }
+    struct ast_node *last = list;
+    while (last->next != NULL){
+        last = last->next;
+    }
+    last->next = tree;
+    return list;
+}
+
+// name of a statement kind, as reported by the statistics (see stats-utils.h)
+const char *statementName(int kind){
+    static const char *names[] = {
+        "value", "id", "binary", "unary", "compare", "logic", "conditional", "parameter", "call",
+        "expression", "condition", "print", "print_id", "type", "stats", "if",
+        "typed_assignment", "typed_shorthand", "assignment", "shorthand", "declaration",
+        "while", "for", "definition", "binding", "save", "load"
+    };
+    return kind >= 0 && kind < (int)(sizeof(names) / sizeof(names[0])) ? names[kind] : "unknown";
+}
+
+#endif
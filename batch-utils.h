@@ -0,0 +1,213 @@
+#ifndef BATCH_UTILS_H
+#define BATCH_UTILS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "session-utils.h"
+#include "output-utils.h"
+
+/* BATCH RUNNER: script files are independent of each other, so each one runs in a session of its own
+ * and many of them can run at the same time on a pool of threads.
+ * The scripts are dealt round-robin to the queues of the workers, every worker takes its next script
+ * from the front of its own queue and, once the queue is empty, steals scripts from the back of the
+ * queues of the others, so that a worker stuck on a long script does not hold back the whole batch.
+ * The outputs of the scripts are captured by their sessions and written out in the order of the
+ * arguments as soon as all the scripts before them have completed.
+ * With a single worker the scripts simply run one after the other, writing their output directly.*/
+struct script_run{
+    char *path;
+    struct text_buffer output;
+    struct text_buffer errors;
+    int status;
+    bool done;
+};
+
+/*queue of the scripts (indexes into the runs) assigned to a worker, items[first] to items[last - 1]*/
+struct work_queue{
+    pthread_mutex_t lock;
+    int *items;
+    int first;
+    int last;
+};
+
+struct batch{
+    struct script_run *runs;
+    int count;
+    struct work_queue *queues;
+    int workers;
+    bool verbose;
+    pthread_mutex_t writeLock;
+    int nextToWrite;    // first script whose output has not been written yet
+};
+
+struct worker{
+    struct batch *batch;
+    int id;
+};
+
+/*defined in parser.y*/
+int parseInput(FILE *input);
+
+/*Batch function prototypes*/
+int runScripts(char **paths, int count, int workers, bool verbose);
+void *runWorker(void *argument);
+bool takeScript(struct batch *batch, int worker, int *script);
+void runScript(struct batch *batch, int script);
+void writeCompleted(struct batch *batch, int script);
+
+/* runs every script on the given number of threads and returns 1 if any of them failed, 0 otherwise*/
+int runScripts(char **paths, int count, int workers, bool verbose){
+    struct batch batch;
+    batch.count = count;
+    batch.workers = workers < count ? workers : count;
+    batch.verbose = verbose;
+    batch.nextToWrite = 0;
+    batch.runs = (struct script_run *)calloc(count, sizeof(struct script_run));
+    batch.queues = (struct work_queue *)calloc(batch.workers, sizeof(struct work_queue));
+    if (batch.runs == NULL || batch.queues == NULL){
+        fprintf(stderr, "Error: could not allocate memory for the batch!\n");
+        return 1;
+    }
+    pthread_mutex_init(&batch.writeLock, NULL);
+    for (int i = 0; i < batch.workers; i++){
+        struct work_queue *queue = &batch.queues[i];
+        pthread_mutex_init(&queue->lock, NULL);
+        queue->items = (int *)malloc((count / batch.workers + 1) * sizeof(int));
+        if (queue->items == NULL){
+            fprintf(stderr, "Error: could not allocate memory for the batch!\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < count; i++){
+        batch.runs[i].path = paths[i];
+        struct work_queue *queue = &batch.queues[i % batch.workers];
+        queue->items[queue->last++] = i;
+    }
+
+    struct worker *pool = (struct worker *)malloc(batch.workers * sizeof(struct worker));
+    pthread_t *threads = (pthread_t *)malloc(batch.workers * sizeof(pthread_t));
+    if (pool == NULL || threads == NULL){
+        fprintf(stderr, "Error: could not allocate memory for the batch!\n");
+        return 1;
+    }
+    //the calling thread is the first worker, the others get a thread each
+    int started = 1;
+    for (int i = 0; i < batch.workers; i++){
+        pool[i].batch = &batch;
+        pool[i].id = i;
+        if (i > 0){
+            if (pthread_create(&threads[i], NULL, runWorker, &pool[i]) != 0){
+                break;  // its scripts are stolen by the workers that did start
+            }
+            started++;
+        }
+    }
+    runWorker(&pool[0]);
+    for (int i = 1; i < started; i++){
+        pthread_join(threads[i], NULL);
+    }
+
+    int status = 0;
+    for (int i = 0; i < count; i++){
+        if (batch.runs[i].status != 0){
+            status = 1;
+        }
+    }
+    for (int i = 0; i < batch.workers; i++){
+        pthread_mutex_destroy(&batch.queues[i].lock);
+        free(batch.queues[i].items);
+    }
+    pthread_mutex_destroy(&batch.writeLock);
+    free(batch.queues);
+    free(batch.runs);
+    free(pool);
+    free(threads);
+    return status;
+}
+
+void *runWorker(void *argument){
+    struct worker *worker = (struct worker *)argument;
+    int script;
+    while (takeScript(worker->batch, worker->id, &script)){
+        runScript(worker->batch, script);
+    }
+    return NULL;
+}
+
+/* takes the next script from the front of the worker's own queue, or steals one from the back
+ * of another queue. Returns false when every queue is empty: scripts are never added while the batch runs,
+ * so there is nothing left to do*/
+bool takeScript(struct batch *batch, int worker, int *script){
+    struct work_queue *own = &batch->queues[worker];
+    pthread_mutex_lock(&own->lock);
+    bool found = own->first < own->last;
+    if (found){
+        *script = own->items[own->first++];
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (int i = 1; i < batch->workers && !found; i++){
+        struct work_queue *victim = &batch->queues[(worker + i) % batch->workers];
+        pthread_mutex_lock(&victim->lock);
+        found = victim->first < victim->last;
+        if (found){
+            *script = victim->items[--victim->last];
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return found;
+}
+
+/* runs a script in a new session of the current thread, then writes out its output
+ * (and that of the scripts completed after it, if they were waiting for this one)*/
+void runScript(struct batch *batch, int script){
+    struct script_run *run = &batch->runs[script];
+    bool capture = batch->workers > 1;
+    createSession(capture ? NULL : stdout, capture ? NULL : stderr, capture ? CAPTURE_BUFFER_SIZE : OUTPUT_BUFFER_SIZE);
+    session->quietMode = !batch->verbose;
+
+    FILE *input = fopen(run->path, "r");
+    if (input == NULL){
+        printError("Error: could not open the script %s\n", run->path);
+        run->status = 1;
+    } else {
+        run->status = parseInput(input);
+        fclose(input);
+    }
+    flushOutput();
+
+    //the captured text is handed over to the run, so that it survives the session
+    run->output = session->output;
+    run->errors = session->errors;
+    session->output.chars = NULL;
+    session->errors.chars = NULL;
+    endSession();
+    writeCompleted(batch, script);
+}
+
+/* marks a script as completed and writes out the outputs that are ready, in the order of the scripts*/
+void writeCompleted(struct batch *batch, int script){
+    pthread_mutex_lock(&batch->writeLock);
+    batch->runs[script].done = true;
+    while (batch->nextToWrite < batch->count && batch->runs[batch->nextToWrite].done){
+        struct script_run *run = &batch->runs[batch->nextToWrite];
+        if (run->output.length > 0){
+            fwrite(run->output.chars, 1, run->output.length, stdout);
+        }
+        if (run->errors.length > 0){
+            fflush(stdout);
+            fwrite(run->errors.chars, 1, run->errors.length, stderr);
+        }
+        free(run->output.chars);
+        free(run->errors.chars);
+        run->output.chars = NULL;
+        run->errors.chars = NULL;
+        batch->nextToWrite++;
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&batch->writeLock);
+}
+
+#endif
@@ -0,0 +1,1121 @@
+/* BENCHMARKS of the calculator: symbol-table, arithmetic kernels, string concatenation, scanner and parser, server,
+ * shared symbol-table, snapshots, journal and machine code, on workloads generated on the fly.
+ * The whole calculator is compiled in, from the sources generated by flex and bison:
+ *   flex lexer.l
+ *   bison parser.y -o y.tab.c
+ *   gcc -O2 -DCALC_NO_MAIN benchmark.c -o benchmark -pthread
+ *   ./benchmark
+ * Every result is reported in nanoseconds per operation, along with the allocations made per operation.
+ * What the calculator prints while running is thrown away.*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* ALLOCATION COUNTING: the calculator is compiled in this same file, so its calls to malloc, calloc and realloc
+ * are redirected here by the macros below, and counted (atomically, as the server and the shared table run on threads)*/
+long allocations = 0;
+
+void *countedMalloc(size_t size){
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+void *countedCalloc(size_t count, size_t size){
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return calloc(count, size);
+}
+
+void *countedRealloc(void *memory, size_t size){
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    return realloc(memory, size);
+}
+
+#define malloc(size) countedMalloc(size)
+#define calloc(count, size) countedCalloc(count, size)
+#define realloc(memory, size) countedRealloc(memory, size)
+
+#include "y.tab.c"
+
+/* REFERENCE IMPLEMENTATIONS: the if/else chains that were used before the dispatch tables
+ * of arithmetic-utils.h, kept here (unchanged) only to measure the tables against them.
+ * They work on the values as they were before NaN boxing (see variable-utils.h): a union and two tags, 16 bytes*/
+struct legacy_variable{
+    union{
+        int integer_val;
+        double double_val;
+        char *string_val;
+    };
+    char fromID;
+    char type;
+};
+
+struct legacy_variable legacySumOrConcat(struct legacy_variable n1, struct legacy_variable n2){
+    struct legacy_variable result;
+
+    //if one of the two variables is a string, concatenate
+    if(n1.type==STRING_TYPE || n2.type == STRING_TYPE){
+        if (n1.type == STRING_TYPE && n2.type == STRING_TYPE){
+            result.string_val = n1.string_val;
+            strcat(result.string_val, n2.string_val);
+            result.type = STRING_TYPE;
+        } else if (n1.type == INTEGER_TYPE){
+            char v [20];
+            sprintf(v,"%i",n1.integer_val);
+            result.string_val = strcat(v,n2.string_val);
+            result.type = STRING_TYPE;
+        } else if (n1.type == DOUBLE_TYPE){
+            char v [20] = {0};
+            sprintf(v,"%f",n1.double_val);
+            result.string_val= strcat(v,n2.string_val);
+            result.type = STRING_TYPE;
+        } else if (n2.type == INTEGER_TYPE){
+            result.string_val = n1.string_val;
+            char v [20];
+            sprintf(v,"%i",n2.integer_val);
+            strcat(result.string_val, v);
+            result.type = STRING_TYPE;
+        } else if (n2.type == DOUBLE_TYPE){
+            result.string_val = n1.string_val;
+            char v [20];
+            sprintf(v,"%f",n2.double_val);
+            strcat(result.string_val, v);
+            result.type = STRING_TYPE;
+        } else {
+            result.type = 8;
+        }
+    } else if (n1.type == UNDEFINED_TYPE || n2.type == UNDEFINED_TYPE){
+        if (n1.type == INTEGER_TYPE) {
+            result.integer_val = n1.integer_val;
+            result.type = INTEGER_TYPE;
+        } else if (n2.type == INTEGER_TYPE){
+            result.integer_val = n2.integer_val;
+            result.type = INTEGER_TYPE;
+        } else if (n1.type == DOUBLE_TYPE){
+            result.double_val = n1.double_val;
+            result.type = DOUBLE_TYPE;
+        } else if (n2.type == DOUBLE_TYPE) {
+            result.double_val = n1.double_val;
+            result.type = DOUBLE_TYPE;
+        } else if (n1.type == STRING_TYPE) {
+            result.string_val = n1.string_val;
+            result.type = STRING_TYPE;
+        } else if (n2.type == STRING_TYPE){
+            result.string_val = n2.string_val;
+            result.type = STRING_TYPE;
+        } else {
+            result.type = 8;
+        }
+    }
+    else if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
+        result.integer_val = n1.integer_val + n2.integer_val;
+        result.type = INTEGER_TYPE;
+    } else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
+        result.double_val = n1.integer_val + n2.double_val;
+        result.type = DOUBLE_TYPE;
+    } else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
+        result.double_val = n1.double_val + n2.integer_val;
+        result.type = DOUBLE_TYPE;
+    } else if (n1.type == DOUBLE_TYPE && n2.type == DOUBLE_TYPE){
+        result.double_val = n1.double_val + n2.double_val;
+        result.type = DOUBLE_TYPE;
+    } else{
+        result.type = 9; // ERROR TYPE
+    }
+
+    return result;
+}
+
+struct legacy_variable legacySub(struct legacy_variable n1, struct legacy_variable n2){
+    struct legacy_variable result;
+    if(n1.type == UNDEFINED_TYPE){
+        result.type = n2.type;
+        if(n2.type == INTEGER_TYPE){
+            result.integer_val = n2.integer_val;
+        } else if(n2.type == DOUBLE_TYPE){
+            result.double_val = n2.double_val;
+        }
+    } else if(n2.type == UNDEFINED_TYPE){
+        result.type = n1.type;
+        if(n1.type == INTEGER_TYPE){
+            result.integer_val = n1.integer_val;
+        } else if(n1.type == DOUBLE_TYPE){
+            result.double_val = n1.double_val;
+        }
+    }
+    if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
+        result.integer_val = n1.integer_val - n2.integer_val;
+        result.type = INTEGER_TYPE;
+    }
+    else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
+        result.double_val = n1.integer_val - n2.double_val;
+        result.type = DOUBLE_TYPE;
+    }
+    else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
+        result.double_val = n1.double_val - n2.integer_val;
+        result.type = DOUBLE_TYPE;
+    }
+    else{
+        result.double_val = n1.double_val - n2.double_val;
+        result.type = DOUBLE_TYPE;
+    }
+
+    return result;
+}
+
+struct legacy_variable legacyMulti(struct legacy_variable n1, struct legacy_variable n2){
+
+    struct legacy_variable result;
+    if(n1.type == UNDEFINED_TYPE){
+        result.type = n2.type;
+        if(n2.type == INTEGER_TYPE){
+            result.integer_val = 0;
+        } else if(n2.type == DOUBLE_TYPE){
+            result.double_val = 0;
+        }
+    } else if(n2.type == UNDEFINED_TYPE){
+        result.type = n1.type;
+        if(n1.type == INTEGER_TYPE){
+            result.integer_val = 0;
+        } else if(n1.type == DOUBLE_TYPE){
+            result.double_val = 0;
+        }
+    }
+
+    if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
+        result.integer_val = n1.integer_val * n2.integer_val;
+        result.type = INTEGER_TYPE;
+    }
+    else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
+        result.double_val = n1.integer_val * n2.double_val;
+        result.type = DOUBLE_TYPE;
+    }
+    else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
+        result.double_val = n1.double_val * n2.integer_val;
+        result.type = DOUBLE_TYPE;
+    }
+    else{
+        result.double_val = n1.double_val * n2.double_val;
+        result.type = DOUBLE_TYPE;
+    }
+
+    return result;
+}
+
+struct legacy_variable legacyDivide(struct legacy_variable n1, struct legacy_variable n2){
+
+    struct legacy_variable result;
+    if(n2.double_val == 0.0 || n2.integer_val == 0|| n2.type == UNDEFINED_TYPE){
+        printf("ERROR: cannot divide by 0");
+        exit(0);
+    }
+    else if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
+        result.integer_val = n1.integer_val / n2.integer_val;
+        result.type = INTEGER_TYPE;
+    }
+    else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
+        result.double_val = n1.integer_val / n2.double_val;
+        result.type = DOUBLE_TYPE;
+    }
+    else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
+        result.double_val = n1.double_val / n2.integer_val;
+        result.type = DOUBLE_TYPE;
+    }
+    else{
+        result.double_val = n1.double_val / n2.double_val;
+        result.type = DOUBLE_TYPE;
+    }
+
+    return result;
+}
+
+/* BENCHMARK DRIVER*/
+#define OPERAND_COUNT 4096          // operands are cycled through, so that they stay in cache
+const long ITERATIONS = 20000000;
+
+struct variable leftOperands[OPERAND_COUNT];
+struct variable rightOperands[OPERAND_COUNT];
+struct legacy_variable legacyLeftOperands[OPERAND_COUNT];     // the same numeric operands, for the reference implementations
+struct legacy_variable legacyRightOperands[OPERAND_COUNT];
+volatile double sink;               // keeps the compiler from dropping the results
+
+struct timespec startTime;
+long startAllocations;
+
+/* starts measuring time and allocations*/
+void startMeasure(){
+    startAllocations = allocations;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+}
+
+double elapsedNs(struct timespec start){
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+// prints a row of results for operations operations, measured since startMeasure()
+void report(const char *benchmark, const char *workload, long operations){
+    double ns = elapsedNs(startTime) / operations;
+    double allocationsPerOp = (double)(allocations - startAllocations) / operations;
+    printf("%-22s %-26s %12.2f %14.0f %12.4f\n", benchmark, workload, ns, 1e9 / ns, allocationsPerOp);
+}
+
+void printHeader(const char *title){
+    printf("\n%s\n%-22s %-26s %12s %14s %12s\n", title, "benchmark", "workload", "ns/op", "ops/s", "allocs/op");
+}
+
+/* creates a quiet session whose output is thrown away, to run the calculator in*/
+FILE *discard = NULL;
+
+void startSession(){
+    if (discard == NULL){
+        discard = fopen("/dev/null", "w");
+        if (discard == NULL){
+            fprintf(stderr, "Error: could not open /dev/null\n");
+            exit(1);
+        }
+    }
+    createSession(discard, discard, OUTPUT_BUFFER_SIZE);
+    session->quietMode = true;
+}
+
+// fills the operands with non-zero values of the given types, a negative type picks a random numeric type per operand
+void fillOperands(int leftType, int rightType){
+    for (int i = 0; i < OPERAND_COUNT; i++){
+        struct variable *operands[2] = {&leftOperands[i], &rightOperands[i]};
+        struct legacy_variable *legacyOperands[2] = {&legacyLeftOperands[i], &legacyRightOperands[i]};
+        int types[2] = {leftType, rightType};
+        for (int j = 0; j < 2; j++){
+            int type = types[j] < 0 ? INTEGER_TYPE + rand() % 2 : types[j];
+            legacyOperands[j]->type = type;
+            legacyOperands[j]->fromID = true;
+            if (type == INTEGER_TYPE){
+                legacyOperands[j]->integer_val = 1 + rand() % 1000;
+                *operands[j] = integerValue(legacyOperands[j]->integer_val);
+            } else if (type == DOUBLE_TYPE){
+                legacyOperands[j]->double_val = 1.37 + rand() % 1000;
+                *operands[j] = doubleValue(legacyOperands[j]->double_val);
+            } else if (type == STRING_TYPE){
+                *operands[j] = shareValue(makeOwnedString("abcdefghijkl", 1 + rand() % 12));
+            } else {
+                *operands[j] = undefinedValue();
+            }
+        }
+    }
+}
+
+// runs iterations times the given call, where n1 and n2 are the current elements of left and right, and returns ns/op
+#define MEASURE(iterations, left, right, call) ({ \
+        struct timespec start; \
+        clock_gettime(CLOCK_MONOTONIC, &start); \
+        double accumulator = 0; \
+        for (long i = 0; i < (iterations); i++){ \
+            __typeof__(left[0]) n1 = left[i & (OPERAND_COUNT - 1)]; \
+            __typeof__(right[0]) n2 = right[i & (OPERAND_COUNT - 1)]; \
+            __typeof__(call) result = call; \
+            int low; \
+            memcpy(&low, &result, sizeof(int)); \
+            accumulator += low; \
+            if ((i & (OPERAND_COUNT - 1)) == 0){ \
+                arenaReset(); \
+            } \
+        } \
+        sink = accumulator; \
+        elapsedNs(start) / (iterations); \
+    })
+
+/* the dispatch tables against the if/else chains they replaced, on numeric operands*/
+void benchmarkArithmetic(){
+    const char *pairNames[] = {"int,int", "int,double", "double,int", "double,double", "mixed"};
+    const int leftTypes[] = {INTEGER_TYPE, INTEGER_TYPE, DOUBLE_TYPE, DOUBLE_TYPE, -1};
+    const int rightTypes[] = {INTEGER_TYPE, DOUBLE_TYPE, INTEGER_TYPE, DOUBLE_TYPE, -1};
+
+    startSession();
+    printf("\nARITHMETIC: dispatch tables against the original if/else chains (values of %zu and %zu bytes)\n",
+           sizeof(struct legacy_variable), sizeof(struct variable));
+    printf("%-22s %-26s %12s %12s %9s\n", "operation", "operands", "if/else ns", "table ns", "speedup");
+    for (int pair = 0; pair < 5; pair++){
+        fillOperands(leftTypes[pair], rightTypes[pair]);
+        double legacy[4], table[4];
+        legacy[ADD_OP] = MEASURE(ITERATIONS, legacyLeftOperands, legacyRightOperands, legacySumOrConcat(n1, n2));
+        table[ADD_OP] = MEASURE(ITERATIONS, leftOperands, rightOperands, BINARY_OPERATION(ADD_OP, n1, n2));
+        legacy[SUB_OP] = MEASURE(ITERATIONS, legacyLeftOperands, legacyRightOperands, legacySub(n1, n2));
+        table[SUB_OP] = MEASURE(ITERATIONS, leftOperands, rightOperands, BINARY_OPERATION(SUB_OP, n1, n2));
+        legacy[MUL_OP] = MEASURE(ITERATIONS, legacyLeftOperands, legacyRightOperands, legacyMulti(n1, n2));
+        table[MUL_OP] = MEASURE(ITERATIONS, leftOperands, rightOperands, BINARY_OPERATION(MUL_OP, n1, n2));
+        legacy[DIV_OP] = MEASURE(ITERATIONS, legacyLeftOperands, legacyRightOperands, legacyDivide(n1, n2));
+        table[DIV_OP] = MEASURE(ITERATIONS, leftOperands, rightOperands, BINARY_OPERATION(DIV_OP, n1, n2));
+
+        const char *operationNames[] = {"sumOrConcat", "sub", "multi", "divide"};
+        for (int op = ADD_OP; op <= DIV_OP; op++){
+            printf("%-22s %-26s %12.2f %12.2f %8.2fx\n", operationNames[op], pairNames[pair],
+                   legacy[op], table[op], legacy[op] / table[op]);
+        }
+    }
+    endSession();
+}
+
+/* sumOrConcat, multi and divide for every pair of types, strings and undefined values included
+ * (operations that are errors print their message, which is thrown away)*/
+void benchmarkTypePairs(){
+    const char *typeNames[] = {"undefined", "int", "double", "string"};
+    const char *operationNames[] = {"sumOrConcat", "sub", "multi", "divide"};
+    const int operations[] = {ADD_OP, MUL_OP, DIV_OP};
+    const long iterations = ITERATIONS / 10;
+
+    printHeader("ARITHMETIC: every pair of types");
+    startSession();
+    for (int op = 0; op < 3; op++){
+        for (int leftType = UNDEFINED_TYPE; leftType <= STRING_TYPE; leftType++){
+            for (int rightType = UNDEFINED_TYPE; rightType <= STRING_TYPE; rightType++){
+                fillOperands(leftType, rightType);
+                char workload[64];
+                snprintf(workload, sizeof(workload), "%s,%s", typeNames[leftType], typeNames[rightType]);
+                startMeasure();
+                MEASURE(iterations, leftOperands, rightOperands, BINARY_OPERATION(operations[op], n1, n2));
+                report(operationNames[operations[op]], workload, iterations);
+            }
+        }
+    }
+    for (int i = 0; i < OPERAND_COUNT; i++){
+        if (valueType(leftOperands[i]) == STRING_TYPE){
+            freeString(&leftOperands[i]);
+        }
+        if (valueType(rightOperands[i]) == STRING_TYPE){
+            freeString(&rightOperands[i]);
+        }
+    }
+    endSession();
+}
+
+/* findOrAdd on tables of 10 to 100k symbols: adding all of them, then looking them up in random order*/
+void benchmarkSymbolTable(){
+    const int sizes[] = {10, 100, 1000, 10000, 100000};
+    const long lookups = 5000000;
+
+    printHeader("SYMBOL-TABLE: findOrAdd");
+    for (int s = 0; s < 5; s++){
+        int size = sizes[s];
+        startSession();
+        char **handles = (char **)malloc(size * sizeof(char *));
+        for (int i = 0; i < size; i++){
+            char name[32];
+            handles[i] = intern(name, snprintf(name, sizeof(name), "var%i", i));
+        }
+        int order[OPERAND_COUNT];
+        for (int i = 0; i < OPERAND_COUNT; i++){
+            order[i] = rand() % size;
+        }
+
+        char workload[64];
+        snprintf(workload, sizeof(workload), "%i symbols", size);
+        startMeasure();
+        for (int i = 0; i < size; i++){
+            findOrAdd(handles[i]);
+        }
+        report("findOrAdd (add)", workload, size);
+
+        startMeasure();
+        long found = 0;
+        for (long i = 0; i < lookups; i++){
+            found += findOrAdd(handles[order[i & (OPERAND_COUNT - 1)]])->slot;
+        }
+        sink = found;
+        report("findOrAdd (lookup)", workload, lookups);
+
+        free(handles);
+        endSession();
+    }
+}
+
+/* chains of concatenations, each one appending a number or a string to the result of the previous one,
+ * as in s = "a" + 1 + "b" + 2.5 + ...*/
+void benchmarkConcatenation(){
+    const int lengths[] = {2, 8, 32, 128};
+    const long concatenations = 4000000;
+
+    printHeader("STRINGS: concatenation chains");
+    startSession();
+    struct variable pieces[3];
+    pieces[0] = shareValue(makeOwnedString("piece", 5));
+    pieces[1] = integerValue(42);
+    pieces[2] = doubleValue(2.5);
+
+    for (int l = 0; l < 4; l++){
+        int length = lengths[l];
+        char workload[64];
+        snprintf(workload, sizeof(workload), "%i operands", length);
+        long chains = concatenations / length;
+        startMeasure();
+        size_t total = 0;
+        for (long c = 0; c < chains; c++){
+            struct variable result = pieces[0];
+            for (int i = 1; i < length; i++){
+                result = BINARY_OPERATION(ADD_OP, result, pieces[i % 3]);
+            }
+            total += stringLength(&result);
+            arenaReset();
+        }
+        sink = total;
+        report("sumOrConcat chain", workload, chains * (length - 1));
+    }
+    freeString(&pieces[0]);
+    endSession();
+}
+
+/* generates a script of the given number of statements, mixing assignments, expressions, conditions,
+ * string operations and if statements. The returned text has to be freed by the caller*/
+char *generateScript(int statements){
+    size_t capacity = statements * 64 + 1;
+    char *script = (char *)malloc(capacity);
+    size_t length = 0;
+    for (int i = 0; i < statements; i++){
+        int a = i % 100;
+        int b = (i * 7) % 100;
+        switch (i % 8){
+            case 0: length += snprintf(script + length, capacity - length, "x%i = %i\n", a, i); break;
+            case 1: length += snprintf(script + length, capacity - length, "y%i = %i.%i\n", a, i, a); break;
+            case 2: length += snprintf(script + length, capacity - length, "x%i + y%i * 2 - (x%i / 3)\n", a, b, b); break;
+            case 3: length += snprintf(script + length, capacity - length, "s%i = \"label\" + x%i\n", a, b); break;
+            case 4: length += snprintf(script + length, capacity - length, "x%i < y%i && x%i != 0\n", a, b, a); break;
+            case 5: length += snprintf(script + length, capacity - length, "x%i += %i\n", a, i); break;
+            case 6: length += snprintf(script + length, capacity - length, "if (x%i > %i) then {\"big\"}\n", a, i); break;
+            default: length += snprintf(script + length, capacity - length, "s%i + \" and \" + %i.5\n", a, i); break;
+        }
+    }
+    return script;
+}
+
+// counts the lines of a script, which are its statements
+long countLines(const char *script){
+    long lines = 0;
+    for (const char *c = script; *c != '\0'; c++){
+        lines += *c == '\n';
+    }
+    return lines;
+}
+
+/* the scanner alone, on a generated script*/
+void benchmarkScanner(){
+    const int repetitions = 200;
+    char *script = generateScript(2000);
+
+    printHeader("SCANNER: yylex");
+    startSession();
+    long tokens = 0;
+    startMeasure();
+    for (int r = 0; r < repetitions; r++){
+        FILE *input = fmemopen(script, strlen(script), "r");
+        yyscan_t scanner;
+        yylex_init(&scanner);
+        yyset_in(input, scanner);
+        YYSTYPE value;
+        int token;
+        while ((token = yylex(&value, scanner)) != 0){
+            tokens++;
+            if (token == '\n'){
+                arenaReset();
+            }
+        }
+        yylex_destroy(scanner);
+        fclose(input);
+    }
+    report("yylex", "mixed statements (tokens)", tokens);
+    endSession();
+    free(script);
+}
+
+/* whole statements, scanned, parsed, folded, compiled and run*/
+void benchmarkParser(){
+    const int repetitions = 200;
+    const int sizes[] = {2000, 500};
+    char workload[64];
+
+    printHeader("PARSER: statements through yyparse");
+    for (int s = 0; s < 2; s++){
+        char *script = generateScript(sizes[s]);
+        long statements = 0;
+        startSession();
+        startMeasure();
+        for (int r = 0; r < repetitions; r++){
+            FILE *input = fmemopen(script, strlen(script), "r");
+            parseInput(input);
+            fclose(input);
+            statements += countLines(script);
+        }
+        snprintf(workload, sizeof(workload), "mixed, %i per script", sizes[s]);
+        report("yyparse", workload, statements);
+        endSession();
+        free(script);
+    }
+
+    //appending to a variable, which grows in place
+    const int appends = 2000;
+    char *script = (char *)malloc(appends * 24 + 16);
+    size_t length = sprintf(script, "s = \"start\"\n");
+    for (int i = 0; i < appends - 1; i++){
+        length += sprintf(script + length, "s += \"0123456789\"\n");
+    }
+    startSession();
+    startMeasure();
+    for (int r = 0; r < repetitions; r++){
+        FILE *input = fmemopen(script, length, "r");
+        parseInput(input);
+        fclose(input);
+    }
+    report("yyparse", "s += string", (long)appends * repetitions);
+    endSession();
+    free(script);
+}
+
+/* a loop against the same iterations written out as text, which go through the scanner and the parser every time*/
+void benchmarkLoops(){
+    const int iterations = 10000000;
+    const int unrolled = 200000;
+    char loop[128];
+    snprintf(loop, sizeof(loop), "i = 0\ns = 0\nwhile (i < %i) { s += i; i += 1 }\n", iterations);
+
+    printHeader("LOOPS: iterations of s += i; i += 1");
+    startSession();
+    startMeasure();
+    FILE *input = fmemopen(loop, strlen(loop), "r");
+    parseInput(input);
+    fclose(input);
+    report("while", "compiled once", iterations);
+    endSession();
+
+    char *script = (char *)malloc(unrolled * 16 + 16);
+    size_t length = sprintf(script, "i = 0\ns = 0\n");
+    for (int i = 0; i < unrolled; i++){
+        length += sprintf(script + length, "s += i\ni += 1\n");
+    }
+    startSession();
+    startMeasure();
+    input = fmemopen(script, length, "r");
+    parseInput(input);
+    fclose(input);
+    report("unrolled", "two lines per iteration", unrolled);
+    endSession();
+    free(script);
+}
+
+/* calls to a recursive pure function, with and without its memo cache*/
+void benchmarkFunctions(){
+    const int repetitions = 20;
+    const char *script = "def fib(n) = n < 2 ? n : fib(n - 1) + fib(n - 2)\nfib(24)\nfib(24)\n";
+    const int capacities[] = {0, DEFAULT_MEMO_CAPACITY};
+    const char *workloads[] = {"fib(24) twice, no memo", "fib(24) twice, memoized"};
+
+    printHeader("FUNCTIONS: calls to fib");
+    for (int c = 0; c < 2; c++){
+        memoCapacity = capacities[c];
+        long calls = 0;
+        startMeasure();
+        for (int r = 0; r < repetitions; r++){
+            startSession();
+            FILE *input = fmemopen((char *)script, strlen(script), "r");
+            parseInput(input);
+            fclose(input);
+            calls += 2;
+            endSession();
+        }
+        report("fib", workloads[c], calls);
+    }
+    memoCapacity = DEFAULT_MEMO_CAPACITY;
+}
+
+/* a graph of formulas bound with :=, where an input changes and one formula reading it is read back,
+ * against assigning every formula again after the change, as a script without bindings would*/
+void benchmarkBindings(){
+    const int inputs = 1000;
+    const int formulas = 100000;
+    const int updates = 2000;
+    const int reassigned = 3;
+
+    char *graph = (char *)malloc((size_t)(inputs + formulas) * 48);
+    size_t length = 0;
+    for (int i = 0; i < inputs; i++){
+        length += sprintf(graph + length, "a%i = %i\n", i, i);
+    }
+    for (int i = 0; i < formulas; i++){
+        length += sprintf(graph + length, "f%i := a%i * 2 + a%i\n", i, i % inputs, (i * 7) % inputs);
+    }
+    char *changes = (char *)malloc((size_t)updates * 48);
+    size_t changesLength = 0;
+    for (int u = 0; u < updates; u++){
+        int input = (u * 13) % inputs;
+        changesLength += sprintf(changes + changesLength, "a%i = %i\nf%i\n", input, u, input);
+    }
+
+    printHeader("BINDINGS: 100k formulas on 1000 inputs");
+    startSession();
+    startMeasure();
+    FILE *input = fmemopen(graph, length, "r");
+    parseInput(input);
+    fclose(input);
+    report("bind", "one formula", formulas);
+    startMeasure();
+    input = fmemopen(changes, changesLength, "r");
+    parseInput(input);
+    fclose(input);
+    report("update and read", "downstream cone only", updates);
+    endSession();
+
+    // the same graph with plain assignments, all of them run again after every change
+    free(graph);
+    graph = (char *)malloc((size_t)inputs * 48 + (size_t)reassigned * (formulas + 1) * 48);
+    length = 0;
+    for (int i = 0; i < inputs; i++){
+        length += sprintf(graph + length, "a%i = %i\n", i, i);
+    }
+    for (int u = 0; u < reassigned; u++){
+        length += sprintf(graph + length, "a%i = %i\n", (u * 13) % inputs, u);
+        for (int i = 0; i < formulas; i++){
+            length += sprintf(graph + length, "f%i = a%i * 2 + a%i\n", i, i % inputs, (i * 7) % inputs);
+        }
+    }
+    startSession();
+    startMeasure();
+    input = fmemopen(graph, length, "r");
+    parseInput(input);
+    fclose(input);
+    report("update and read", "reassign every formula", reassigned);
+    endSession();
+    free(graph);
+    free(changes);
+}
+
+/* products of big integers, with Karatsuba's method against the schoolbook product it replaces,
+ * and factorials computed by a loop of the calculator, whose results quickly become big integers*/
+void benchmarkIntegers(){
+    const int sizes[] = {16, 64, 256, 1024};
+    const int repetitions[] = {20000, 2000, 200, 20};
+
+    printHeader("INTEGERS: products of n-limb big integers");
+    startSession();
+    for (int s = 0; s < 4; s++){
+        int n = sizes[s];
+        uint32_t *a = (uint32_t *)malloc(n * sizeof(uint32_t));
+        uint32_t *b = (uint32_t *)malloc(n * sizeof(uint32_t));
+        uint32_t *product = (uint32_t *)malloc(2 * n * sizeof(uint32_t));
+        for (int i = 0; i < n; i++){
+            a[i] = (uint32_t)rand() * 2654435761u;
+            b[i] = (uint32_t)rand() * 2246822519u;
+        }
+        char workload[32];
+        snprintf(workload, sizeof(workload), "%i limbs", n);
+        startMeasure();
+        for (int r = 0; r < repetitions[s]; r++){
+            memset(product, 0, 2 * n * sizeof(uint32_t));
+            schoolbookLimbs(product, a, n, b, n);
+        }
+        sink += product[n];
+        report("schoolbook", workload, repetitions[s]);
+        startMeasure();
+        for (int r = 0; r < repetitions[s]; r++){
+            memset(product, 0, 2 * n * sizeof(uint32_t));
+            mulLimbs(product, a, n, b, n);
+        }
+        sink += product[n];
+        report("mulLimbs", workload, repetitions[s]);
+        free(a);
+        free(b);
+        free(product);
+    }
+    endSession();
+
+    const int factorials[] = {20, 1000, 5000};
+    for (int f = 0; f < 3; f++){
+        char script[128];
+        snprintf(script, sizeof(script), "f = 1\nfor (i = 2; i <= %i; i += 1) { f *= i }\n", factorials[f]);
+        char workload[32];
+        snprintf(workload, sizeof(workload), "%i!", factorials[f]);
+        startSession();
+        startMeasure();
+        FILE *input = fmemopen(script, strlen(script), "r");
+        parseInput(input);
+        fclose(input);
+        report("factorial loop", workload, factorials[f] - 1);
+        endSession();
+    }
+}
+
+/* the server of server-utils.h, running on a thread of its own: the round trip of a statement on one of many open sessions,
+ * and batches of statements sent at once, whose results come back in a few large writes*/
+const char *BENCHMARK_SOCKET = "/tmp/calculator-benchmark.sock";
+
+void *runBenchmarkServer(void *argument){
+    runServer(BENCHMARK_SOCKET, 1, false, NULL, false);
+    return NULL;
+}
+
+// connects to the benchmark server, waiting for it to listen
+int connectClient(){
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, BENCHMARK_SOCKET);
+    for (int attempt = 0; attempt < 1000; attempt++){
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0){
+            return fd;
+        }
+        close(fd);
+        usleep(1000);
+    }
+    fprintf(stderr, "Error: could not connect to the benchmark server\n");
+    exit(1);
+}
+
+// sends the statements and reads the answer, up to the given number of lines
+void roundTrip(int fd, const char *statements, size_t length, int lines){
+    char answer[64 * 1024];
+    if (write(fd, statements, length) != (ssize_t)length){
+        fprintf(stderr, "Error: could not write to the benchmark server\n");
+        exit(1);
+    }
+    while (lines > 0){
+        ssize_t received = read(fd, answer, sizeof(answer));
+        if (received <= 0){
+            fprintf(stderr, "Error: the benchmark server closed the connection\n");
+            exit(1);
+        }
+        for (ssize_t i = 0; i < received; i++){
+            lines -= answer[i] == '\n';
+        }
+    }
+}
+
+int compareDoubles(const void *a, const void *b){
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void benchmarkServer(){
+    const int sessions = 5000;
+    const int roundTrips = 20000;
+    const int batches = 100;
+    const int batchSize = 1000;
+
+    printHeader("SERVER: statements over a Unix domain socket");
+    pthread_t server;
+    pthread_create(&server, NULL, runBenchmarkServer, NULL);
+    int *clients = (int *)malloc(sessions * sizeof(int));
+    startMeasure();
+    for (int c = 0; c < sessions; c++){
+        clients[c] = connectClient();
+        char statement[64];
+        int length = snprintf(statement, sizeof(statement), "v = %i\nv\n", c);
+        roundTrip(clients[c], statement, length, 1);
+    }
+    report("open session", "connect and first statement", sessions);
+
+    double *latencies = (double *)malloc(roundTrips * sizeof(double));
+    startMeasure();
+    for (int r = 0; r < roundTrips; r++){
+        char statement[64];
+        int length = snprintf(statement, sizeof(statement), "v * %i + 1\n", r);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        roundTrip(clients[rand() % sessions], statement, length, 1);
+        latencies[r] = elapsedNs(start);
+    }
+    report("round trip", "5000 open sessions", roundTrips);
+    qsort(latencies, roundTrips, sizeof(double), compareDoubles);
+    printf("%-22s %-26s %12.2f\n", "round trip p50", "5000 open sessions", latencies[roundTrips / 2]);
+    printf("%-22s %-26s %12.2f\n", "round trip p99", "5000 open sessions", latencies[roundTrips * 99 / 100]);
+
+    char *script = (char *)malloc((size_t)batchSize * 24);
+    size_t length = 0;
+    for (int i = 0; i < batchSize; i++){
+        length += sprintf(script + length, "v * %i + 1\n", i);
+    }
+    startMeasure();
+    for (int b = 0; b < batches; b++){
+        roundTrip(clients[b % sessions], script, length, batchSize);
+    }
+    report("batch of 1000", "one statement", batches * batchSize);
+
+    for (int c = 0; c < sessions; c++){
+        close(clients[c]);
+    }
+    stopServer(0);
+    pthread_join(server, NULL);
+    free(clients);
+    free(latencies);
+    free(script);
+}
+
+/* a warm start from a snapshot (see snapshot-utils.h) against running again the script that built the variables*/
+void benchmarkSnapshots(){
+    const int variables = 100000;
+    const char *path = "/tmp/calculator-benchmark.snapshot";
+    char *script = (char *)malloc((size_t)variables * 48);
+    size_t length = 0;
+    for (int i = 0; i < variables; i++){
+        if (i % 3 == 0){
+            length += sprintf(script + length, "v%i = %i\n", i, i * 7);
+        } else if (i % 3 == 1){
+            length += sprintf(script + length, "v%i = %i.5\n", i, i);
+        } else {
+            length += sprintf(script + length, "v%i = \"string value number %i\"\n", i, i);
+        }
+    }
+    char save[64];
+    char load[64];
+    snprintf(save, sizeof(save), "save \"%s\"\n", path);
+    snprintf(load, sizeof(load), "load \"%s\"\n", path);
+
+    printHeader("SNAPSHOTS: 100k variables, ints, doubles and strings");
+    startSession();
+    startMeasure();
+    FILE *input = fmemopen(script, length, "r");
+    parseInput(input);
+    fclose(input);
+    report("run set-up script", "per variable", variables);
+    startMeasure();
+    input = fmemopen(save, strlen(save), "r");
+    parseInput(input);
+    fclose(input);
+    report("save", "per variable", variables);
+    endSession();
+
+    startSession();
+    startMeasure();
+    input = fmemopen(load, strlen(load), "r");
+    parseInput(input);
+    fclose(input);
+    report("load", "per variable", variables);
+    endSession();
+    remove(path);
+    free(script);
+}
+
+/* assignments with and without the journal (see journal-utils.h), and recovery from the journal they leave:
+ * a long history over few variables, which compaction keeps from growing the log*/
+void benchmarkJournal(){
+    const int assignments = 1000000;
+    const int variables = 1000;
+    const char *path = "/tmp/calculator-benchmark.journal";
+    char *script = (char *)malloc((size_t)assignments * 32);
+    size_t length = 0;
+    for (int i = 0; i < assignments; i++){
+        length += sprintf(script + length, "v%i = %i\n", i % variables, i);
+    }
+
+    printHeader("JOURNAL: 1M assignments to 1000 variables");
+    for (int journaled = 0; journaled < 2; journaled++){
+        startSession();
+        if (journaled && !openJournal(path)){
+            exit(1);
+        }
+        startMeasure();
+        FILE *input = fmemopen(script, length, "r");
+        parseInput(input);
+        fclose(input);
+        closeJournal(session->table);
+        report("assign", journaled ? "journaled, flushed" : "not journaled", assignments);
+        endSession();
+    }
+
+    startSession();
+    startMeasure();
+    openJournal(path);
+    report("recover", "per variable", variables);
+    closeJournal(session->table);
+    endSession();
+
+    char logPath[64];
+    snprintf(logPath, sizeof(logPath), "%s.log", path);
+    remove(path);
+    remove(logPath);
+    free(script);
+}
+
+/* readers printing the variables of a shared symbol-table (see shared-utils.h) while a writer keeps assigning them,
+ * each one on a thread with a session of its own, as the connections of a server started with --shared*/
+#define SHARED_VARIABLES 1000
+
+struct table *benchmarkTable;
+int writing;        // the writer assigns until the readers are done
+
+void *runWriter(void *argument){
+    char *script = (char *)argument;
+    startSession();
+    attachTable(benchmarkTable);
+    while (__atomic_load_n(&writing, __ATOMIC_ACQUIRE)){
+        FILE *input = fmemopen(script, strlen(script), "r");
+        beginReading();
+        parseInput(input);
+        endReading();
+        fclose(input);
+    }
+    endSession();
+    return NULL;
+}
+
+void *runReader(void *argument){
+    char *script = (char *)argument;
+    startSession();
+    attachTable(benchmarkTable);
+    for (int r = 0; r < 100; r++){
+        FILE *input = fmemopen(script, strlen(script), "r");
+        beginReading();
+        parseInput(input);
+        endReading();
+        fclose(input);
+    }
+    endSession();
+    return NULL;
+}
+
+void benchmarkSharedTable(){
+    const int readerCounts[] = {1, 2, 4};
+    char *writes = (char *)malloc(SHARED_VARIABLES * 48);
+    char *reads = (char *)malloc(SHARED_VARIABLES * 16);
+    size_t writeLength = 0, readLength = 0;
+    for (int i = 0; i < SHARED_VARIABLES; i++){
+        //integers and strings in turn, so that the writer retires the strings the readers may be printing
+        writeLength += sprintf(writes + writeLength, i % 2 ? "x%i = x%i + 1\n" : "x%i = \"value of x%i\"\n", i, i);
+        readLength += sprintf(reads + readLength, "x%i\n", i);
+    }
+    char workload[64];
+
+    printHeader("SHARED TABLE: readers printing variables while a writer assigns them");
+    for (int c = 0; c < 3; c++){
+        benchmarkTable = createSharedTable();
+        startSession();
+        attachTable(benchmarkTable);
+        FILE *input = fmemopen(writes, writeLength, "r");
+        parseInput(input);
+        fclose(input);
+
+        __atomic_store_n(&writing, 1, __ATOMIC_RELEASE);
+        pthread_t writer;
+        pthread_t readers[4];
+        pthread_create(&writer, NULL, runWriter, writes);
+        startMeasure();
+        for (int r = 0; r < readerCounts[c]; r++){
+            pthread_create(&readers[r], NULL, runReader, reads);
+        }
+        for (int r = 0; r < readerCounts[c]; r++){
+            pthread_join(readers[r], NULL);
+        }
+        snprintf(workload, sizeof(workload), "%i reader(s), 1 writer", readerCounts[c]);
+        report("print variable", workload, 100L * SHARED_VARIABLES * readerCounts[c]);
+        __atomic_store_n(&writing, 0, __ATOMIC_RELEASE);
+        pthread_join(writer, NULL);
+
+        endSession();
+        startSession();
+        releaseSharedTable(benchmarkTable);
+        endSession();
+    }
+    free(writes);
+    free(reads);
+}
+
+/* literal conversion and number formatting against the C library functions they replaced*/
+void benchmarkNumbers(){
+    const long iterations = 2000000;
+    char literals[OPERAND_COUNT][16];      // up to 9999.999
+    double values[OPERAND_COUNT];
+    for (int i = 0; i < OPERAND_COUNT; i++){
+        values[i] = (rand() % 10000000) / 1000.0;
+        snprintf(literals[i], sizeof(literals[i]), "%.3f", values[i]);
+    }
+
+    printHeader("NUMBERS: literals and formatting");
+    double accumulator = 0;
+    startMeasure();
+    for (long i = 0; i < iterations; i++){
+        accumulator += atof(literals[i & (OPERAND_COUNT - 1)]);
+    }
+    report("atof", "double literal", iterations);
+    startMeasure();
+    for (long i = 0; i < iterations; i++){
+        const char *literal = literals[i & (OPERAND_COUNT - 1)];
+        accumulator += parseDouble(literal, strlen(literal));
+    }
+    report("parseDouble", "double literal", iterations);
+
+    char text[NUMBER_TEXT_SIZE];
+    startMeasure();
+    for (long i = 0; i < iterations; i++){
+        accumulator += snprintf(text, sizeof(text), "%f", values[i & (OPERAND_COUNT - 1)]);
+    }
+    report("snprintf %f", "double", iterations);
+    startMeasure();
+    for (long i = 0; i < iterations; i++){
+        accumulator += snprintf(text, sizeof(text), "%.17g", values[i & (OPERAND_COUNT - 1)]);
+    }
+    report("snprintf %.17g", "double", iterations);
+    startMeasure();
+    for (long i = 0; i < iterations; i++){
+        accumulator += formatDouble(text, values[i & (OPERAND_COUNT - 1)]);
+    }
+    report("formatDouble", "double", iterations);
+    startMeasure();
+    for (long i = 0; i < iterations; i++){
+        accumulator += snprintf(text, sizeof(text), "%i", (int)i);
+    }
+    report("snprintf %i", "int", iterations);
+    startMeasure();
+    for (long i = 0; i < iterations; i++){
+        accumulator += formatInteger(text, (int)i);
+    }
+    report("formatInteger", "int", iterations);
+    sink = accumulator;
+}
+
+/* numeric loops and calls run by the bytecode, then with their hot expressions compiled to machine code (--jit)*/
+void benchmarkJit(){
+    const int iterations = 2000000;
+    const char *workloads[] = {"int arithmetic", "double arithmetic", "mixed, with a call"};
+    const char *bodies[] = {
+        "s = s + i * 3 - i / 7",
+        "x = x * 0.5 + i * 1.25 - x / 3.0",
+        "x = x + poly(i) * 0.5"
+    };
+    char script[256];
+
+    printHeader("JIT: iterations of a numeric loop, bytecode against machine code");
+    for (int w = 0; w < 3; w++){
+        snprintf(script, sizeof(script), "def poly(n) = n * n * 3 + n * 2 - 7\ni = 0\ns = 0\nx = 0.0\n"
+                 "while (i < %i) { %s; i += 1 }\n", iterations, bodies[w]);
+        for (int jit = 0; jit < 2; jit++){
+            jitEnabled = jit;
+            startSession();
+            startMeasure();
+            FILE *input = fmemopen(script, strlen(script), "r");
+            parseInput(input);
+            fclose(input);
+            report(jit ? "machine code" : "bytecode", workloads[w], iterations);
+            endSession();
+        }
+    }
+    jitEnabled = false;
+}
+
+int main(void){
+    srand(42);
+    benchmarkArithmetic();
+    benchmarkTypePairs();
+    benchmarkSymbolTable();
+    benchmarkConcatenation();
+    benchmarkScanner();
+    benchmarkParser();
+    benchmarkLoops();
+    benchmarkFunctions();
+    benchmarkBindings();
+    benchmarkIntegers();
+    benchmarkServer();
+    benchmarkSharedTable();
+    benchmarkSnapshots();
+    benchmarkJournal();
+    benchmarkNumbers();
+    benchmarkJit();
+    return 0;
+}
@@ -0,0 +1,252 @@
+#ifndef BINDING_UTILS_H
+#define BINDING_UTILS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "symboltable-utils.h"
+
+/* REACTIVE BINDINGS: total := a * b + c binds total to a formula, instead of assigning it the value the formula has now.
+ * The symbol-table records the dependency graph: a bound node keeps its formula, compiled once (see compileBinding()
+ * in vm-utils.h), and the nodes the formula reads (its inputs), while every node keeps the bound nodes reading it
+ * (its dependents).
+ * Changing a variable marks the bound nodes downstream of it as dirty, stopping at those that are dirty already,
+ * since everything downstream of a dirty node is dirty too. Nothing is computed until a dirty node is read:
+ * then the dirty bindings it depends on are recomputed, inputs first, and the node itself last. So changing an input
+ * costs its downstream cone, and reading a value costs only the formulas that changed upstream of it.
+ * Assigning a value to a bound variable replaces its formula. A formula cannot depend on the variable it is bound to,
+ * also through the global variables read by the functions it calls, which are inputs as well, and which are
+ * collected again when one of those functions is redefined*/
+struct binding{
+    struct chunk *code;         // the formula, storing its result in the node
+    symbol_table **inputs;
+    int inputCount;
+};
+
+/*growable list of nodes*/
+struct node_list{
+    symbol_table **nodes;
+    int count;
+    int capacity;
+};
+
+/* entry of the explicit stack used to walk the graph, so that long chains of bindings cannot overflow the C stack*/
+struct walk_entry{
+    symbol_table *node;
+    int input;                  // next input of the node to visit
+};
+
+/*Binding function prototypes*/
+void bindNode(symbol_table *node, struct chunk *code, symbol_table **inputs, int inputCount);
+void unbind(symbol_table *node);
+void replaceInputs(symbol_table *node, symbol_table **inputs, int inputCount);
+bool dependsOn(symbol_table **inputs, int inputCount, symbol_table *node);
+void invalidate(symbol_table *node);
+void refreshBinding(symbol_table *node);
+void refreshAll();
+void pushWalk(symbol_table *node);
+void addToList(struct node_list **list, symbol_table *node);
+void removeFromList(struct node_list *list, symbol_table *node);
+void releaseBindings(symbol_table *node);
+void execute(struct chunk *chunk);     // defined in vm-utils.h
+void releaseCode(struct chunk *code);  // defined in vm-utils.h
+
+/* binds the node to the given formula, replacing the one it had, and marks it dirty along with its dependents.
+ * The node takes ownership of the code and of the inputs*/
+void bindNode(symbol_table *node, struct chunk *code, symbol_table **inputs, int inputCount){
+    unbind(node);
+    struct binding *binding = (struct binding *)malloc(sizeof(struct binding));
+    countAllocation(sizeof(struct binding));
+    if (binding == NULL){
+        printError("Error: could not allocate memory for the binding!\n");
+        sessionExit(1);
+    }
+    binding->code = code;
+    binding->inputs = inputs;
+    binding->inputCount = inputCount;
+    node->binding = binding;
+    for (int i = 0; i < inputCount; i++){
+        addToList(&inputs[i]->dependents, node);
+    }
+    node->dirty = true;
+    invalidate(node);
+}
+
+/* turns a bound node back into a plain variable, which keeps the last value computed*/
+void unbind(symbol_table *node){
+    struct binding *binding = node->binding;
+    if (binding == NULL){
+        return;
+    }
+    for (int i = 0; i < binding->inputCount; i++){
+        removeFromList(binding->inputs[i]->dependents, node);
+    }
+    releaseCode(binding->code);
+    free(binding->inputs);
+    free(binding);
+    node->binding = NULL;
+    node->dirty = false;
+}
+
+/* gives a bound node the inputs its formula reads now (after a function it calls has been redefined), taking ownership
+ * of them, and marks it dirty along with its dependents, since its formula may give another value*/
+void replaceInputs(symbol_table *node, symbol_table **inputs, int inputCount){
+    struct binding *binding = node->binding;
+    for (int i = 0; i < binding->inputCount; i++){
+        removeFromList(binding->inputs[i]->dependents, node);
+    }
+    free(binding->inputs);
+    binding->inputs = inputs;
+    binding->inputCount = inputCount;
+    for (int i = 0; i < inputCount; i++){
+        addToList(&inputs[i]->dependents, node);
+    }
+    node->dirty = true;
+    invalidate(node);
+}
+
+/* whether one of the inputs can be reached going downstream from the node, which would make a cycle of bindings.
+ * The walk goes downstream since a node being bound for the first time has no dependents, so it costs nothing*/
+bool dependsOn(symbol_table **inputs, int inputCount, symbol_table *node){
+    unsigned int mark = ++session->walkMark;
+    for (int i = 0; i < inputCount; i++){
+        if (inputs[i] == node){
+            return true;
+        }
+        inputs[i]->mark = mark;
+    }
+    if (node->dependents == NULL){
+        return false;
+    }
+    unsigned int visited = ++session->walkMark;
+    int base = session->walkCount;
+    pushWalk(node);
+    bool found = false;
+    while (session->walkCount > base && !found){
+        struct node_list *dependents = session->walk[--session->walkCount].node->dependents;
+        for (int i = 0; dependents != NULL && i < dependents->count && !found; i++){
+            symbol_table *dependent = dependents->nodes[i];
+            if (dependent->mark == mark){
+                found = true;
+            } else if (dependent->mark != visited){
+                dependent->mark = visited;
+                pushWalk(dependent);
+            }
+        }
+    }
+    session->walkCount = base;
+    return found;
+}
+
+/* marks every binding downstream of the node as dirty, after its value has changed*/
+void invalidate(symbol_table *node){
+    if (node->dependents == NULL){
+        return;
+    }
+    int base = session->walkCount;
+    pushWalk(node);
+    while (session->walkCount > base){
+        struct node_list *dependents = session->walk[--session->walkCount].node->dependents;
+        for (int i = 0; dependents != NULL && i < dependents->count; i++){
+            symbol_table *dependent = dependents->nodes[i];
+            if (!dependent->dirty){
+                dependent->dirty = true;
+                session->stats.invalidations++;
+                pushWalk(dependent);
+            }
+        }
+    }
+}
+
+/* brings a dirty node up to date: the graph is walked upstream through the dirty inputs, and every formula runs
+ * once all of its inputs have been brought up to date (clean inputs are up to date, and so is everything upstream of them)*/
+void refreshBinding(symbol_table *node){
+    int base = session->walkCount;
+    pushWalk(node);
+    while (session->walkCount > base){
+        struct walk_entry *entry = &session->walk[session->walkCount - 1];
+        symbol_table *current = entry->node;
+        if (entry->input < current->binding->inputCount){
+            symbol_table *input = current->binding->inputs[entry->input++];
+            if (input->dirty){
+                pushWalk(input);
+            }
+            continue;
+        }
+        session->walkCount--;
+        if (current->dirty){
+            session->stats.recomputations++;
+            execute(current->binding->code);
+            current->dirty = false;
+        }
+    }
+}
+
+// brings every dirty node up to date, before the whole table is printed
+void refreshAll(){
+    for (int slot = 0; slot < session->table->numberOfNodes; slot++){
+        if (session->table->slotTable[slot]->dirty){
+            refreshBinding(session->table->slotTable[slot]);
+        }
+    }
+}
+
+void pushWalk(symbol_table *node){
+    if (session->walkCount == session->walkCapacity){
+        session->walkCapacity = session->walkCapacity == 0 ? 64 : session->walkCapacity * 2;
+        session->walk = (struct walk_entry *)realloc(session->walk, session->walkCapacity * sizeof(struct walk_entry));
+        countAllocation(session->walkCapacity * sizeof(struct walk_entry));
+        if (session->walk == NULL){
+            printError("Error: could not allocate memory for the bindings!\n");
+            sessionExit(1);
+        }
+    }
+    session->walk[session->walkCount].node = node;
+    session->walk[session->walkCount].input = 0;
+    session->walkCount++;
+}
+
+// appends a node to a list, creating the list if it is NULL
+void addToList(struct node_list **list, symbol_table *node){
+    if (*list == NULL){
+        *list = (struct node_list *)calloc(1, sizeof(struct node_list));
+        countAllocation(sizeof(struct node_list));
+    }
+    if (*list != NULL && (*list)->count == (*list)->capacity){
+        (*list)->capacity = (*list)->capacity == 0 ? 4 : (*list)->capacity * 2;
+        (*list)->nodes = (symbol_table **)realloc((*list)->nodes, (*list)->capacity * sizeof(symbol_table *));
+        countAllocation((*list)->capacity * sizeof(symbol_table *));
+    }
+    if (*list == NULL || (*list)->nodes == NULL){
+        printError("Error: could not allocate memory for the bindings!\n");
+        sessionExit(1);
+    }
+    (*list)->nodes[(*list)->count++] = node;
+}
+
+// removes a node from a list, moving the last node in its place
+void removeFromList(struct node_list *list, symbol_table *node){
+    for (int i = 0; list != NULL && i < list->count; i++){
+        if (list->nodes[i] == node){
+            list->nodes[i] = list->nodes[--list->count];
+            return;
+        }
+    }
+}
+
+// frees the binding and the dependents of a node, when the session ends
+void releaseBindings(symbol_table *node){
+    if (node->binding != NULL){
+        releaseCode(node->binding->code);
+        free(node->binding->inputs);
+        free(node->binding);
+        node->binding = NULL;
+    }
+    if (node->dependents != NULL){
+        free(node->dependents->nodes);
+        free(node->dependents);
+        node->dependents = NULL;
+    }
+}
+
+#endif
@@ -0,0 +1,316 @@
+#ifndef FOLD_UTILS_H
+#define FOLD_UTILS_H
+
+#include <stdbool.h>
+#include "symboltable-utils.h"
+#include "ast-utils.h"
+#include "arithmetic-utils.h"
+#include "function-utils.h"
+
+/* CONSTANT FOLDING: before a statement is compiled its tree is simplified bottom-up.
+ * - operations whose operands are all literals are computed once, with the same kernels used at run time
+ *   (see arithmetic-utils.h), so the int/double promotion rules and string concatenation are unchanged
+ * - operations that would report an error (division by 0, strings in - * /, undefined operands)
+ *   are left to run time, so that the error is reported when and if the statement runs
+ * - x+0, 0+x, x-0, x*1, 1*x and x/1 become x, when x is known to be an integer
+ * - x*0 and 0*x become 0 when x is also a variable or a literal, since a thrown away subtree cannot report its error
+ * - conditions with a literal left operand are reduced according to && and ||
+ * The type of a subtree is known when it is made of literals and of variables whose type has been declared,
+ * since the type of a variable cannot change once declared.*/
+
+bool dumpFolded = false;    // print every statement after folding it (--dump-folded)
+
+/*Folding function prototypes*/
+struct ast_node *foldStatement(struct ast_node *statement);
+void foldStatementTrees(struct ast_node *statement);
+struct ast_node *foldTree(struct ast_node *tree);
+char staticType(struct ast_node *tree);
+bool isIntegerLiteral(struct ast_node *tree, int value);
+bool isFoldable(struct variable value);
+void dumpStatement(struct ast_node *statement);
+void dumpCommand(struct ast_node *statement);
+void dumpBlock(struct ast_node *statement);
+void dumpTree(struct ast_node *tree);
+
+struct ast_node *foldStatement(struct ast_node *statement){
+    foldStatementTrees(statement);
+    if (dumpFolded){
+        dumpStatement(statement);
+    }
+    return statement;
+}
+
+/* folds the expression or condition of a statement and, for loops, the statements they run*/
+void foldStatementTrees(struct ast_node *statement){
+    if (statement->left != NULL){
+        statement->left = foldTree(statement->left);
+    }
+    if (statement->kind == AST_FOR){
+        foldStatementTrees(statement->right);
+    }
+    for (struct ast_node *inner = statement->body; inner != NULL; inner = inner->next){
+        foldStatementTrees(inner);
+    }
+}
+
+struct ast_node *foldTree(struct ast_node *tree){
+    if (tree->kind == AST_VALUE || tree->kind == AST_ID || tree->kind == AST_PARAM){
+        return tree;
+    }
+    if (tree->kind == AST_CALL){
+        //the arguments are folded one by one, keeping them linked
+        for (struct ast_node **argument = &tree->left; *argument != NULL; argument = &(*argument)->next){
+            struct ast_node *next = (*argument)->next;
+            *argument = foldTree(*argument);
+            (*argument)->next = next;
+        }
+        return tree;
+    }
+    if (tree->kind == AST_CONDITIONAL){
+        tree->body = foldTree(tree->body);
+    }
+    tree->left = foldTree(tree->left);
+    if (tree->right != NULL){
+        tree->right = foldTree(tree->right);
+    }
+    struct ast_node *left = tree->left;
+    struct ast_node *right = tree->right;
+
+    switch (tree->kind){
+        case AST_UNARY:
+            if (left->kind == AST_VALUE && (valueType(left->value) == INTEGER_TYPE || valueType(left->value) == DOUBLE_TYPE)){
+                return newValue(UNARY_OPERATION(tree->op, left->value));
+            }
+            break;
+        case AST_BINARY:
+            if (left->kind == AST_VALUE && right->kind == AST_VALUE
+                && isFoldable(left->value) && isFoldable(right->value)){
+                bool numeric = valueType(left->value) != STRING_TYPE && valueType(right->value) != STRING_TYPE;
+                bool divisionByZero = tree->op == DIV_OP &&
+                        (valueType(right->value) == INTEGER_TYPE ? isIntegerLiteral(right, 0) : asDouble(right->value) == 0);
+                if ((numeric || tree->op == ADD_OP) && !divisionByZero){
+                    return newValue(BINARY_OPERATION(tree->op, left->value, right->value));
+                }
+            }
+            //integer identities
+            if (staticType(left) == INTEGER_TYPE && staticType(right) == INTEGER_TYPE){
+                if ((tree->op == ADD_OP && isIntegerLiteral(right, 0))
+                    || (tree->op == SUB_OP && isIntegerLiteral(right, 0))
+                    || (tree->op == MUL_OP && isIntegerLiteral(right, 1))
+                    || (tree->op == DIV_OP && isIntegerLiteral(right, 1))){
+                    return left;
+                }
+                if ((tree->op == ADD_OP && isIntegerLiteral(left, 0))
+                    || (tree->op == MUL_OP && isIntegerLiteral(left, 1))){
+                    return right;
+                }
+                //the operand thrown away must not be able to report an error, as (x / 0) * 0 would
+                if (tree->op == MUL_OP && isIntegerLiteral(right, 0) && (left->kind == AST_VALUE || left->kind == AST_ID)){
+                    return right;
+                }
+                if (tree->op == MUL_OP && isIntegerLiteral(left, 0) && (right->kind == AST_VALUE || right->kind == AST_ID)){
+                    return left;
+                }
+            }
+            break;
+        case AST_COMPARE:
+            if (left->kind == AST_VALUE && right->kind == AST_VALUE){
+                return newValue(integerValue(compareOperation(tree->op, left->value, right->value)));
+            }
+            break;
+        case AST_CONDITIONAL:
+            if (left->kind == AST_VALUE){
+                return asInteger(left->value) ? right : tree->body;
+            }
+            break;
+        case AST_LOGIC:
+            //conditions are always valued 0 or 1, so they can be returned as they are
+            if (left->kind == AST_VALUE){
+                bool truth = asInteger(left->value);
+                if (tree->op == AND_OP){
+                    return truth ? right : left;
+                } else {
+                    return truth ? left : right;
+                }
+            }
+            break;
+    }
+    return tree;
+}
+
+/* returns the type the subtree will have at run time, or UNDEFINED_TYPE if it cannot be known in advance*/
+char staticType(struct ast_node *tree){
+    switch (tree->kind){
+        case AST_VALUE:
+            return valueType(tree->value);
+        case AST_ID: {
+            struct node_state state = readNode(tree->node);
+            return state.type_declared ? valueType(state.value) : UNDEFINED_TYPE;
+        }
+        case AST_UNARY:
+            return staticType(tree->left);
+        case AST_CONDITIONAL:
+            return staticType(tree->right) == staticType(tree->body) ? staticType(tree->right) : UNDEFINED_TYPE;
+        case AST_BINARY: {
+            char left = staticType(tree->left);
+            char right = staticType(tree->right);
+            if ((left == INTEGER_TYPE || left == DOUBLE_TYPE) && (right == INTEGER_TYPE || right == DOUBLE_TYPE)){
+                return left == INTEGER_TYPE && right == INTEGER_TYPE ? INTEGER_TYPE : DOUBLE_TYPE;
+            }
+            return UNDEFINED_TYPE;
+        }
+        default:
+            return UNDEFINED_TYPE;
+    }
+}
+
+bool isIntegerLiteral(struct ast_node *tree, int value){
+    return tree->kind == AST_VALUE && valueType(tree->value) == INTEGER_TYPE && !isBigInteger(tree->value)
+           && asInteger(tree->value) == value;
+}
+
+// undefined values are never folded, since operations on them may report errors
+bool isFoldable(struct variable value){
+    return valueType(value) == INTEGER_TYPE || valueType(value) == DOUBLE_TYPE || valueType(value) == STRING_TYPE;
+}
+
+/* prints a statement in infix form, with every operation in parentheses (--dump-folded)*/
+void dumpStatement(struct ast_node *statement){
+    outPrintf("Folded: ");
+    dumpCommand(statement);
+    outPrintf("\n");
+}
+
+void dumpCommand(struct ast_node *statement){
+    static const char *typeNames[] = {"", "int ", "double ", "string "};
+    static const char *shorthands[] = {"+=", "-=", "*=", "/="};
+    switch (statement->kind){
+        case AST_PRINT_EXPR:
+        case AST_PRINT_COND:
+            dumpTree(statement->left);
+            break;
+        case AST_PRINT_TABLE:
+            outPrintf("print");
+            break;
+        case AST_PRINT_NODE:
+            outPrintf("print %s", statement->node->id);
+            break;
+        case AST_PRINT_TYPE:
+            outPrintf("type %s", statement->node->id);
+            break;
+        case AST_PRINT_STATS:
+            outPrintf("stats");
+            break;
+        case AST_SAVE:
+        case AST_LOAD:
+            outPrintf("%s \"%s\"", statement->kind == AST_SAVE ? "save" : "load", stringChars(&statement->value));
+            break;
+        case AST_IF:
+            outPrintf("if (");
+            dumpTree(statement->left);
+            outPrintf(") then {%s}", stringChars(&statement->value));
+            break;
+        case AST_TYPED_ASSIGN:
+        case AST_ASSIGN:
+            outPrintf("%s%s = ", typeNames[(int)statement->type], statement->node->id);
+            dumpTree(statement->left);
+            break;
+        case AST_TYPED_SHORTHAND:
+        case AST_SHORTHAND:
+            outPrintf("%s%s %s ", typeNames[(int)statement->type], statement->node->id, shorthands[(int)statement->op]);
+            dumpTree(statement->left);
+            break;
+        case AST_DECLARE:
+            outPrintf("%s%s", typeNames[(int)statement->type], statement->node->id);
+            break;
+        case AST_WHILE:
+            outPrintf("while (");
+            dumpTree(statement->left);
+            outPrintf(") ");
+            dumpBlock(statement->body);
+            break;
+        case AST_FOR:
+            //the step is printed as the last statement of the body, where it runs
+            outPrintf("for (");
+            dumpCommand(statement->right);
+            outPrintf("; ");
+            dumpTree(statement->left);
+            outPrintf(") ");
+            dumpBlock(statement->body);
+            break;
+        case AST_BIND:
+            outPrintf("%s := ", statement->node->id);
+            dumpTree(statement->left);
+            break;
+        case AST_DEFINE:
+            outPrintf("def %s(", session->functions[statement->index].name);
+            for (struct ast_node *parameter = statement->right; parameter != NULL; parameter = parameter->next){
+                outPrintf("%s%s", parameter->name, parameter->next != NULL ? ", " : "");
+            }
+            outPrintf(") = ");
+            dumpTree(statement->left);
+            break;
+    }
+}
+
+// prints the statements of a loop between braces
+void dumpBlock(struct ast_node *statement){
+    outPrintf("{");
+    for (; statement != NULL; statement = statement->next){
+        dumpCommand(statement);
+        outPrintf(statement->next != NULL ? "; " : "");
+    }
+    outPrintf("}");
+}
+
+void dumpTree(struct ast_node *tree){
+    static const char *operators[] = {"+", "-", "*", "/", "++", "--", "<", ">", "<=", ">=", "==", "!=", "&&", "||"};
+    switch (tree->kind){
+        case AST_VALUE:
+            if (valueType(tree->value) == INTEGER_TYPE){
+                outIntegerValue(tree->value);
+            } else if (valueType(tree->value) == DOUBLE_TYPE){
+                outDouble(asDouble(tree->value));
+            } else if (valueType(tree->value) == STRING_TYPE){
+                outPrintf("%s", stringChars(&tree->value));
+            }
+            break;
+        case AST_ID:
+            outPrintf("%s", tree->node->id);
+            break;
+        case AST_PARAM:
+            outPrintf("%s", tree->name);
+            break;
+        case AST_CALL:
+            outPrintf("%s(", session->functions[tree->index].name);
+            for (struct ast_node *argument = tree->left; argument != NULL; argument = argument->next){
+                dumpTree(argument);
+                outPrintf(argument->next != NULL ? ", " : "");
+            }
+            outPrintf(")");
+            break;
+        case AST_CONDITIONAL:
+            outPrintf("(");
+            dumpTree(tree->left);
+            outPrintf(" ? ");
+            dumpTree(tree->right);
+            outPrintf(" : ");
+            dumpTree(tree->body);
+            outPrintf(")");
+            break;
+        case AST_UNARY:
+            outPrintf("(");
+            dumpTree(tree->left);
+            outPrintf("%s)", operators[(int)tree->op]);
+            break;
+        default:
+            outPrintf("(");
+            dumpTree(tree->left);
+            outPrintf(" %s ", operators[(int)tree->op]);
+            dumpTree(tree->right);
+            outPrintf(")");
+            break;
+    }
+}
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef FUNCTION_UTILS_H
+#define FUNCTION_UTILS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "symboltable-utils.h"
+#include "ast-utils.h"
+
+/* USER-DEFINED FUNCTIONS: def name(a, b) = expr defines a function of its parameters, called as name(x, y).
+ * Parameters have a scope of their own, apart from the symbol-table: while the body is parsed their names are
+ * resolved to their position among the arguments (AST_PARAM), and any other name is a global variable.
+ * Calls are resolved to the index of the function by name, so a function can call itself or one defined later,
+ * and the body is compiled once, when the definition runs, into a chunk of its own (see compileFunction()
+ * in vm-utils.h), whose parameters are read from the arguments on the stack of the virtual machine.
+ * A function is pure when its body reads no global variable and only calls pure functions, since its result
+ * then only depends on its arguments: the results of pure functions are kept in a memo cache of memoCapacity
+ * entries, addressed by the hash of the arguments, where a new entry replaces the one it collides with.
+ * Only numeric arguments and results are memoized: strings may live in the statement arena, which does not
+ * outlive the statement. Big integer results are kept as owned copies, and handed out as temporary ones,
+ * since the entry may be replaced while the result is still in use; big integer arguments are not memoized.*/
+#define DEFAULT_MEMO_CAPACITY 4096
+#define MAX_CALL_DEPTH 10000        // nested calls, deeper ones report an error instead of running
+
+int memoCapacity = DEFAULT_MEMO_CAPACITY;  // entries of every memo cache, rounded up to a power of two, 0 disables them (--memo-size)
+
+struct chunk;
+
+struct function{
+    char *name;                     // interned, see intern-utils.h
+    int arity;
+    char **parameters;              // names of the parameters
+    struct chunk *code;             // NULL until the function is defined
+    bool readsGlobals;
+    bool pure;
+    int *callees;                   // functions called by the body
+    int calleeCount;
+    //memo cache
+    struct variable *memoArguments; // arity arguments for every entry
+    struct variable *memoResults;   // undefined for free entries
+    int memoMask;                   // entries - 1
+    uint64_t calls;
+    uint64_t memoHits;
+    uint64_t memoMisses;
+};
+
+/* stack frame of a running call, the caller goes on from ip once the callee returns*/
+struct call_frame{
+    const struct chunk *chunk;
+    const struct instruction *ip;
+    int base;                       // position of the first argument of the caller on the stack
+    int function;
+    bool memoize;                   // whether the result of the callee goes to its memo cache
+};
+
+/*Function prototypes*/
+int findFunction(char *name);
+void openScope(struct ast_node *parameters);
+void closeScope();
+struct ast_node *newName(char *name);
+struct ast_node *newParameter(char *name, struct ast_node *parameters);
+void collectDependencies(struct function *function, struct ast_node *tree);
+void updatePurity();
+bool memoLookup(struct function *function, const struct variable *arguments, struct variable *result);
+void memoStore(struct function *function, const struct variable *arguments, struct variable result);
+uint64_t memoHash(const struct variable *arguments, int count);
+bool isMemoizable(const struct variable *values, int count);
+void clearMemo(struct function *function);
+void freeMemo(struct function *function);
+void printFunctions();
+void releaseFunctions();
+void releaseCode(struct chunk *code);   // defined in vm-utils.h
+
+/* returns the index of the function with the given interned name, adding an undefined one if there is none yet*/
+int findFunction(char *name){
+    for (int i = 0; i < session->functionCount; i++){
+        if (session->functions[i].name == name){
+            return i;
+        }
+    }
+    if (session->functionCount == session->functionCapacity){
+        session->functionCapacity = session->functionCapacity == 0 ? 8 : session->functionCapacity * 2;
+        session->functions = (struct function *)realloc(session->functions, session->functionCapacity * sizeof(struct function));
+        countAllocation(session->functionCapacity * sizeof(struct function));
+        if (session->functions == NULL){
+            printError("Error: could not allocate memory for the functions!\n");
+            sessionExit(1);
+        }
+    }
+    struct function *function = &session->functions[session->functionCount];
+    memset(function, 0, sizeof(struct function));
+    function->name = name;
+    return session->functionCount++;
+}
+
+/* PARAMETER SCOPE: the parameters of the definition being parsed, a list of AST_PARAM nodes linked by next*/
+
+void openScope(struct ast_node *parameters){
+    session->scope = parameters;
+}
+
+// ends the definition being parsed, also when it had a syntax error
+void closeScope(){
+    session->scope = NULL;
+}
+
+/* resolves a name used in an expression: to a parameter of the function being defined if there is one
+ * with that name, to a global variable otherwise*/
+struct ast_node *newName(char *name){
+    for (struct ast_node *parameter = session->scope; parameter != NULL; parameter = parameter->next){
+        if (parameter->name == name){
+            struct ast_node *tree = newAstNode(AST_PARAM);
+            tree->name = name;
+            tree->index = parameter->index;
+            return tree;
+        }
+    }
+    return newId(findOrAdd(name));
+}
+
+// appends a parameter to the list of parameters of a definition, reporting duplicate names
+struct ast_node *newParameter(char *name, struct ast_node *parameters){
+    struct ast_node *tree = newAstNode(AST_PARAM);
+    tree->name = name;
+    for (struct ast_node *parameter = parameters; parameter != NULL; parameter = parameter->next){
+        if (parameter->name == name){
+            printWarning("Warning: parameter %s is declared twice, the first one is used!\n", name);
+        }
+        tree->index++;
+    }
+    return appendNode(parameters, tree);
+}
+
+/* PURITY*/
+
+/* records whether the body of the function reads global variables, and which functions it calls*/
+void collectDependencies(struct function *function, struct ast_node *tree){
+    switch (tree->kind){
+        case AST_ID:
+            function->readsGlobals = true;
+            break;
+        case AST_CALL:
+            function->callees = (int *)realloc(function->callees, (function->calleeCount + 1) * sizeof(int));
+            countAllocation((function->calleeCount + 1) * sizeof(int));
+            if (function->callees == NULL){
+                printError("Error: could not allocate memory for the functions!\n");
+                sessionExit(1);
+            }
+            function->callees[function->calleeCount++] = tree->index;
+            for (struct ast_node *argument = tree->left; argument != NULL; argument = argument->next){
+                collectDependencies(function, argument);
+            }
+            break;
+        default:
+            if (tree->left != NULL){
+                collectDependencies(function, tree->left);
+            }
+            if (tree->right != NULL){
+                collectDependencies(function, tree->right);
+            }
+            if (tree->body != NULL){
+                collectDependencies(function, tree->body);
+            }
+            break;
+    }
+}
+
+/* works out which functions are pure, after a definition: a function stops being pure when it reads
+ * global variables or calls a function that is not pure (or not defined), until nothing changes.
+ * The memo caches are emptied, since a result may depend on the function that has just been defined*/
+void updatePurity(){
+    for (int i = 0; i < session->functionCount; i++){
+        struct function *function = &session->functions[i];
+        function->pure = function->code != NULL && !function->readsGlobals;
+    }
+    bool changed = true;
+    while (changed){
+        changed = false;
+        for (int i = 0; i < session->functionCount; i++){
+            struct function *function = &session->functions[i];
+            for (int c = 0; c < function->calleeCount && function->pure; c++){
+                if (!session->functions[function->callees[c]].pure){
+                    function->pure = false;
+                    changed = true;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < session->functionCount; i++){
+        clearMemo(&session->functions[i]);
+    }
+}
+
+/* MEMO CACHE*/
+
+/* looks for the result cached for the given arguments of a pure function, returning false when it has to be computed*/
+bool memoLookup(struct function *function, const struct variable *arguments, struct variable *result){
+    if (!isMemoizable(arguments, function->arity)){
+        return false;
+    }
+    int entry = (int)(memoHash(arguments, function->arity) & function->memoMask);
+    struct variable *cached = &function->memoResults[entry];
+    if (valueType(*cached) == UNDEFINED_TYPE
+        || memcmp(&function->memoArguments[entry * function->arity], arguments, function->arity * sizeof(struct variable)) != 0){
+        function->memoMisses++;
+        session->stats.memoMisses++;
+        return false;
+    }
+    function->memoHits++;
+    session->stats.memoHits++;
+    *result = copyBigInteger(*cached, false);
+    return true;
+}
+
+/* caches the result of a call, replacing the entry that was in its place*/
+void memoStore(struct function *function, const struct variable *arguments, struct variable result){
+    if (!isMemoizable(arguments, function->arity) || (!isMemoizable(&result, 1) && !isBigInteger(result))){
+        return;
+    }
+    int entry = (int)(memoHash(arguments, function->arity) & function->memoMask);
+    memcpy(&function->memoArguments[entry * function->arity], arguments, function->arity * sizeof(struct variable));
+    freeBigInteger(&function->memoResults[entry]);
+    function->memoResults[entry] = copyBigInteger(result, true);
+}
+
+uint64_t memoHash(const struct variable *arguments, int count){
+    uint64_t hash = 0x9E3779B97F4A7C15u;
+    for (int i = 0; i < count; i++){
+        hash = (hash ^ arguments[i].bits) * 0xFF51AFD7ED558CCDu;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+bool isMemoizable(const struct variable *values, int count){
+    for (int i = 0; i < count; i++){
+        if ((valueType(values[i]) != INTEGER_TYPE && valueType(values[i]) != DOUBLE_TYPE) || isBigInteger(values[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+/* empties the memo cache of the function, allocating it the first time the function is found to be pure*/
+void clearMemo(struct function *function){
+    if (!function->pure || memoCapacity <= 0){
+        return;
+    }
+    if (function->memoResults == NULL){
+        int entries = 1;
+        while (entries < memoCapacity){
+            entries *= 2;
+        }
+        function->memoMask = entries - 1;
+        function->memoResults = (struct variable *)calloc(entries, sizeof(struct variable));
+        function->memoArguments = (struct variable *)calloc((size_t)entries * (function->arity > 0 ? function->arity : 1),
+                                                            sizeof(struct variable));
+        countAllocation(entries * sizeof(struct variable));
+        countAllocation(entries * sizeof(struct variable) * (function->arity > 0 ? function->arity : 1));
+        if (function->memoResults == NULL || function->memoArguments == NULL){
+            printError("Error: could not allocate memory for the memo cache!\n");
+            sessionExit(1);
+        }
+    }
+    for (int entry = 0; entry <= function->memoMask; entry++){
+        if (isBigInteger(function->memoResults[entry])){
+            freeBigInteger(&function->memoResults[entry]);
+        }
+        function->memoResults[entry] = undefinedValue();
+    }
+}
+
+/* prints the defined functions with their calls and memo cache statistics (part of the `stats` statement)*/
+void printFunctions(){
+    for (int i = 0; i < session->functionCount; i++){
+        struct function *function = &session->functions[i];
+        if (function->code == NULL){
+            continue;
+        }
+        outPrintf("Function %s(", function->name);
+        for (int p = 0; p < function->arity; p++){
+            outPrintf("%s%s", p > 0 ? ", " : "", function->parameters[p]);
+        }
+        outPrintf("): %s, %llu calls", function->pure ? "pure" : "not pure", (unsigned long long)function->calls);
+        if (function->pure && function->memoResults != NULL){
+            outPrintf(", memo cache %llu hits, %llu misses", (unsigned long long)function->memoHits,
+                      (unsigned long long)function->memoMisses);
+        }
+        outPrintf("\n");
+    }
+}
+
+// frees the functions and the call stack, when the session ends
+// frees the memo cache of the function, along with the big integers it owns
+void freeMemo(struct function *function){
+    for (int entry = 0; function->memoResults != NULL && entry <= function->memoMask; entry++){
+        freeBigInteger(&function->memoResults[entry]);
+    }
+    free(function->memoArguments);
+    free(function->memoResults);
+    function->memoArguments = function->memoResults = NULL;
+}
+
+void releaseFunctions(){
+    for (int i = 0; i < session->functionCount; i++){
+        struct function *function = &session->functions[i];
+        if (function->code != NULL){
+            releaseCode(function->code);
+        }
+        freeMemo(function);
+        free(function->parameters);
+        free(function->callees);
+    }
+    free(session->functions);
+    free(session->frames);
+    session->functions = NULL;
+    session->frames = NULL;
+    session->functionCount = session->functionCapacity = session->frameCapacity = 0;
+}
+
+#endif
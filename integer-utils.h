@@ -0,0 +1,540 @@
+#ifndef INTEGER_UTILS_H
+#define INTEGER_UTILS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "output-utils.h"
+#include "arena-utils.h"
+#include "number-utils.h"
+#include "variable-utils.h"
+
+/* BIG INTEGERS: integers that do not fit in the 48 bits of a value (see variable-utils.h) are arrays of 32-bit limbs,
+ * least significant first, with a sign. They are never modified once built, and like strings they are temporary
+ * (allocated in the statement arena) unless they belong to a variable, to compiled code or to a memo cache,
+ * which keep an owned copy on the heap.
+ * The integer kernels (see arithmetic-utils.h) compute on 64 bits with overflow checks, and only come here when
+ * an operand is big or the result overflows. Every result goes through finishInteger(), which stores it in the value
+ * itself again as soon as it fits, so integers only stay big for as long as they need to.
+ * Products of numbers of at least KARATSUBA_THRESHOLD limbs use Karatsuba's method, which replaces one of the four
+ * half-size products with additions, so factorials and large powers take O(n^1.585) instead of O(n^2) per product.
+ * Division truncates towards zero, as it does for small integers.*/
+#define KARATSUBA_THRESHOLD 32      // limbs, below this the schoolbook product is faster
+#define LIMB_BITS 32
+#define DECIMAL_LIMB 1000000000u    // 10^9, the largest power of ten that fits in a limb
+#define DECIMAL_LIMB_DIGITS 9
+
+struct big_integer{
+    bool owned;                 // heap copy belonging to a variable, rather than an arena one
+    bool negative;
+    int length;                 // limbs in use, the most significant one is never 0
+    uint32_t limbs[];
+};
+
+/* sign and limbs of any integer, which borrow those of a big integer or hold those of a small one*/
+struct magnitude{
+    const uint32_t *limbs;
+    int length;
+    bool negative;
+    uint32_t small[2];
+};
+
+/*Integer function prototypes*/
+struct big_integer *bigHeader(struct variable value);
+struct big_integer *allocateBig(int length, bool owned);
+struct variable bigFromInteger(int64_t integer);
+struct variable finishInteger(struct big_integer *big);
+struct variable copyBigInteger(struct variable value, bool owned);
+void freeBigInteger(struct variable *value);
+void toMagnitude(struct variable value, struct magnitude *magnitude);
+struct variable addIntegers(struct variable n1, struct variable n2);
+struct variable subIntegers(struct variable n1, struct variable n2);
+struct variable addSigned(struct magnitude *a, struct magnitude *b, bool negateB);
+struct variable mulIntegers(struct variable n1, struct variable n2);
+struct variable divIntegers(struct variable n1, struct variable n2);
+int compareIntegers(struct variable n1, struct variable n2);
+double integerToDouble(struct variable value);
+struct variable integerFromDouble(double real);
+struct variable integerLiteral(const char *text, size_t length);
+size_t formatIntegerValue(struct variable value, char *buffer, const char **text);
+void outIntegerValue(struct variable value);
+int compareLimbs(const uint32_t *a, int aLength, const uint32_t *b, int bLength);
+uint32_t addLimbs(uint32_t *out, const uint32_t *a, int aLength, const uint32_t *b, int bLength);
+void subLimbs(uint32_t *out, const uint32_t *a, int aLength, const uint32_t *b, int bLength);
+void mulLimbs(uint32_t *out, const uint32_t *a, int aLength, const uint32_t *b, int bLength);
+void schoolbookLimbs(uint32_t *out, const uint32_t *a, int aLength, const uint32_t *b, int bLength);
+void karatsubaLimbs(uint32_t *out, const uint32_t *a, const uint32_t *b, int length);
+void divLimbs(uint32_t *quotient, const uint32_t *a, int aLength, const uint32_t *b, int bLength);
+uint32_t divSmallLimbs(uint32_t *quotient, const uint32_t *a, int length, uint32_t divisor);
+uint32_t *allocateLimbs(int length);
+
+struct big_integer *bigHeader(struct variable value){
+    return (struct big_integer *)(uintptr_t)(value.bits & PAYLOAD_MASK);
+}
+
+// allocates a big integer of length limbs, all 0 (on the heap if owned, in the arena otherwise)
+struct big_integer *allocateBig(int length, bool owned){
+    size_t size = sizeof(struct big_integer) + (size_t)length * sizeof(uint32_t);
+    struct big_integer *big;
+    if (owned){
+        big = (struct big_integer *)malloc(size);
+        countAllocation(size);
+        if (big == NULL){
+            printError("Error: could not allocate memory for the integer!\n");
+            sessionExit(1);
+        }
+    } else {
+        big = (struct big_integer *)arenaAlloc(size);
+    }
+    memset(big, 0, size);
+    big->owned = owned;
+    big->length = length;
+    return big;
+}
+
+// temporary big integer holding a 64-bit integer, see integerValue()
+struct variable bigFromInteger(int64_t integer){
+    uint64_t magnitude = integer < 0 ? -(uint64_t)integer : (uint64_t)integer;
+    struct big_integer *big = allocateBig(2, false);
+    big->negative = integer < 0;
+    big->limbs[0] = (uint32_t)magnitude;
+    big->limbs[1] = (uint32_t)(magnitude >> LIMB_BITS);
+    return finishInteger(big);
+}
+
+/* drops the leading zero limbs of a result, and stores it in the value itself if it fits there*/
+struct variable finishInteger(struct big_integer *big){
+    while (big->length > 0 && big->limbs[big->length - 1] == 0){
+        big->length--;
+    }
+    if (big->length <= 2){
+        uint64_t magnitude = big->length == 0 ? 0 : big->limbs[0] | (big->length == 2 ? (uint64_t)big->limbs[1] << LIMB_BITS : 0);
+        if (magnitude <= (uint64_t)SMALL_INTEGER_MAX + big->negative){
+            int64_t integer = big->negative ? -(int64_t)magnitude : (int64_t)magnitude;
+            return boxValue(TAG_INTEGER, (uint64_t)integer & PAYLOAD_MASK);
+        }
+    }
+    return boxValue(TAG_BIG_INTEGER, (uint64_t)(uintptr_t)big);
+}
+
+// copy of a big integer, owned (to be kept) or temporary; other values are returned as they are
+struct variable copyBigInteger(struct variable value, bool owned){
+    if (!isBigInteger(value)){
+        return value;
+    }
+    struct big_integer *source = bigHeader(value);
+    struct big_integer *copy = allocateBig(source->length, owned);
+    copy->negative = source->negative;
+    memcpy(copy->limbs, source->limbs, source->length * sizeof(uint32_t));
+    return boxValue(TAG_BIG_INTEGER, (uint64_t)(uintptr_t)copy);
+}
+
+// releases an owned big integer, temporary ones are released all together by arenaReset()
+void freeBigInteger(struct variable *value){
+    if (isBigInteger(*value) && bigHeader(*value)->owned){
+        free(bigHeader(*value));
+    }
+    *value = integerValue(0);
+}
+
+void toMagnitude(struct variable value, struct magnitude *magnitude){
+    if (isBigInteger(value)){
+        struct big_integer *big = bigHeader(value);
+        magnitude->limbs = big->limbs;
+        magnitude->length = big->length;
+        magnitude->negative = big->negative;
+        return;
+    }
+    int64_t integer = asInteger(value);
+    uint64_t bits = integer < 0 ? -(uint64_t)integer : (uint64_t)integer;
+    magnitude->small[0] = (uint32_t)bits;
+    magnitude->small[1] = (uint32_t)(bits >> LIMB_BITS);
+    magnitude->limbs = magnitude->small;
+    magnitude->length = bits == 0 ? 0 : magnitude->small[1] == 0 ? 1 : 2;
+    magnitude->negative = integer < 0;
+}
+
+/* SIGNED OPERATIONS, called by the integer kernels once the 64-bit fast path does not apply*/
+
+struct variable addIntegers(struct variable n1, struct variable n2){
+    struct magnitude a, b;
+    toMagnitude(n1, &a);
+    toMagnitude(n2, &b);
+    return addSigned(&a, &b, false);
+}
+
+struct variable subIntegers(struct variable n1, struct variable n2){
+    struct magnitude a, b;
+    toMagnitude(n1, &a);
+    toMagnitude(n2, &b);
+    return addSigned(&a, &b, true);
+}
+
+// a + b, or a - b when negateB: the magnitudes are added when the signs agree, otherwise the smaller is subtracted
+struct variable addSigned(struct magnitude *a, struct magnitude *b, bool negateB){
+    bool bNegative = b->negative != negateB;
+    int length = (a->length > b->length ? a->length : b->length) + 1;
+    struct big_integer *result = allocateBig(length, false);
+    if (a->negative == bNegative){
+        if (a->length >= b->length){
+            result->limbs[length - 1] = addLimbs(result->limbs, a->limbs, a->length, b->limbs, b->length);
+        } else {
+            result->limbs[length - 1] = addLimbs(result->limbs, b->limbs, b->length, a->limbs, a->length);
+        }
+        result->negative = a->negative;
+    } else if (compareLimbs(a->limbs, a->length, b->limbs, b->length) >= 0){
+        subLimbs(result->limbs, a->limbs, a->length, b->limbs, b->length);
+        result->negative = a->negative;
+    } else {
+        subLimbs(result->limbs, b->limbs, b->length, a->limbs, a->length);
+        result->negative = bNegative;
+    }
+    return finishInteger(result);
+}
+
+struct variable mulIntegers(struct variable n1, struct variable n2){
+    struct magnitude a, b;
+    toMagnitude(n1, &a);
+    toMagnitude(n2, &b);
+    if (a.length == 0 || b.length == 0){
+        return integerValue(0);
+    }
+    struct big_integer *result = allocateBig(a.length + b.length, false);
+    mulLimbs(result->limbs, a.limbs, a.length, b.limbs, b.length);
+    result->negative = a.negative != b.negative;
+    return finishInteger(result);
+}
+
+// quotient truncated towards zero, the divisor is not 0 (the division kernel checks it)
+struct variable divIntegers(struct variable n1, struct variable n2){
+    struct magnitude a, b;
+    toMagnitude(n1, &a);
+    toMagnitude(n2, &b);
+    if (compareLimbs(a.limbs, a.length, b.limbs, b.length) < 0){
+        return integerValue(0);
+    }
+    struct big_integer *result = allocateBig(a.length - b.length + 1, false);
+    if (b.length == 1){
+        divSmallLimbs(result->limbs, a.limbs, a.length, b.limbs[0]);
+    } else {
+        divLimbs(result->limbs, a.limbs, a.length, b.limbs, b.length);
+    }
+    result->negative = a.negative != b.negative;
+    return finishInteger(result);
+}
+
+// -1, 0 or 1 as n1 is smaller than, equal to or greater than n2
+int compareIntegers(struct variable n1, struct variable n2){
+    struct magnitude a, b;
+    toMagnitude(n1, &a);
+    toMagnitude(n2, &b);
+    if (a.negative != b.negative){
+        return a.negative ? -1 : 1;
+    }
+    int order = compareLimbs(a.limbs, a.length, b.limbs, b.length);
+    return a.negative ? -order : order;
+}
+
+/* CONVERSIONS*/
+
+// nearest double to an integer (big integers beyond the range of doubles become infinite)
+double integerToDouble(struct variable value){
+    if (!isBigInteger(value)){
+        return (double)asInteger(value);
+    }
+    struct big_integer *big = bigHeader(value);
+    double real = 0;
+    for (int i = big->length - 1; i >= 0; i--){
+        real = real * 4294967296.0 + big->limbs[i];
+    }
+    return big->negative ? -real : real;
+}
+
+/* integer part of a double, which can be big: a double is an integer of 53 bits times a power of two.
+ * Infinities and NaNs have no integer part, and give an undefined value*/
+struct variable integerFromDouble(double real){
+    if (real != real || real == INFINITY || real == -INFINITY){
+        return undefinedValue();
+    }
+    if (real > -9.2e18 && real < 9.2e18){
+        return integerValue((int64_t)real);
+    }
+    int exponent;
+    double fraction = frexp(real < 0 ? -real : real, &exponent);
+    uint64_t mantissa = (uint64_t)ldexp(fraction, 53);
+    int shift = exponent - 53;      // at least 10, since |real| >= 2^63
+    int length = shift / LIMB_BITS + 3;
+    struct big_integer *big = allocateBig(length, false);
+    int bit = shift % LIMB_BITS;
+    big->limbs[shift / LIMB_BITS] = (uint32_t)(mantissa << bit);
+    big->limbs[shift / LIMB_BITS + 1] = (uint32_t)(mantissa >> (LIMB_BITS - bit));
+    big->limbs[shift / LIMB_BITS + 2] = (uint32_t)((mantissa >> (LIMB_BITS - bit)) >> LIMB_BITS);
+    big->negative = real < 0;
+    return finishInteger(big);
+}
+
+/* value of an integer literal of any length: literals that fit in 64 bits are converted directly,
+ * longer ones 9 digits at a time (multiplying by 10^9 and adding the next 9 digits)*/
+struct variable integerLiteral(const char *text, size_t length){
+    int64_t integer;
+    if (parseInteger(text, length, &integer)){
+        return integerValue(integer);
+    }
+    int limbs = (int)(length / DECIMAL_LIMB_DIGITS) + 2;
+    struct big_integer *big = allocateBig(limbs, false);
+    int used = 0;
+    size_t position = 0;
+    while (position < length){
+        size_t digits = (length - position) % DECIMAL_LIMB_DIGITS;
+        digits = digits == 0 ? DECIMAL_LIMB_DIGITS : digits;
+        uint64_t carry = 0;
+        uint32_t scale = 1;
+        for (size_t i = 0; i < digits; i++){
+            carry = carry * 10 + (text[position + i] - '0');
+            scale *= 10;
+        }
+        position += digits;
+        for (int i = 0; i < used; i++){
+            uint64_t product = (uint64_t)big->limbs[i] * scale + carry;
+            big->limbs[i] = (uint32_t)product;
+            carry = product >> LIMB_BITS;
+        }
+        if (carry != 0){
+            big->limbs[used++] = (uint32_t)carry;
+        }
+    }
+    big->length = used;
+    return finishInteger(big);
+}
+
+/* writes the decimal digits of an integer, returning their number: small integers are written into the buffer
+ * (NUMBER_TEXT_SIZE characters), big ones into the arena, by dividing them by 10^9 until nothing is left*/
+size_t formatIntegerValue(struct variable value, char *buffer, const char **text){
+    if (!isBigInteger(value)){
+        *text = buffer;
+        return formatInteger(buffer, asInteger(value));
+    }
+    struct big_integer *big = bigHeader(value);
+    uint32_t *limbs = allocateLimbs(big->length);
+    memcpy(limbs, big->limbs, big->length * sizeof(uint32_t));
+    size_t capacity = (size_t)big->length * 10 + 2;     // a limb has less than 10 digits
+    char *digits = (char *)arenaAlloc(capacity + 1);
+    size_t position = capacity;
+    digits[position] = '\0';
+    int length = big->length;
+    while (length > 0){
+        uint32_t remainder = divSmallLimbs(limbs, limbs, length, DECIMAL_LIMB);
+        while (length > 0 && limbs[length - 1] == 0){
+            length--;
+        }
+        for (int i = 0; i < DECIMAL_LIMB_DIGITS && (length > 0 || remainder != 0); i++){
+            digits[--position] = '0' + remainder % 10;
+            remainder /= 10;
+        }
+    }
+    if (big->negative){
+        digits[--position] = '-';
+    }
+    free(limbs);
+    *text = digits + position;
+    return capacity - position;
+}
+
+// writes an integer of any size into the output buffer
+void outIntegerValue(struct variable value){
+    char buffer[NUMBER_TEXT_SIZE];
+    const char *text;
+    size_t length = formatIntegerValue(value, buffer, &text);
+    outWrite(text, length);
+}
+
+/* LIMB ARITHMETIC on magnitudes, least significant limb first*/
+
+int compareLimbs(const uint32_t *a, int aLength, const uint32_t *b, int bLength){
+    if (aLength != bLength){
+        return aLength < bLength ? -1 : 1;
+    }
+    for (int i = aLength - 1; i >= 0; i--){
+        if (a[i] != b[i]){
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// out = a + b for aLength >= bLength, out has aLength limbs and the carry out is returned
+uint32_t addLimbs(uint32_t *out, const uint32_t *a, int aLength, const uint32_t *b, int bLength){
+    uint64_t carry = 0;
+    for (int i = 0; i < aLength; i++){
+        carry += (uint64_t)a[i] + (i < bLength ? b[i] : 0);
+        out[i] = (uint32_t)carry;
+        carry >>= LIMB_BITS;
+    }
+    return (uint32_t)carry;
+}
+
+// out = a - b for a >= b, out has aLength limbs
+void subLimbs(uint32_t *out, const uint32_t *a, int aLength, const uint32_t *b, int bLength){
+    int64_t borrow = 0;
+    for (int i = 0; i < aLength; i++){
+        int64_t difference = (int64_t)a[i] - (i < bLength ? b[i] : 0) - borrow;
+        borrow = difference < 0;
+        out[i] = (uint32_t)(difference + (borrow << LIMB_BITS));
+    }
+}
+
+/* out = a * b, out has aLength + bLength limbs set to 0. Long enough operands go through karatsubaLimbs(),
+ * the longer one in slices as long as the shorter one, since Karatsuba's method splits operands of equal length*/
+void mulLimbs(uint32_t *out, const uint32_t *a, int aLength, const uint32_t *b, int bLength){
+    if (aLength < bLength){
+        mulLimbs(out, b, bLength, a, aLength);
+        return;
+    }
+    if (bLength < KARATSUBA_THRESHOLD){
+        schoolbookLimbs(out, a, aLength, b, bLength);
+        return;
+    }
+    uint32_t *slice = allocateLimbs(bLength);
+    uint32_t *product = allocateLimbs(2 * bLength);
+    for (int offset = 0; offset < aLength; offset += bLength){
+        int sliceLength = aLength - offset < bLength ? aLength - offset : bLength;
+        memset(slice, 0, bLength * sizeof(uint32_t));
+        memcpy(slice, a + offset, sliceLength * sizeof(uint32_t));
+        karatsubaLimbs(product, slice, b, bLength);
+        int productLength = sliceLength + bLength;      // the rest of the product is 0
+        int outLength = aLength + bLength - offset;
+        uint32_t carry = addLimbs(out + offset, out + offset, productLength, product, productLength);
+        for (int i = productLength; carry != 0 && i < outLength; i++){
+            carry = ++out[offset + i] == 0;
+        }
+    }
+    free(slice);
+    free(product);
+}
+
+void schoolbookLimbs(uint32_t *out, const uint32_t *a, int aLength, const uint32_t *b, int bLength){
+    for (int i = 0; i < bLength; i++){
+        uint64_t carry = 0;
+        for (int j = 0; j < aLength; j++){
+            carry += (uint64_t)a[j] * b[i] + out[i + j];
+            out[i + j] = (uint32_t)carry;
+            carry >>= LIMB_BITS;
+        }
+        out[i + aLength] = (uint32_t)carry;
+    }
+}
+
+/* out = a * b for operands of the same length, out has 2 * length limbs (not necessarily 0).
+ * With a = a1 * B + a0 and b = b1 * B + b0, where B is the limb base raised to half the length:
+ * a * b = z2 * B^2 + (z1 - z2 - z0) * B + z0, where z2 = a1 * b1, z0 = a0 * b0 and z1 = (a1 + a0) * (b1 + b0)*/
+void karatsubaLimbs(uint32_t *out, const uint32_t *a, const uint32_t *b, int length){
+    memset(out, 0, 2 * length * sizeof(uint32_t));
+    if (length < KARATSUBA_THRESHOLD){
+        schoolbookLimbs(out, a, length, b, length);
+        return;
+    }
+    int low = length / 2;
+    int high = length - low;        // high >= low
+    uint32_t *sums = allocateLimbs(2 * (high + 1));
+    uint32_t *middle = allocateLimbs(2 * (high + 1));
+    uint32_t *aSum = sums;
+    uint32_t *bSum = sums + high + 1;
+    aSum[high] = addLimbs(aSum, a + low, high, a, low);
+    bSum[high] = addLimbs(bSum, b + low, high, b, low);
+    karatsubaLimbs(middle, aSum, bSum, high + 1);
+    karatsubaLimbs(out, a, b, low);                         // z0 in out[0 .. 2 * low)
+    karatsubaLimbs(out + 2 * low, a + low, b + low, high);  // z2 in out[2 * low .. 2 * length)
+    int middleLength = 2 * (high + 1);
+    subLimbs(middle, middle, middleLength, out, 2 * low);
+    subLimbs(middle, middle, middleLength, out + 2 * low, 2 * high);
+    while (middleLength > 0 && middle[middleLength - 1] == 0){
+        middleLength--;     // z1 - z2 - z0 fits in the product once shifted, its top limbs are 0
+    }
+    uint32_t carry = addLimbs(out + low, out + low, 2 * length - low, middle, middleLength);
+    (void)carry;            // 0, the product fits in 2 * length limbs
+    free(sums);
+    free(middle);
+}
+
+/* quotient of a / b, for bLength >= 2 and a >= b: Knuth's algorithm D, which estimates every limb of the quotient
+ * from the top limbs of the remainder and of b, normalised so that the top bit of b is set, and corrects
+ * the estimate (which is at most 2 too large) before subtracting. The quotient has aLength - bLength + 1 limbs*/
+void divLimbs(uint32_t *quotient, const uint32_t *a, int aLength, const uint32_t *b, int bLength){
+    int shift = __builtin_clz(b[bLength - 1]);
+    uint32_t *divisor = allocateLimbs(bLength);
+    uint32_t *remainder = allocateLimbs(aLength + 1);
+    for (int i = bLength - 1; i > 0; i--){
+        divisor[i] = (b[i] << shift) | (shift == 0 ? 0 : b[i - 1] >> (LIMB_BITS - shift));
+    }
+    divisor[0] = b[0] << shift;
+    remainder[aLength] = shift == 0 ? 0 : a[aLength - 1] >> (LIMB_BITS - shift);
+    for (int i = aLength - 1; i > 0; i--){
+        remainder[i] = (a[i] << shift) | (shift == 0 ? 0 : a[i - 1] >> (LIMB_BITS - shift));
+    }
+    remainder[0] = a[0] << shift;
+
+    const uint64_t base = (uint64_t)1 << LIMB_BITS;
+    for (int j = aLength - bLength; j >= 0; j--){
+        uint64_t top = (uint64_t)remainder[j + bLength] << LIMB_BITS | remainder[j + bLength - 1];
+        uint64_t estimate = top / divisor[bLength - 1];
+        uint64_t rest = top % divisor[bLength - 1];
+        while (estimate >= base || estimate * divisor[bLength - 2] > (rest << LIMB_BITS | remainder[j + bLength - 2])){
+            estimate--;
+            rest += divisor[bLength - 1];
+            if (rest >= base){
+                break;
+            }
+        }
+        int64_t borrow = 0;
+        int64_t difference;
+        for (int i = 0; i < bLength; i++){
+            uint64_t product = estimate * divisor[i];
+            difference = (int64_t)remainder[i + j] - borrow - (int64_t)(product & 0xFFFFFFFF);
+            remainder[i + j] = (uint32_t)difference;
+            borrow = (int64_t)(product >> LIMB_BITS) - (difference >> LIMB_BITS);
+        }
+        difference = (int64_t)remainder[j + bLength] - borrow;
+        remainder[j + bLength] = (uint32_t)difference;
+        quotient[j] = (uint32_t)estimate;
+        if (difference < 0){
+            //the estimate was 1 too large: b is added back
+            quotient[j]--;
+            uint64_t carry = 0;
+            for (int i = 0; i < bLength; i++){
+                carry += (uint64_t)remainder[i + j] + divisor[i];
+                remainder[i + j] = (uint32_t)carry;
+                carry >>= LIMB_BITS;
+            }
+            remainder[j + bLength] += (uint32_t)carry;
+        }
+    }
+    free(divisor);
+    free(remainder);
+}
+
+// quotient = a / divisor (quotient may be a itself), returning the remainder
+uint32_t divSmallLimbs(uint32_t *quotient, const uint32_t *a, int length, uint32_t divisor){
+    uint64_t remainder = 0;
+    for (int i = length - 1; i >= 0; i--){
+        uint64_t current = remainder << LIMB_BITS | a[i];
+        quotient[i] = (uint32_t)(current / divisor);
+        remainder = current % divisor;
+    }
+    return (uint32_t)remainder;
+}
+
+// scratch limbs of the operations above, freed by them
+uint32_t *allocateLimbs(int length){
+    uint32_t *limbs = (uint32_t *)malloc((length > 0 ? length : 1) * sizeof(uint32_t));
+    countAllocation((length > 0 ? length : 1) * sizeof(uint32_t));
+    if (limbs == NULL){
+        printError("Error: could not allocate memory for the integer!\n");
+        sessionExit(1);
+    }
+    return limbs;
+}
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef INTERN_UTILS_H
+#define INTERN_UTILS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output-utils.h"
+#include "shared-utils.h"
+
+/* IDENTIFIER INTERNING: every distinct identifier is stored exactly once in the pool below.
+ * The lexer hands out a pointer to the interned characters (the "handle"), so two handles
+ * are equal if and only if the identifiers are equal, and the symbol-table can compare
+ * pointers instead of strings. The header placed right before the characters caches
+ * the hash and the length of the identifier.*/
+struct interned_string{
+    unsigned int hash;
+    size_t length;
+    char chars[];   // null-terminated, this is what the handle points to
+};
+
+/* the pool itself (one per table, see session-utils.h): open-addressing set (linear probing) of interned strings,
+ * while the strings are carved out of large blocks, so interning allocates
+ * only when a block is exhausted*/
+const size_t INITIAL_INTERN_CAPACITY = 256;
+const size_t INTERN_BLOCK_SIZE = 64 * 1024;
+
+/*Interning function prototypes*/
+char *intern(const char *string, size_t length);
+char *findInterned(const char *string, size_t length, unsigned int hash);
+char *addInterned(const char *string, size_t length, unsigned int hash);
+unsigned int internedHash(const char *handle);
+size_t internedLength(const char *handle);
+unsigned int hashChars(const char *string, size_t length);
+void growInternPool();
+void releaseInternPool();
+
+/* returns the handle of the given identifier, adding it to the pool if it was not interned yet.
+ * Looking up takes no lock, adding takes the write lock of a shared table (see shared-utils.h)*/
+char *intern(const char *string, size_t length){
+    unsigned int hash = hashChars(string, length);
+    char *handle = findInterned(string, length, hash);
+    if (handle == NULL){
+        lockTable();
+        handle = findInterned(string, length, hash);    // another writer may have added it in the meantime
+        if (handle == NULL){
+            handle = addInterned(string, length, hash);
+        }
+        unlockTable();
+    }
+    return handle;
+}
+
+// returns the handle of the given identifier, NULL if it is not in the pool
+char *findInterned(const char *string, size_t length, unsigned int hash){
+    struct table *table = session->table;
+    struct interned_string **slots;
+    size_t capacity;
+    unsigned int version;
+    do {
+        version = readTableVersion();
+        slots = __atomic_load_n(&table->internSlots, __ATOMIC_RELAXED);
+        capacity = __atomic_load_n(&table->internCapacity, __ATOMIC_RELAXED);
+    } while (tableChanged(version));
+
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+    struct interned_string *entry;
+    while (capacity > 0 && (entry = loadShared(slots[i])) != NULL){
+        if (entry->hash == hash && entry->length == length && memcmp(entry->chars, string, length) == 0){
+            return entry->chars;
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+/* copies the identifier into the current block and adds it to the pool, which must not hold it yet*/
+char *addInterned(const char *string, size_t length, unsigned int hash){
+    struct table *table = session->table;
+    if ((table->internCount + 1) * 4 > table->internCapacity * 3){
+        growInternPool();
+    }
+    size_t size = (sizeof(struct interned_string) + length + 1 + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    if (size > table->internBlockLeft){
+        size_t blockSize = size > INTERN_BLOCK_SIZE ? size : INTERN_BLOCK_SIZE;
+        char *block = (char *)malloc(sizeof(char *) + blockSize);
+        countAllocation(sizeof(char *) + blockSize);
+        if (block == NULL){
+            printError("Error: could not allocate memory for the identifier pool!\n");
+            sessionExit(1);
+        }
+        *(char **)block = table->internBlocks;
+        table->internBlocks = block;
+        table->internBlock = block + sizeof(char *);
+        table->internBlockLeft = blockSize;
+    }
+    struct interned_string *entry = (struct interned_string *)table->internBlock;
+    table->internBlock += size;
+    table->internBlockLeft -= size;
+
+    entry->hash = hash;
+    entry->length = length;
+    memcpy(entry->chars, string, length);
+    entry->chars[length] = '\0';
+
+    size_t mask = table->internCapacity - 1;
+    size_t i = hash & mask;
+    while (table->internSlots[i] != NULL){
+        i = (i + 1) & mask;
+    }
+    publish(table->internSlots[i], entry);     // the entry is complete before readers can find it
+    table->internCount++;
+    return entry->chars;
+}
+
+// returns the hash cached in front of an interned handle
+unsigned int internedHash(const char *handle){
+    return ((const struct interned_string *)(handle - offsetof(struct interned_string, chars)))->hash;
+}
+
+// returns the length cached in front of an interned handle
+size_t internedLength(const char *handle){
+    return ((const struct interned_string *)(handle - offsetof(struct interned_string, chars)))->length;
+}
+
+/* FNV-1a hash of the first length characters of a string*/
+unsigned int hashChars(const char *string, size_t length){
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++){
+        hash ^= (unsigned char)string[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Doubles the capacity of the pool (or creates it), re-inserting every string by its cached hash.
+ * The new slots replace the old ones as a whole, which readers may still be probing (see shared-utils.h)*/
+void growInternPool(){
+    struct table *table = session->table;
+    size_t newCapacity = table->internCapacity == 0 ? INITIAL_INTERN_CAPACITY : table->internCapacity * 2;
+    struct interned_string **newSlots = (struct interned_string **)calloc(newCapacity, sizeof(struct interned_string *));
+    countAllocation(newCapacity * sizeof(struct interned_string *));
+    if (newSlots == NULL){
+        printError("Error: could not allocate memory for the identifier pool!\n");
+        sessionExit(1);
+    }
+    size_t mask = newCapacity - 1;
+    for (size_t j = 0; j < table->internCapacity; j++){
+        if (table->internSlots[j] != NULL){
+            size_t i = table->internSlots[j]->hash & mask;
+            while (newSlots[i] != NULL){
+                i = (i + 1) & mask;
+            }
+            newSlots[i] = table->internSlots[j];
+        }
+    }
+    struct interned_string **oldSlots = table->internSlots;
+    beginTableChange();
+    __atomic_store_n(&table->internSlots, newSlots, __ATOMIC_RELAXED);
+    __atomic_store_n(&table->internCapacity, newCapacity, __ATOMIC_RELAXED);
+    endTableChange();
+    retireMemory(oldSlots);
+}
+
+// frees the pool and every identifier in it, when the session (or the shared table) ends
+void releaseInternPool(){
+    struct table *table = session->table;
+    while (table->internBlocks != NULL){
+        char *previous = *(char **)table->internBlocks;
+        free(table->internBlocks);
+        table->internBlocks = previous;
+    }
+    free(table->internSlots);
+    table->internSlots = NULL;
+    table->internCapacity = table->internCount = 0;
+    table->internBlock = NULL;
+    table->internBlockLeft = 0;
+}
+
+#endif
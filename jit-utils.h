@@ -0,0 +1,533 @@
+#ifndef JIT_UTILS_H
+#define JIT_UTILS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output-utils.h"
+#include "variable-utils.h"
+#include "symboltable-utils.h"
+#include "stats-utils.h"
+#include "vm-utils.h"
+
+/* NATIVE CODE (--jit): the numeric expressions of hot code are compiled to x86-64 machine code, one template of
+ * instructions per bytecode instruction, into executable pages of their own.
+ * - the code is hot when a loop has iterated, or a function or a formula has run, JIT_THRESHOLD times
+ *   (see execute() in vm-utils.h), and every expression it holds made of numbers, variables, parameters and
+ *   the operators + - * / ++ -- and comparisons is compiled, for the types its operands hold at that moment
+ * - the first instruction of the expression becomes OP_NATIVE, which calls the machine code and goes on
+ *   after the expression. The rest of the bytecode stays where it was
+ * - the machine code keeps the stack of the expression in registers: integers of up to 48 bits in rcx, r8-r11
+ *   and doubles in xmm0-xmm4, so expressions deeper than 5 values are left to the bytecode
+ * - guards check what the types were compiled for: a variable holding another type or bound to a formula that
+ *   has to run again, an integer result that does not fit in 48 bits and a division by 0 all make the machine
+ *   code return JIT_BAIL, and the bytecode of the expression runs instead, which reports the error or promotes
+ *   to big integers as usual. A fragment whose guards keep failing is given up for the bytecode
+ * - arithmetic is counted in the statistics as by the kernels (see arithmetic-utils.h), once the guards have passed,
+ *   so a chunk only runs the code compiled by its own session
+ * Elsewhere than on x86-64, --jit is not available and the bytecode always runs.*/
+#define JIT_MAX_DEPTH 5     // values an expression keeps on its stack
+
+struct native_pages{
+    void *address;
+    size_t size;
+    struct native_pages *next;
+};
+
+/*JIT function prototypes*/
+void jitChunk(struct chunk *chunk, int start, int end, symbol_table **slots, const struct variable *arguments);
+void releaseNative(struct chunk *chunk);
+
+#if defined(__x86_64__)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// registers holding the stack of an expression, by depth: integers in general-purpose registers, doubles in xmm0-4
+const unsigned char JIT_INTEGER_REGISTERS[JIT_MAX_DEPTH] = {1, 8, 9, 10, 11};   // rcx, r8, r9, r10, r11
+enum{
+    RAX = 0, RCX = 1, RDX = 2, RSI = 6, RDI = 7,   // rax and rdx are scratch, rdi holds slots and rsi arguments
+    XMM_SCRATCH = 7
+};
+
+// machine code being generated, with the jumps to the bail-out of the fragment to patch once it is emitted
+struct machine_code{
+    unsigned char *bytes;
+    int length;
+    int capacity;
+    int *bails;             // offsets of the rel32 of the jumps to the bail-out
+    int bailCount;
+    int bailCapacity;
+};
+
+// a fragment being compiled
+struct native_draft{
+    int start;              // first instruction of the expression
+    int end;                // instruction following it
+    int offset;             // start of its machine code
+};
+
+/*Machine code function prototypes*/
+int scanFragment(const struct chunk *chunk, int start, int end, symbol_table **slots, const struct variable *arguments,
+                 char *types);
+char operandType(const struct chunk *chunk, const struct instruction *instruction, symbol_table **slots,
+                 const struct variable *arguments);
+void compileFragment(struct machine_code *code, const struct chunk *chunk, int start, int end, const char *types);
+void emitByte(struct machine_code *code, unsigned char byte);
+void emitBytes(struct machine_code *code, const unsigned char *bytes, int count);
+void emitInt32(struct machine_code *code, int32_t value);
+void emitInt64(struct machine_code *code, uint64_t value);
+void emitRegister(struct machine_code *code, unsigned char prefix, int opcodeLength, const unsigned char *opcode,
+                  int reg, int rm);
+void emitMoveImmediate(struct machine_code *code, int reg, uint64_t value);
+void emitBail(struct machine_code *code, unsigned char condition);
+void emitSmallIntegerGuard(struct machine_code *code, int reg);
+void emitGuardedLoad(struct machine_code *code, int base, int32_t displacement, bool dirtyGuard, char type, int depth);
+void emitToDouble(struct machine_code *code, int depth, char *types);
+
+void emitByte(struct machine_code *code, unsigned char byte){
+    if (code->length == code->capacity){
+        code->capacity = code->capacity == 0 ? 4096 : code->capacity * 2;
+        code->bytes = (unsigned char *)realloc(code->bytes, code->capacity);
+        countAllocation(code->capacity);
+        if (code->bytes == NULL){
+            printError("Error: could not allocate memory for the machine code!\n");
+            sessionExit(1);
+        }
+    }
+    code->bytes[code->length++] = byte;
+}
+
+void emitBytes(struct machine_code *code, const unsigned char *bytes, int count){
+    for (int i = 0; i < count; i++){
+        emitByte(code, bytes[i]);
+    }
+}
+
+void emitInt32(struct machine_code *code, int32_t value){
+    for (int i = 0; i < 4; i++){
+        emitByte(code, (uint32_t)value >> (8 * i));
+    }
+}
+
+void emitInt64(struct machine_code *code, uint64_t value){
+    for (int i = 0; i < 8; i++){
+        emitByte(code, value >> (8 * i));
+    }
+}
+
+/* register to register instruction on 64 bits: [prefix] REX.W opcode ModRM, reg and rm being register numbers
+ * (0-15, general-purpose or xmm according to the opcode)*/
+void emitRegister(struct machine_code *code, unsigned char prefix, int opcodeLength, const unsigned char *opcode,
+                  int reg, int rm){
+    if (prefix != 0){
+        emitByte(code, prefix);
+    }
+    emitByte(code, 0x48 | (reg >> 3) << 2 | rm >> 3);
+    emitBytes(code, opcode, opcodeLength);
+    emitByte(code, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// mov reg, imm64
+void emitMoveImmediate(struct machine_code *code, int reg, uint64_t value){
+    emitByte(code, 0x48 | reg >> 3);
+    emitByte(code, 0xB8 | (reg & 7));
+    emitInt64(code, value);
+}
+
+// jcc to the bail-out of the fragment, condition being the second byte of the rel32 form (0x80 jo ... 0x8F jg)
+void emitBail(struct machine_code *code, unsigned char condition){
+    emitByte(code, 0x0F);
+    emitByte(code, condition);
+    if (code->bailCount == code->bailCapacity){
+        code->bailCapacity = code->bailCapacity == 0 ? 64 : code->bailCapacity * 2;
+        code->bails = (int *)realloc(code->bails, code->bailCapacity * sizeof(int));
+        if (code->bails == NULL){
+            printError("Error: could not allocate memory for the machine code!\n");
+            sessionExit(1);
+        }
+    }
+    code->bails[code->bailCount++] = code->length;
+    emitInt32(code, 0);
+}
+
+// bails out unless the integer in reg fits in 48 bits: sign-extending its lower 48 bits must give it back
+void emitSmallIntegerGuard(struct machine_code *code, int reg){
+    emitRegister(code, 0, 1, (const unsigned char[]){0x89}, reg, RAX);         // mov rax, reg
+    emitBytes(code, (const unsigned char[]){0x48, 0xC1, 0xE0, 16}, 4);        // shl rax, 16
+    emitBytes(code, (const unsigned char[]){0x48, 0xC1, 0xF8, 16}, 4);        // sar rax, 16
+    emitRegister(code, 0, 1, (const unsigned char[]){0x39}, reg, RAX);         // cmp rax, reg
+    emitBail(code, 0x85);                                                       // jne
+}
+
+/* loads the value at [base + displacement] into the register of depth, checking it still has the type it was
+ * compiled for. For a variable, base points to its node, which must not be waiting for its formula*/
+void emitGuardedLoad(struct machine_code *code, int base, int32_t displacement, bool dirtyGuard, char type, int depth){
+    emitByte(code, 0x48);
+    emitBytes(code, (const unsigned char[]){0x8B, 0x80 | base}, 2);            // mov rax, [base + displacement]
+    emitInt32(code, displacement);
+    if (dirtyGuard){
+        emitBytes(code, (const unsigned char[]){0x80, 0xB8}, 2);               // cmp byte [rax + dirty], 0
+        emitInt32(code, offsetof(symbol_table, dirty));
+        emitByte(code, 0);
+        emitBail(code, 0x85);                                                   // jne
+        emitBytes(code, (const unsigned char[]){0x48, 0x8B, 0x80}, 3);         // mov rax, [rax + value]
+        emitInt32(code, offsetof(symbol_table, value));
+    }
+    emitRegister(code, 0, 1, (const unsigned char[]){0x89}, RAX, RDX);         // mov rdx, rax
+    emitBytes(code, (const unsigned char[]){0x48, 0xC1, 0xEA, 48}, 4);        // shr rdx, 48
+    emitBytes(code, (const unsigned char[]){0x81, 0xFA}, 2);                   // cmp edx, tag
+    if (type == INTEGER_TYPE){
+        emitInt32(code, TAG_INTEGER);
+        emitBail(code, 0x85);                                                   // jne
+        int reg = JIT_INTEGER_REGISTERS[depth];
+        emitRegister(code, 0, 1, (const unsigned char[]){0x89}, RAX, reg);     // mov reg, rax
+        emitRegister(code, 0, 1, (const unsigned char[]){0xC1}, 4, reg);       // shl reg, 16
+        emitByte(code, 16);
+        emitRegister(code, 0, 1, (const unsigned char[]){0xC1}, 7, reg);       // sar reg, 16
+        emitByte(code, 16);
+    } else {
+        emitInt32(code, TAG_UNDEFINED);
+        emitBail(code, 0x83);                                                   // jae: a tag, not a double
+        emitRegister(code, 0x66, 2, (const unsigned char[]){0x0F, 0x6E}, depth, RAX);  // movq xmm, rax
+    }
+}
+
+// converts the integer at depth to a double, for an operation with a double
+void emitToDouble(struct machine_code *code, int depth, char *types){
+    if (types[depth] == INTEGER_TYPE){
+        emitRegister(code, 0xF2, 2, (const unsigned char[]){0x0F, 0x2A}, depth, JIT_INTEGER_REGISTERS[depth]);  // cvtsi2sd
+        types[depth] = DOUBLE_TYPE;
+    }
+}
+
+/* type of the value an instruction pushes, if the machine code can work on it: an integer of up to 48 bits
+ * or a double, from the constant, the variable or the argument it reads as the code runs now. 0 otherwise*/
+char operandType(const struct chunk *chunk, const struct instruction *instruction, symbol_table **slots,
+                 const struct variable *arguments){
+    struct variable value;
+    if (instruction->opcode == OP_CONST){
+        value = chunk->constants[instruction->operand];
+    } else if (instruction->opcode == OP_LOAD){
+        if (slots[instruction->operand]->dirty){
+            return 0;
+        }
+        value = nodeValue(slots[instruction->operand]);
+    } else if (arguments != NULL){
+        value = arguments[instruction->operand];
+    } else {
+        return 0;   // the parameters of a function are only known when it is called
+    }
+    if (valueTag(value) == TAG_INTEGER){
+        return INTEGER_TYPE;
+    }
+    return valueType(value) == DOUBLE_TYPE ? DOUBLE_TYPE : 0;
+}
+
+/* length of the longest expression starting at start (before end) that the machine code can compute:
+ * numeric instructions only, pushing a single value without taking any that was pushed before, at most
+ * JIT_MAX_DEPTH deep and with one operation at least. 0 if there is none. types receives the type of every
+ * value the instructions of the expression push*/
+int scanFragment(const struct chunk *chunk, int start, int end, symbol_table **slots, const struct variable *arguments,
+                 char *types){
+    char stack[JIT_MAX_DEPTH];
+    int depth = 0;
+    int operations = 0;
+    int length = 0;
+    for (int i = start; i < end; i++){
+        const struct instruction *instruction = &chunk->code[i];
+        switch (instruction->opcode){
+            case OP_CONST:
+            case OP_LOAD:
+            case OP_PARAM: {
+                char type = operandType(chunk, instruction, slots, arguments);
+                if (type == 0 || depth == JIT_MAX_DEPTH){
+                    return length;
+                }
+                stack[depth++] = type;
+                break;
+            }
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+                if (depth < 2){
+                    return length;
+                }
+                depth--;
+                stack[depth - 1] = stack[depth - 1] == INTEGER_TYPE && stack[depth] == INTEGER_TYPE ? INTEGER_TYPE : DOUBLE_TYPE;
+                operations++;
+                break;
+            case OP_INC:
+            case OP_DEC:
+                if (depth < 1){
+                    return length;
+                }
+                operations++;
+                break;
+            case OP_LT:
+            case OP_GT:
+            case OP_LEQ:
+            case OP_GEQ:
+            case OP_EQ:
+            case OP_NEQ:
+                if (depth < 2){
+                    return length;
+                }
+                depth--;
+                stack[depth - 1] = INTEGER_TYPE;
+                operations++;
+                break;
+            default:
+                return length;
+        }
+        types[i - start] = stack[depth - 1];
+        if (depth == 1 && operations > 0){
+            length = i + 1 - start;
+        }
+    }
+    return length;
+}
+
+/* emits the machine code of the expression from start to end, whose instructions push values of the given types.
+ * The code is called as entry(slots, arguments) and returns the bits of the value, or JIT_BAIL*/
+void compileFragment(struct machine_code *code, const struct chunk *chunk, int start, int end, const char *types){
+    char stack[JIT_MAX_DEPTH];          // type of the values in registers, by depth
+    int depth = 0;
+    int counted[ARITHMETIC_OPERATORS * STATS_TYPES * STATS_TYPES] = {0};   // operations to count once the guards pass
+    code->bailCount = 0;
+    for (int i = start; i < end; i++){
+        const struct instruction *instruction = &chunk->code[i];
+        int opcode = instruction->opcode;
+        if (opcode == OP_CONST){
+            struct variable value = chunk->constants[instruction->operand];
+            if (types[i - start] == INTEGER_TYPE){
+                emitMoveImmediate(code, JIT_INTEGER_REGISTERS[depth], asInteger(value));
+            } else {
+                emitMoveImmediate(code, RAX, value.bits);
+                emitRegister(code, 0x66, 2, (const unsigned char[]){0x0F, 0x6E}, depth, RAX);  // movq xmm, rax
+            }
+            stack[depth++] = types[i - start];
+        } else if (opcode == OP_LOAD){
+            emitGuardedLoad(code, RDI, instruction->operand * (int32_t)sizeof(symbol_table *), true, types[i - start], depth);
+            stack[depth++] = types[i - start];
+        } else if (opcode == OP_PARAM){
+            emitGuardedLoad(code, RSI, instruction->operand * (int32_t)sizeof(struct variable), false, types[i - start], depth);
+            stack[depth++] = types[i - start];
+        } else if (opcode == OP_INC || opcode == OP_DEC){
+            if (stack[depth - 1] == INTEGER_TYPE){
+                int reg = JIT_INTEGER_REGISTERS[depth - 1];
+                emitRegister(code, 0, 1, (const unsigned char[]){0x83}, opcode == OP_INC ? 0 : 5, reg);  // add/sub reg, 1
+                emitByte(code, 1);
+                emitSmallIntegerGuard(code, reg);
+            } else {
+                emitMoveImmediate(code, RAX, doubleValue(1).bits);
+                emitRegister(code, 0x66, 2, (const unsigned char[]){0x0F, 0x6E}, XMM_SCRATCH, RAX);    // movq xmm7, rax
+                emitBytes(code, (const unsigned char[]){0xF2, 0x0F, opcode == OP_INC ? 0x58 : 0x5C,
+                                                         0xC0 | (depth - 1) << 3 | XMM_SCRATCH}, 4);   // addsd/subsd
+            }
+        } else if (opcode >= OP_ADD && opcode <= OP_DIV){
+            int left = depth - 2;
+            int right = depth - 1;
+            int op = opcode - OP_ADD;
+            counted[(op * STATS_TYPES + stack[left]) * STATS_TYPES + stack[right]]++;
+            if (stack[left] == INTEGER_TYPE && stack[right] == INTEGER_TYPE){
+                int a = JIT_INTEGER_REGISTERS[left];
+                int b = JIT_INTEGER_REGISTERS[right];
+                if (op == ADD_OP){
+                    emitRegister(code, 0, 1, (const unsigned char[]){0x01}, b, a);                 // add a, b
+                } else if (op == SUB_OP){
+                    emitRegister(code, 0, 1, (const unsigned char[]){0x29}, b, a);                 // sub a, b
+                } else if (op == MUL_OP){
+                    emitRegister(code, 0, 2, (const unsigned char[]){0x0F, 0xAF}, a, b);           // imul a, b
+                    emitBail(code, 0x80);                                                           // jo
+                } else {
+                    emitRegister(code, 0, 1, (const unsigned char[]){0x85}, b, b);                 // test b, b
+                    emitBail(code, 0x84);                                                           // je: division by 0
+                    emitRegister(code, 0, 1, (const unsigned char[]){0x89}, a, RAX);               // mov rax, a
+                    emitBytes(code, (const unsigned char[]){0x48, 0x99}, 2);                       // cqo
+                    emitRegister(code, 0, 1, (const unsigned char[]){0xF7}, 7, b);                 // idiv b
+                    emitRegister(code, 0, 1, (const unsigned char[]){0x89}, RAX, a);               // mov a, rax
+                }
+                emitSmallIntegerGuard(code, a);
+            } else {
+                emitToDouble(code, left, stack);
+                emitToDouble(code, right, stack);
+                if (op == DIV_OP){
+                    emitBytes(code, (const unsigned char[]){0x66, 0x0F, 0x57, 0xFF}, 4);           // xorpd xmm7, xmm7
+                    emitBytes(code, (const unsigned char[]){0x66, 0x0F, 0x2E, 0xC7 | right << 3}, 4);  // ucomisd right, xmm7
+                    emitBail(code, 0x84);                                                           // je: division by 0
+                }
+                const unsigned char operations[ARITHMETIC_OPERATORS] = {0x58, 0x5C, 0x59, 0x5E};   // addsd subsd mulsd divsd
+                emitBytes(code, (const unsigned char[]){0xF2, 0x0F, operations[op], 0xC0 | left << 3 | right}, 4);
+            }
+            depth--;
+        } else {
+            //comparisons: the truth value is an integer, 0 or 1
+            int left = depth - 2;
+            int right = depth - 1;
+            int op = opcode - OP_LT;
+            if (stack[left] == INTEGER_TYPE && stack[right] == INTEGER_TYPE){
+                const unsigned char conditions[6] = {0x9C, 0x9F, 0x9E, 0x9D, 0x94, 0x95};  // setl setg setle setge sete setne
+                emitRegister(code, 0, 1, (const unsigned char[]){0x39}, JIT_INTEGER_REGISTERS[right],
+                             JIT_INTEGER_REGISTERS[left]);                                  // cmp left, right
+                emitBytes(code, (const unsigned char[]){0x0F, conditions[op], 0xC0}, 3);     // setcc al
+            } else {
+                //ucomisd leaves CF and ZF set for a NaN, which only != holds for (see compareValues())
+                emitToDouble(code, left, stack);
+                emitToDouble(code, right, stack);
+                bool swapped = opcode == OP_LT || opcode == OP_LEQ;     // a < b as b > a, which is false when unordered
+                int first = swapped ? right : left;
+                int second = swapped ? left : right;
+                emitBytes(code, (const unsigned char[]){0x66, 0x0F, 0x2E, 0xC0 | first << 3 | second}, 4);  // ucomisd
+                if (opcode == OP_EQ){
+                    emitBytes(code, (const unsigned char[]){0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC2, 0x20, 0xD0}, 8);  // sete al, setnp dl, and al, dl
+                } else if (opcode == OP_NEQ){
+                    emitBytes(code, (const unsigned char[]){0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC2, 0x08, 0xD0}, 8);  // setne al, setp dl, or al, dl
+                } else {
+                    bool strict = opcode == OP_LT || opcode == OP_GT;
+                    emitBytes(code, (const unsigned char[]){0x0F, strict ? 0x97 : 0x93, 0xC0}, 3);   // seta/setae al
+                }
+            }
+            emitBytes(code, (const unsigned char[]){0x0F, 0xB6, 0xC0}, 3);                 // movzx eax, al
+            emitRegister(code, 0, 1, (const unsigned char[]){0x89}, RAX, JIT_INTEGER_REGISTERS[left]);  // mov left, rax
+            stack[left] = INTEGER_TYPE;
+            depth--;
+        }
+    }
+
+    //every guard has passed: the operations are counted and the result is boxed
+    for (int i = 0; i < ARITHMETIC_OPERATORS * STATS_TYPES * STATS_TYPES; i++){
+        if (counted[i] > 0){
+            emitMoveImmediate(code, RAX, (uint64_t)(uintptr_t)(&session->stats.operations[0][0][0] + i));
+            emitBytes(code, (const unsigned char[]){0x48, 0x81, 0x00}, 3);                 // add qword [rax], count
+            emitInt32(code, counted[i]);
+        }
+    }
+    if (stack[0] == INTEGER_TYPE){
+        emitRegister(code, 0, 1, (const unsigned char[]){0x89}, JIT_INTEGER_REGISTERS[0], RAX);   // mov rax, rcx
+        emitBytes(code, (const unsigned char[]){0x48, 0xC1, 0xE0, 16, 0x48, 0xC1, 0xE8, 16}, 8);  // shl rax, 16; shr rax, 16
+        emitMoveImmediate(code, RDX, TAG_INTEGER << 48);
+        emitBytes(code, (const unsigned char[]){0x48, 0x09, 0xD0, 0xC3}, 4);           // or rax, rdx; ret
+    } else {
+        //NaNs are all stored as CANONICAL_NAN (see doubleValue())
+        emitBytes(code, (const unsigned char[]){0x66, 0x48, 0x0F, 0x7E, 0xC0}, 5);     // movq rax, xmm0
+        emitBytes(code, (const unsigned char[]){0x66, 0x0F, 0x2E, 0xC0, 0x7B, 10}, 6); // ucomisd xmm0, xmm0; jnp ret
+        emitMoveImmediate(code, RAX, CANONICAL_NAN);
+        emitByte(code, 0xC3);                                                           // ret
+    }
+
+    //the guards jump here
+    for (int i = 0; i < code->bailCount; i++){
+        int32_t displacement = code->length - (code->bails[i] + 4);
+        memcpy(&code->bytes[code->bails[i]], &displacement, 4);
+    }
+    emitMoveImmediate(code, RAX, JIT_BAIL);
+    emitByte(code, 0xC3);
+}
+
+/* compiles the expressions found between start and end, as the code runs now: slots are the nodes it refers to and
+ * arguments those of the function the chunk belongs to (NULL for the other chunks). The machine code of all of them
+ * is written to one mapping, which is made executable once written*/
+void jitChunk(struct chunk *chunk, int start, int end, symbol_table **slots, const struct variable *arguments){
+    struct machine_code code = {0};
+    struct native_draft *drafts = NULL;
+    int draftCount = 0;
+    char *types = (char *)malloc(chunk->length + 1);
+    if (types == NULL){
+        printError("Error: could not allocate memory for the machine code!\n");
+        sessionExit(1);
+    }
+    for (int i = start; i < end; ){
+        int length = scanFragment(chunk, i, end, slots, arguments, types);
+        if (length == 0){
+            i++;
+            continue;
+        }
+        drafts = (struct native_draft *)realloc(drafts, (draftCount + 1) * sizeof(struct native_draft));
+        if (drafts == NULL){
+            printError("Error: could not allocate memory for the machine code!\n");
+            sessionExit(1);
+        }
+        drafts[draftCount++] = (struct native_draft){i, i + length, code.length};
+        compileFragment(&code, chunk, i, i + length, types);
+        i += length;
+    }
+    free(types);
+    free(code.bails);
+    if (draftCount == 0){
+        free(code.bytes);
+        return;
+    }
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (code.length + page - 1) / page * page;
+    void *address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED || (memcpy(address, code.bytes, code.length),
+                                  mprotect(address, size, PROT_READ | PROT_EXEC) != 0)){
+        printWarning("Warning: could not map executable memory for the machine code, the bytecode runs instead!\n");
+        if (address != MAP_FAILED){
+            munmap(address, size);
+        }
+        free(code.bytes);
+        free(drafts);
+        return;
+    }
+    free(code.bytes);
+    struct native_pages *pages = (struct native_pages *)malloc(sizeof(struct native_pages));
+    if (pages == NULL){
+        printError("Error: could not allocate memory for the machine code!\n");
+        sessionExit(1);
+    }
+    *pages = (struct native_pages){address, size, chunk->pages};
+    chunk->pages = pages;
+
+    if (chunk->fragmentCount + draftCount > chunk->fragmentCapacity){
+        chunk->fragmentCapacity = chunk->fragmentCount + draftCount + chunk->fragmentCapacity;
+        chunk->fragments = (struct native_fragment *)realloc(chunk->fragments,
+                                                             chunk->fragmentCapacity * sizeof(struct native_fragment));
+        countAllocation(chunk->fragmentCapacity * sizeof(struct native_fragment));
+        if (chunk->fragments == NULL){
+            printError("Error: could not allocate memory for the machine code!\n");
+            sessionExit(1);
+        }
+    }
+    for (int i = 0; i < draftCount; i++){
+        struct native_fragment *fragment = &chunk->fragments[chunk->fragmentCount];
+        fragment->entry = (uint64_t (*)(symbol_table **, const struct variable *))((unsigned char *)address + drafts[i].offset);
+        fragment->original = chunk->code[drafts[i].start];
+        fragment->end = drafts[i].end;
+        fragment->failures = 0;
+        chunk->code[drafts[i].start] = (struct instruction){OP_NATIVE, 0, 0, 0, chunk->fragmentCount++};
+    }
+    session->stats.jitFragments += draftCount;
+    free(drafts);
+}
+
+// frees the machine code of a chunk, along with the fragments it holds
+void releaseNative(struct chunk *chunk){
+    for (struct native_pages *pages = chunk->pages, *next; pages != NULL; pages = next){
+        next = pages->next;
+        munmap(pages->address, pages->size);
+        free(pages);
+    }
+    free(chunk->fragments);
+    chunk->pages = NULL;
+    chunk->fragments = NULL;
+    chunk->fragmentCount = chunk->fragmentCapacity = 0;
+}
+
+#else
+
+void jitChunk(struct chunk *chunk, int start, int end, symbol_table **slots, const struct variable *arguments){
+    // machine code is only generated on x86-64, where --jit is available
+}
+
+void releaseNative(struct chunk *chunk){
+}
+
+#endif
+
+#endif
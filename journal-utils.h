@@ -0,0 +1,552 @@
+#ifndef JOURNAL_UTILS_H
+#define JOURNAL_UTILS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "session-utils.h"
+#include "output-utils.h"
+#include "variable-utils.h"
+#include "integer-utils.h"
+#include "intern-utils.h"
+#include "symboltable-utils.h"
+#include "shared-utils.h"
+#include "snapshot-utils.h"
+
+/* JOURNAL: with --journal PATH every change to a variable is appended to a log (PATH.log) as it is made, so that
+ * after a crash the calculator starts again from the state it had reached instead of from the beginning of its input.
+ * - a record holds the whole state of one node after the change (flags, value, and the characters of a string or the
+ *   limbs of a big integer) rather than the statement that changed it, so replaying a record twice is harmless
+ * - assignments append their records to a buffer in memory, which a thread of the journal writes and flushes to the
+ *   disk every commitInterval milliseconds (group commit): an assignment never waits for the disk, and a crash loses
+ *   at most the changes of the last interval
+ * - once the log has grown several times larger than the snapshot at PATH, the table is copied into a snapshot image
+ *   (see buildSnapshot() in snapshot-utils.h) and the log starts again: the thread renames the log to PATH.old, and
+ *   another one writes the image to PATH and removes PATH.old (compaction). The log so stays proportional to the
+ *   variables alive, whatever the length of the history, and so does recovery
+ * - recovery loads the snapshot, then replays PATH.old (left by a compaction a crash interrupted) and PATH.log up to
+ *   the first incomplete or corrupted record, where the crash stopped the writes, and compacts what it replayed
+ * Formulas (:=) and functions are not journaled: a bound variable comes back with the last value assigned to it.*/
+#define JOURNAL_COMPACT_MIN (1 << 20)       // bytes of log below which there is no compaction, however small the snapshot
+#define JOURNAL_COMPACT_RATIO 4             // bytes of log allowed per byte of snapshot before compacting
+#define JOURNAL_FLUSH_SIZE (1 << 20)        // bytes buffered that wake the thread before the end of the interval
+#define JOURNAL_BUFFER_LIMIT (64 << 20)     // bytes buffered beyond which an assignment waits for the thread
+
+const char JOURNAL_MAGIC[8] = {'C', 'A', 'L', 'C', 'J', 'R', 'N', 'L'};
+const uint32_t JOURNAL_VERSION = 1;
+
+struct journal_header{
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;        // see snapshotLayout(), the blocks of big integers are laid out as in a snapshot
+};
+
+struct journal_record{
+    uint32_t size;          // bytes of the record, identifier and block included, padded to 8
+    uint32_t checksum;      // of the bytes after this field, see recordChecksum()
+    uint64_t value;         // bits of the value, with the size of the block as payload for strings and big integers
+    uint32_t idLength;      // the identifier follows the record, null-terminated, then the block
+    uint8_t type_declared;
+    uint8_t initialised;
+    uint16_t unused;
+};
+
+struct journal{
+    char *path;                 // of the snapshot
+    char *logPath;              // path.log
+    char *oldPath;              // path.old, the log before the compaction running
+    int fd;                     // of the log, only used by the thread
+    pthread_t thread;
+    pthread_t compactor;        // thread writing the last snapshot image
+    bool compactorStarted;
+    pthread_mutex_t lock;       // protects the fields below
+    pthread_cond_t wakeup;      // signalled to the thread when it has to write before the end of the interval
+    pthread_cond_t written;     // signalled by the thread once it has written the buffer
+    struct text_buffer pending; // records not written yet
+    struct text_buffer spare;   // buffer written by the thread, swapped with pending
+    size_t logSize;             // bytes of the log, pending records included
+    size_t snapshotSize;
+    unsigned char *image;       // snapshot image being compacted to, NULL otherwise
+    size_t imageSize;
+    size_t rotateAt;            // bytes of the pending records that belong to the log before the image
+    bool rotating;              // the log starts again at rotateAt, on the next write
+    bool compacting;            // from the copy of the image until it has been written
+    bool stopping;
+    bool failed;                // the log could not be written, which is only reported once
+};
+
+/*milliseconds between two flushes of the journal to the disk (--commit-interval)*/
+int commitInterval = 10;
+
+/*Journal function prototypes*/
+bool openJournal(const char *path);
+void closeJournal(struct table *table);
+void freeJournal(struct journal *journal);
+void journalNode(symbol_table *node);
+void requestCompaction(struct journal *journal);
+void *commitJournal(void *argument);
+void *compactJournal(void *argument);
+bool writeLog(struct journal *journal, const char *data, size_t size);
+bool rotateLog(struct journal *journal);
+int openLog(const char *path);
+bool replayLog(const char *path, size_t *replayed);
+size_t checkJournalRecord(const unsigned char *data, size_t left);
+void replayRecord(const struct journal_record *record);
+uint32_t recordChecksum(const unsigned char *data, size_t size);
+char *journalPath(const char *path, const char *suffix);
+void reportJournalError(struct journal *journal, const char *what);
+
+/* recovers the table of the current session from the journal at path (see above), then journals its changes from then on.
+ * Returns false, leaving every file as it was, if the journal could not be recovered*/
+bool openJournal(const char *path){
+    struct journal *journal = (struct journal *)calloc(1, sizeof(struct journal));
+    if (journal == NULL || (journal->path = strdup(path)) == NULL || (journal->logPath = journalPath(path, ".log")) == NULL
+        || (journal->oldPath = journalPath(path, ".old")) == NULL){
+        printError("Error: could not allocate memory for the journal!\n");
+        sessionExit(1);
+    }
+    journal->fd = -1;
+
+    struct stat status;
+    if (stat(path, &status) == 0){
+        if (!loadSnapshot(path)){
+            freeJournal(journal);
+            return false;
+        }
+        journal->snapshotSize = (size_t)status.st_size;
+    }
+    size_t replayed = 0;
+    bool old = access(journal->oldPath, F_OK) == 0;
+    if (!replayLog(journal->oldPath, &replayed) || !replayLog(journal->logPath, &replayed)){
+        freeJournal(journal);
+        return false;
+    }
+
+    //what was replayed goes into the snapshot, so that the log starts empty
+    if (replayed > 0){
+        size_t size;
+        lockTable();
+        unsigned char *image = buildSnapshot(&size);
+        unlockTable();
+        if (image == NULL || !replaceFile(path, image, size)){
+            outPrintf("Error: could not write the snapshot %s: %s\n", path, image == NULL ? strerror(ENOMEM) : strerror(errno));
+            free(image);
+            freeJournal(journal);
+            return false;
+        }
+        free(image);
+        journal->snapshotSize = size;
+        printInfo("Info: Recovered %zu change(s) from the journal of %s\n", replayed, path);
+    }
+    if ((old && unlink(journal->oldPath) != 0) || (journal->fd = openLog(journal->logPath)) < 0){
+        outPrintf("Error: could not open the journal %s: %s\n", journal->logPath, strerror(errno));
+        freeJournal(journal);
+        return false;
+    }
+
+    pthread_mutex_init(&journal->lock, NULL);
+    pthread_cond_init(&journal->wakeup, NULL);
+    pthread_cond_init(&journal->written, NULL);
+    if (pthread_create(&journal->thread, NULL, commitJournal, journal) != 0){
+        outPrintf("Error: could not start the thread of the journal!\n");
+        close(journal->fd);
+        freeJournal(journal);
+        return false;
+    }
+    session->table->journal = journal;
+    return true;
+}
+
+/* writes what is left in the journal of the table to the disk and stops journaling, once nothing changes the table any longer*/
+void closeJournal(struct table *table){
+    struct journal *journal = table->journal;
+    if (journal == NULL){
+        return;
+    }
+    pthread_mutex_lock(&journal->lock);
+    journal->stopping = true;
+    pthread_cond_signal(&journal->wakeup);
+    pthread_mutex_unlock(&journal->lock);
+    pthread_join(journal->thread, NULL);
+    if (journal->compactorStarted){
+        pthread_join(journal->compactor, NULL);
+    }
+    table->journal = NULL;
+
+    close(journal->fd);
+    pthread_mutex_destroy(&journal->lock);
+    pthread_cond_destroy(&journal->wakeup);
+    pthread_cond_destroy(&journal->written);
+    freeJournal(journal);
+}
+
+// releases the buffers and the paths of the journal, and the journal itself
+void freeJournal(struct journal *journal){
+    free(journal->pending.chars);
+    free(journal->spare.chars);
+    free(journal->path);
+    free(journal->logPath);
+    free(journal->oldPath);
+    free(journal);
+}
+
+/* appends the state of the node to the journal of the table, if it has one. Called after every change to a node,
+ * by the writer holding the write lock of a shared table, so the records are in the order of the changes*/
+void journalNode(symbol_table *node){
+    struct journal *journal = session->table->journal;
+    if (journal == NULL){
+        return;
+    }
+    struct variable value = node->value;
+    const void *block = NULL;
+    size_t blockSize = 0;
+    if (valueTag(value) == TAG_STRING || valueTag(value) == TAG_SHARED_STRING){
+        block = stringChars(&value);
+        blockSize = stringLength(&value);
+        value = boxValue(valueTag(value), blockSize);
+    } else if (isBigInteger(value)){
+        block = bigHeader(value);
+        blockSize = sizeof(struct big_integer) + bigHeader(value)->length * sizeof(uint32_t);
+        value = boxValue(TAG_BIG_INTEGER, (uint64_t)bigHeader(value)->length);
+    }
+    size_t idLength = internedLength(node->id);
+    size_t blockStart = sizeof(struct journal_record) + snapshotPadding(idLength + 1);
+    size_t size = snapshotPadding(blockStart + blockSize);
+
+    pthread_mutex_lock(&journal->lock);
+    while (journal->pending.length >= JOURNAL_BUFFER_LIMIT && !journal->failed){
+        pthread_cond_signal(&journal->wakeup);
+        pthread_cond_wait(&journal->written, &journal->lock);
+    }
+    struct text_buffer *pending = &journal->pending;
+    if (pending->length + size > pending->capacity){
+        size_t capacity = pending->capacity == 0 ? CAPTURE_BUFFER_SIZE : pending->capacity;
+        while (capacity < pending->length + size){
+            capacity *= 2;
+        }
+        pending->chars = (char *)realloc(pending->chars, capacity);
+        countAllocation(capacity);
+        if (pending->chars == NULL){
+            fprintf(stderr, "Error: could not allocate memory for the journal!\n");
+            exit(1);
+        }
+        pending->capacity = capacity;
+    }
+    unsigned char *data = (unsigned char *)pending->chars + pending->length;
+    memset(data, 0, size);      // the padding is part of the checksum
+    struct journal_record *record = (struct journal_record *)data;
+    record->size = (uint32_t)size;
+    record->value = value.bits;
+    record->idLength = (uint32_t)idLength;
+    record->type_declared = node->type_declared;
+    record->initialised = node->initialised;
+    memcpy(data + sizeof(struct journal_record), node->id, idLength);
+    if (blockSize > 0){
+        memcpy(data + blockStart, block, blockSize);
+    }
+    if (isBigInteger(node->value)){
+        ((struct big_integer *)(data + blockStart))->owned = false;
+    }
+    record->checksum = recordChecksum(data, size);
+    pending->length += size;
+    journal->logSize += size;
+    if (pending->length >= JOURNAL_FLUSH_SIZE){
+        pthread_cond_signal(&journal->wakeup);
+    }
+    bool compact = !journal->compacting && !journal->failed
+                   && journal->logSize > JOURNAL_COMPACT_MIN + JOURNAL_COMPACT_RATIO * journal->snapshotSize;
+    journal->compacting = journal->compacting || compact;
+    pthread_mutex_unlock(&journal->lock);
+    if (compact){
+        requestCompaction(journal);
+    }
+}
+
+/* copies the table into a snapshot image for the thread to compact the log to. The caller holds the write lock
+ * of a shared table, so the image holds exactly the changes of the records appended so far*/
+void requestCompaction(struct journal *journal){
+    size_t size;
+    unsigned char *image = buildSnapshot(&size);
+    pthread_mutex_lock(&journal->lock);
+    if (image == NULL){
+        journal->compacting = false;    // tried again with the next record
+    } else {
+        journal->image = image;
+        journal->imageSize = size;
+        journal->rotateAt = journal->pending.length;
+        journal->rotating = true;
+        journal->logSize = 0;
+        pthread_cond_signal(&journal->wakeup);
+    }
+    pthread_mutex_unlock(&journal->lock);
+}
+
+/* thread of the journal: writes the pending records and flushes them every commitInterval milliseconds (or sooner when
+ * many are pending), starting a new log where a compaction asks for it, until the journal is closed*/
+void *commitJournal(void *argument){
+    struct journal *journal = (struct journal *)argument;
+    pthread_mutex_lock(&journal->lock);
+    while (!journal->stopping || journal->pending.length > 0 || journal->rotating){
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)(commitInterval % 1000) * 1000000;
+        deadline.tv_sec += commitInterval / 1000 + deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+        while (!journal->stopping && !journal->rotating && journal->pending.length < JOURNAL_FLUSH_SIZE
+               && pthread_cond_timedwait(&journal->wakeup, &journal->lock, &deadline) != ETIMEDOUT){
+            // woken up before the deadline without anything to do
+        }
+        if (journal->pending.length == 0 && !journal->rotating){
+            continue;
+        }
+
+        struct text_buffer writing = journal->pending;
+        journal->pending = journal->spare;
+        bool rotating = journal->rotating;
+        size_t rotateAt = rotating ? journal->rotateAt : writing.length;
+        journal->rotating = false;
+        pthread_mutex_unlock(&journal->lock);
+
+        bool written = writeLog(journal, writing.chars, rotateAt);
+        if (rotating){
+            written = rotateLog(journal) && written;
+            written = writeLog(journal, writing.chars + rotateAt, writing.length - rotateAt) && written;
+        }
+        written = fdatasync(journal->fd) == 0 && written;
+
+        pthread_mutex_lock(&journal->lock);
+        if (!written){
+            reportJournalError(journal, journal->logPath);
+        }
+        if (rotating && journal->failed){
+            free(journal->image);   // the old log may be incomplete, so it is not compacted
+            journal->image = NULL;
+        } else if (rotating){
+            if (journal->compactorStarted){
+                pthread_join(journal->compactor, NULL);     // done with the previous image already
+            }
+            journal->compactorStarted = pthread_create(&journal->compactor, NULL, compactJournal, journal) == 0;
+            if (!journal->compactorStarted){
+                pthread_mutex_unlock(&journal->lock);
+                compactJournal(journal);
+                pthread_mutex_lock(&journal->lock);
+            }
+        }
+        writing.length = 0;
+        journal->spare = writing;
+        pthread_cond_broadcast(&journal->written);
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return NULL;
+}
+
+/* writes the image of a compaction over the snapshot, after which the log before it is no longer needed.
+ * If the snapshot cannot be written the old log is kept, and so there is no further compaction*/
+void *compactJournal(void *argument){
+    struct journal *journal = (struct journal *)argument;
+    bool compacted = replaceFile(journal->path, journal->image, journal->imageSize)
+                     && unlink(journal->oldPath) == 0 && syncDirectory(journal->oldPath);
+    int error = errno;
+    free(journal->image);
+    pthread_mutex_lock(&journal->lock);
+    journal->image = NULL;
+    if (compacted){
+        journal->snapshotSize = journal->imageSize;
+        journal->compacting = false;
+    } else {
+        errno = error;
+        reportJournalError(journal, journal->path);
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return NULL;
+}
+
+// writes the whole data to the log, returning false if it could not
+bool writeLog(struct journal *journal, const char *data, size_t size){
+    for (size_t done = 0; done < size; ){
+        ssize_t count = write(journal->fd, data + done, size - done);
+        if (count < 0 && errno != EINTR){
+            return false;
+        }
+        done += count > 0 ? (size_t)count : 0;
+    }
+    return true;
+}
+
+/* renames the log to the old log and starts a new one, the records written so far being on the disk already*/
+bool rotateLog(struct journal *journal){
+    close(journal->fd);
+    journal->fd = -1;
+    if (rename(journal->logPath, journal->oldPath) != 0){
+        return false;
+    }
+    journal->fd = openLog(journal->logPath);
+    return journal->fd >= 0 && syncDirectory(journal->logPath);
+}
+
+/* creates an empty log at path (replacing the file there) and returns its descriptor, or -1 if it could not*/
+int openLog(const char *path){
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    struct journal_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.version = JOURNAL_VERSION;
+    header.layout = snapshotLayout();
+    if (fd >= 0 && (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) || fdatasync(fd) != 0)){
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+/* applies the records of the log at path to the table, up to the first one that is incomplete or corrupted,
+ * adding their number to replayed. Returns false if the log cannot be read, true if there is none*/
+bool replayLog(const char *path, size_t *replayed){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0){
+        if (errno == ENOENT){
+            return true;
+        }
+        outPrintf("Error: could not open the journal %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    struct stat status;
+    unsigned char *data = NULL;
+    size_t size = 0;
+    bool loaded = fstat(fd, &status) == 0;
+    if (loaded && status.st_size > 0){
+        size = (size_t)status.st_size;
+        data = (unsigned char *)malloc(size);
+        loaded = data != NULL;
+        for (size_t done = 0; loaded && done < size; ){
+            ssize_t count = pread(fd, data + done, size - done, (off_t)done);
+            loaded = count > 0 || (count < 0 && errno == EINTR);
+            done += count > 0 ? (size_t)count : 0;
+        }
+    }
+    close(fd);
+    if (!loaded){
+        outPrintf("Error: could not read the journal %s: %s\n", path, strerror(errno));
+        free(data);
+        return false;
+    }
+    const struct journal_header *header = (const struct journal_header *)data;
+    if (size < sizeof(struct journal_header)){
+        free(data);
+        return true;        // a crash stopped the creation of the log
+    }
+    if (memcmp(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0){
+        outPrintf("Error: %s is not a journal!\n", path);
+        free(data);
+        return false;
+    }
+    if (header->version != JOURNAL_VERSION || header->layout != snapshotLayout()){
+        outPrintf("Error: the journal %s was written by another version of the calculator!\n", path);
+        free(data);
+        return false;
+    }
+
+    size_t offset = sizeof(struct journal_header);
+    size_t recordSize;
+    lockTable();
+    while ((recordSize = checkJournalRecord(data + offset, size - offset)) > 0){
+        replayRecord((const struct journal_record *)(data + offset));
+        offset += recordSize;
+        (*replayed)++;
+    }
+    unlockTable();
+    if (offset < size){
+        printWarning("Warning: the journal %s ends with an incomplete record, its last %zu byte(s) are ignored\n", path, size - offset);
+    }
+    free(data);
+    return true;
+}
+
+/* returns the size of the record at data if it is complete and consistent, 0 otherwise*/
+size_t checkJournalRecord(const unsigned char *data, size_t left){
+    const struct journal_record *record = (const struct journal_record *)data;
+    if (left < sizeof(struct journal_record) || record->size < sizeof(struct journal_record) || record->size > left
+        || record->size % 8 != 0 || record->checksum != recordChecksum(data, record->size)){
+        return 0;
+    }
+    size_t size = record->size;
+    if (record->idLength == 0 || record->idLength >= size - sizeof(struct journal_record)
+        || data[sizeof(struct journal_record) + record->idLength] != '\0' || record->type_declared > 1 || record->initialised > 1){
+        return 0;
+    }
+    size_t blockStart = sizeof(struct journal_record) + snapshotPadding(record->idLength + 1);
+    struct variable value = {record->value};
+    uint64_t tag = valueTag(value);
+    uint64_t payload = value.bits & PAYLOAD_MASK;
+    if (tag == TAG_SHORT_STRING || tag == TAG_SHARED_SHORT_STRING){
+        return memchr(&value.bits, '\0', SHORT_STRING_CAPACITY) != NULL ? size : 0;
+    } else if (tag == TAG_STRING || tag == TAG_SHARED_STRING){
+        return blockStart <= size && payload <= size - blockStart ? size : 0;
+    } else if (tag == TAG_BIG_INTEGER){
+        const struct big_integer *block = (const struct big_integer *)(data + blockStart);
+        return blockStart + sizeof(struct big_integer) <= size && payload > 0
+               && payload <= (size - blockStart - sizeof(struct big_integer)) / sizeof(uint32_t)
+               && block->length == (int)payload ? size : 0;
+    }
+    return size;
+}
+
+/* sets the node of a checked record to the state it holds, with strings and big integers copied to the heap*/
+void replayRecord(const struct journal_record *record){
+    const char *id = (const char *)record + sizeof(struct journal_record);
+    const unsigned char *block = (const unsigned char *)id + snapshotPadding(record->idLength + 1);
+    struct variable value = {record->value};
+    uint64_t tag = valueTag(value);
+    if (tag == TAG_STRING || tag == TAG_SHARED_STRING){
+        value = makeOwnedString((const char *)block, value.bits & PAYLOAD_MASK);
+        value = tag == TAG_SHARED_STRING ? shareValue(value) : value;
+    } else if (tag == TAG_BIG_INTEGER){
+        value = copyBigInteger(boxValue(TAG_BIG_INTEGER, (uint64_t)(uintptr_t)block), true);
+    }
+    if (restoreNode(id, record->idLength, value, record->type_declared, record->initialised) == NULL){
+        if (valueType(value) == STRING_TYPE){
+            freeString(&value);
+        } else if (isBigInteger(value)){
+            freeBigInteger(&value);
+        }
+    }
+}
+
+// checksum of a record, the bytes after its size and checksum fields folded to 32 bits
+uint32_t recordChecksum(const unsigned char *data, size_t size){
+    uint64_t checksum = snapshotChecksum(data + 8, size - 8);
+    return (uint32_t)(checksum ^ checksum >> 32);
+}
+
+// path followed by suffix, allocated
+char *journalPath(const char *path, const char *suffix){
+    size_t length = strlen(path);
+    char *joined = (char *)malloc(length + strlen(suffix) + 1);
+    if (joined != NULL){
+        memcpy(joined, path, length);
+        strcpy(joined + length, suffix);
+    }
+    return joined;
+}
+
+/* reports that the file could not be written, once: the thread has no session to report to.
+ * The caller holds the lock of the journal*/
+void reportJournalError(struct journal *journal, const char *what){
+    if (!journal->failed){
+        fprintf(stderr, "Error: could not write the journal to %s: %s\n", what, strerror(errno));
+        journal->failed = true;
+    }
+}
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef NUMBER_UTILS_H
+#define NUMBER_UTILS_H
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output-utils.h"
+
+/* NUMBERS: conversion of numeric literals to values and of values to text, without going through
+ * atoi/atof and printf, which are slow and depend on the locale.
+ * - integer literals are checked for overflow
+ * - double literals are rounded exactly: when the digits fit in the 53 bits of a double and there are at most
+ *   22 decimals, dividing the digits by a power of ten (both exact) is correctly rounded; longer literals,
+ *   which are rare, are left to strtod (the calculator never changes the "C" locale, so the separator is '.')
+ * - doubles are printed with the fewest decimals that read back as the same double, and at least one decimal,
+ *   so that they cannot be mistaken for integers (9.0, 14.7, 0.30000000000000004)*/
+#define NUMBER_TEXT_SIZE 352    // enough for any number formatted by the functions below, doubles in fixed notation included
+
+/*exact powers of ten representable as doubles*/
+const double EXACT_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+const int MAX_EXACT_POWER = 22;
+const unsigned long long MAX_EXACT_MANTISSA = 1ULL << 53;   // every integer up to 2^53 is an exact double
+
+/*Number function prototypes*/
+bool parseInteger(const char *text, size_t length, int64_t *value);
+double parseDouble(const char *text, size_t length);
+size_t formatInteger(char *buffer, long long value);
+size_t formatDouble(char *buffer, double value);
+size_t formatDigits(char *buffer, unsigned long long digits, int decimals);
+void outInteger(long long value);
+void outDouble(double value);
+
+/* converts a literal made of decimal digits, returning false if it does not fit in 64 bits*/
+bool parseInteger(const char *text, size_t length, int64_t *value){
+    int64_t result = 0;
+    for (size_t i = 0; i < length; i++){
+        int digit = text[i] - '0';
+        if (result > (INT64_MAX - digit) / 10){
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    *value = result;
+    return true;
+}
+
+/* converts a literal made of decimal digits with an optional decimal part (digits.digits), rounding it exactly*/
+double parseDouble(const char *text, size_t length){
+    unsigned long long digits = 0;
+    int decimals = 0;
+    bool fraction = false;
+    bool exact = true;
+    for (size_t i = 0; i < length; i++){
+        if (text[i] == '.'){
+            fraction = true;
+            continue;
+        }
+        if (digits >= MAX_EXACT_MANTISSA / 10){
+            exact = false;
+            break;
+        }
+        digits = digits * 10 + (text[i] - '0');
+        decimals += fraction;
+    }
+    if (exact && digits <= MAX_EXACT_MANTISSA && decimals <= MAX_EXACT_POWER){
+        return (double)digits / EXACT_POWERS_OF_TEN[decimals];
+    }
+    char copy[512];
+    if (length >= sizeof(copy)){
+        return strtod(text, NULL);  // the literal is followed by something that is not a digit anyway
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return strtod(copy, NULL);
+}
+
+/* writes the decimal digits of an integer followed by '\0', returning their number*/
+size_t formatInteger(char *buffer, long long value){
+    char digits[NUMBER_TEXT_SIZE];
+    size_t count = 0;
+    unsigned long long magnitude = value < 0 ? -(unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    size_t length = 0;
+    if (value < 0){
+        buffer[length++] = '-';
+    }
+    while (count > 0){
+        buffer[length++] = digits[--count];
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+/* writes the shortest text that reads back as the same double followed by '\0', returning its length.
+ * The decimals are tried from 1 upwards: for d decimals the candidate is the value times 10^d rounded
+ * to an integer, which reads back as the same double exactly when dividing it by 10^d gives the value again.
+ * Values this cannot handle (too large, or too small to fit 22 decimals) take the fewest significant digits
+ * printf needs, written out in fixed notation, so that every double printed reads back as a literal*/
+size_t formatDouble(char *buffer, double value){
+    double magnitude = signbit(value) ? -value : value;
+    if (magnitude < (double)MAX_EXACT_MANTISSA){
+        for (int decimals = 1; decimals <= MAX_EXACT_POWER; decimals++){
+            double scaled = magnitude * EXACT_POWERS_OF_TEN[decimals];
+            if (scaled >= (double)MAX_EXACT_MANTISSA){
+                break;
+            }
+            unsigned long long digits = (unsigned long long)(scaled + 0.5);
+            if ((double)digits / EXACT_POWERS_OF_TEN[decimals] == magnitude){
+                size_t length = 0;
+                if (signbit(value)){
+                    buffer[length++] = '-';
+                }
+                return length + formatDigits(buffer + length, digits, decimals);
+            }
+        }
+    }
+    if (value != value || magnitude > DBL_MAX){
+        return snprintf(buffer, NUMBER_TEXT_SIZE, "%f", value);   // nan and inf have no literal anyway
+    }
+    //fewest significant digits that read back as the same value (17 always do), as d.ddde[+-]x
+    char scientific[NUMBER_TEXT_SIZE];
+    for (int precision = 0; precision <= 16; precision++){
+        snprintf(scientific, sizeof(scientific), "%.*e", precision, magnitude);
+        if (strtod(scientific, NULL) == magnitude){
+            break;
+        }
+    }
+    char digits[NUMBER_TEXT_SIZE];
+    int count = 0;
+    const char *c = scientific;
+    for (; *c != 'e'; c++){
+        if (*c != '.'){
+            digits[count++] = *c;
+        }
+    }
+    int exponent = atoi(c + 1);     // the first digit is worth 10^exponent
+    size_t length = 0;
+    if (signbit(value)){
+        buffer[length++] = '-';
+    }
+    if (exponent < 0){
+        buffer[length++] = '0';
+        buffer[length++] = '.';
+        for (int i = -1; i > exponent; i--){
+            buffer[length++] = '0';
+        }
+        memcpy(buffer + length, digits, count);
+        length += count;
+    } else {
+        for (int i = 0; i <= exponent || i < count; i++){
+            if (i == exponent + 1){
+                buffer[length++] = '.';
+            }
+            buffer[length++] = i < count ? digits[i] : '0';
+        }
+        if (count <= exponent + 1){
+            buffer[length++] = '.';
+            buffer[length++] = '0';
+        }
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+/* writes digits / 10^decimals in fixed notation, keeping the trailing zeros of the decimals but at least one of them*/
+size_t formatDigits(char *buffer, unsigned long long digits, int decimals){
+    char text[NUMBER_TEXT_SIZE];
+    size_t count = 0;
+    do {
+        text[count++] = '0' + digits % 10;
+        digits /= 10;
+    } while (digits > 0);
+    while (count <= (size_t)decimals){
+        text[count++] = '0';    // leading zeros of values smaller than 1
+    }
+    //the smallest number of decimals has been found, so the last decimal can only be 0 when it is the only one
+    size_t length = 0;
+    while (count > 0){
+        if (count == (size_t)decimals){
+            buffer[length++] = '.';
+        }
+        buffer[length++] = text[--count];
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+// writes an integer into the output buffer
+void outInteger(long long value){
+    char buffer[NUMBER_TEXT_SIZE];
+    outWrite(buffer, formatInteger(buffer, value));
+}
+
+// writes a double into the output buffer, see formatDouble()
+void outDouble(double value){
+    char buffer[NUMBER_TEXT_SIZE];
+    outWrite(buffer, formatDouble(buffer, value));
+}
+
+#endif
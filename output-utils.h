@@ -0,0 +1,152 @@
+#ifndef OUTPUT_UTILS_H
+#define OUTPUT_UTILS_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "session-utils.h"
+
+/* OUTPUT BUFFERING: everything the calculator prints on the standard output goes through
+ * one large buffer per session, which is written out only when it is full, when the session ends or,
+ * in interactive sessions, at the end of every statement.
+ * Sessions running in parallel (see batch-utils.h) capture their output instead: the buffer keeps
+ * growing, and is written out as a whole once the script has completed, so that the outputs of
+ * different scripts are never mixed. Connections to the server (see server-utils.h) capture their errors
+ * in the output too, so that a client gets them along with the results.
+ * In quiet mode (the default when running script files) informational messages and warnings
+ * are not printed at all, so that the output only contains results and errors.*/
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define CAPTURE_BUFFER_SIZE (4 * 1024)   // initial size of a captured output
+
+/*Output function prototypes*/
+void outWrite(const char *string, size_t length);
+void outPrintf(const char *format, ...);
+void vOutPrintf(const char *format, va_list arguments);
+void printInfo(const char *format, ...);
+void printWarning(const char *format, ...);
+void vPrintNotice(const char *format, va_list arguments);
+void printError(const char *format, ...);
+void flushOutput();
+bool reserveOutput(struct text_buffer *buffer, size_t length);
+
+// appends the given characters to the buffer, flushing it first if they do not fit
+void outWrite(const char *string, size_t length){
+    struct text_buffer *output = &session->output;
+    if (!reserveOutput(output, length)){
+        fwrite(string, 1, length, session->outputSink);
+        return;
+    }
+    memcpy(output->chars + output->length, string, length);
+    output->length += length;
+}
+
+// printf into the output buffer
+void outPrintf(const char *format, ...){
+    va_list arguments;
+    va_start(arguments, format);
+    vOutPrintf(format, arguments);
+    va_end(arguments);
+}
+
+void vOutPrintf(const char *format, va_list arguments){
+    struct text_buffer *output = &session->output;
+    va_list copy;
+    va_copy(copy, arguments);
+    size_t available = output->capacity - output->length;
+    int length = vsnprintf(output->chars + output->length, available, format, arguments);
+    if (length < 0){
+        va_end(copy);
+        return;
+    }
+    if ((size_t)length < available){
+        output->length += length;
+    } else if (reserveOutput(output, length + 1)){
+        //did not fit: format again once there is room for it
+        output->length += vsnprintf(output->chars + output->length, output->capacity - output->length, format, copy);
+    } else {
+        vfprintf(session->outputSink, format, copy);
+    }
+    va_end(copy);
+}
+
+// informational messages, such as "Info: Found a match for node x"
+void printInfo(const char *format, ...){
+    va_list arguments;
+    va_start(arguments, format);
+    vPrintNotice(format, arguments);
+    va_end(arguments);
+}
+
+// warnings about implicit conversions and the like
+void printWarning(const char *format, ...){
+    va_list arguments;
+    va_start(arguments, format);
+    vPrintNotice(format, arguments);
+    va_end(arguments);
+}
+
+// messages printed with the results but omitted in quiet mode, see printInfo() and printWarning()
+void vPrintNotice(const char *format, va_list arguments){
+    if (!session->quietMode){
+        vOutPrintf(format, arguments);
+    }
+}
+
+// messages for the standard error, such as syntax errors, printed after the results printed so far
+void printError(const char *format, ...){
+    va_list arguments;
+    va_start(arguments, format);
+    if (session->errorSink != NULL){
+        flushOutput();
+        vfprintf(session->errorSink, format, arguments);
+    } else {
+        struct text_buffer *errors = session->errorsInOutput ? &session->output : &session->errors;
+        va_list copy;
+        va_copy(copy, arguments);
+        int length = vsnprintf(NULL, 0, format, arguments);
+        if (length > 0 && reserveOutput(errors, length + 1)){
+            errors->length += vsnprintf(errors->chars + errors->length, length + 1, format, copy);
+        }
+        va_end(copy);
+    }
+    va_end(arguments);
+}
+
+void flushOutput(){
+    if (session == NULL || session->outputSink == NULL){
+        return;
+    }
+    if (session->output.length > 0){
+        fwrite(session->output.chars, 1, session->output.length, session->outputSink);
+        session->output.length = 0;
+    }
+    fflush(session->outputSink);
+}
+
+/* makes room for length more characters in the buffer: a captured output grows (doubling its size),
+ * otherwise the buffer is flushed. Returns false if the characters are too many for the buffer anyway
+ * and have to be written directly*/
+bool reserveOutput(struct text_buffer *buffer, size_t length){
+    if (buffer->length + length <= buffer->capacity){
+        return true;
+    }
+    if (session->outputSink == NULL || buffer != &session->output){
+        size_t capacity = buffer->capacity == 0 ? CAPTURE_BUFFER_SIZE : buffer->capacity;
+        while (capacity < buffer->length + length){
+            capacity *= 2;
+        }
+        buffer->chars = (char *)realloc(buffer->chars, capacity);
+        if (buffer->chars == NULL){
+            fprintf(stderr, "Error: could not allocate memory for the output!\n");
+            exit(1);
+        }
+        buffer->capacity = capacity;
+        return true;
+    }
+    flushOutput();
+    return length <= buffer->capacity;
+}
+
+#endif
@@ -4,23 +4,45 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include "output-utils.h"
 #include "symboltable-utils.h"
-
-int yyerror (char const *message);
-int yylex(void);
+#include "ast-utils.h"
+#include "vm-utils.h"
+#include "jit-utils.h"
+#include "batch-utils.h"
+#include "server-utils.h"
 %}
 
+/*The parser is pure and the scanner reentrant (see lexer.l): all their state lives in the scanner object,
+// while the state of the calculator lives in the current session (see session-utils.h).
+// The parser either pulls the tokens from the scanner (see parseInput()) or is pushed them (see parseLines())*/
+%define api.pure full
+%define api.push-pull both
+%param {yyscan_t scanner}
+
+%code requires {
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+}
+
+%code {
+int yyerror (yyscan_t scanner, char const *message);
+int yylex(YYSTYPE *lvalp, yyscan_t scanner);
+int scanToken(YYSTYPE *lvalp, yyscan_t scanner);
+}
+
 
 %union {
        	char* lexeme;			//name of an identifier
-       	char* type_var;			//the type of the identifier
+       	char code;			//declared type or shorthand operator
        	/*following are the attributes of the variable depending on its type, i.e. if it is an
        	 *integer, then only the "integer" field is filled in, and so on and so forth*/
        	double double_val;			//double
-       	int integer_val;			//integer
-       	bool truth;			//boolean
-       	struct variable variable_val;
-       	symbol_table *node;
+       	struct variable integer_val;	//integer, which may be big (see integer-utils.h)
+       	struct ast_node *tree;		//syntax tree of an expression, condition or statement
        }
 
 %token <integer_val> INTEGER_VAL
@@ -35,6 +57,10 @@ int yylex(void);
 
 %token IF
 %token THEN
+%token WHILE
+%token FOR
+%token DEF
+%token BIND
 
 %token OR
 %token AND
@@ -52,14 +78,29 @@ int yylex(void);
 
 %token QUIT
 %token PRINT
+%token STATS
+%token SAVE
+%token LOAD
 
-%type <variable_val> expr
-%type <variable_val> val
-%type <type_var> type
-%type <truth> cond
-%type <type_var> shorthand
-%type <node> ass
+%type <tree> statement
+%type <tree> expr
+%type <tree> val
+%type <code> type
+%type <tree> cond
+%type <code> shorthand
+%type <tree> ass
+%type <tree> ifstmt
+%type <tree> loop
+%type <tree> block
+%type <tree> body
+%type <tree> definition
+%type <tree> binding
+%type <tree> parameters
+%type <tree> parameterList
+%type <tree> arguments
+%type <tree> argumentList
 
+%right '?' ':'
 %left OR
 %left AND
 %left '<' '>' '=' LEQ GEQ NEQ EQ
@@ -68,132 +109,355 @@ int yylex(void);
 %left '*' '/' '%'
 %nonassoc  INC DEC
 %left '(' ')'
-%start line
+%start program
 
 %%
-/*The line production simply initiates a loop that enables the application to run more than one input,
-// rather than closing automatically each time. It also allows to close the application safely without errors.*/
-line  : '\n' stmt
-	| stmt '\n' line
-	| '\n' line
-      	| QUIT			{exit(0);}
+/*The program is a loop over the lines of the input, which enables the application to run more than one input,
+// rather than closing automatically each time. The input production is left-recursive, so every line is reduced
+// (and its statement run) as soon as it ends, and the parser stack stays the same size however long the input is.
+// The last statement may miss its newline, and quit closes the application safely without errors.*/
+program : input
+	| input stmt
+	;
+
+input :			/* beginning of the input */
+	| input line
+	;
+
+/*A line with a syntax error is reported (see yyerror) and skipped up to its newline, then parsing goes on with the next one*/
+line  : '\n'
+	| stmt '\n'
+      	| QUIT			{YYACCEPT;}
+	| error '\n'		{yyerrok;
+				 closeScope();
+				 arenaReset();
+				 session->stats.statementStart = 0;}
       	;
 
-/*The stmt (shorthand for "statement") production is in charge of "determining" what the user is trying to do, whether
+/*The stmt (shorthand for "statement") production runs the statement as soon as it has been recognised:
+// the tree built for it is compiled to bytecode and executed (see vm-utils.h)*/
+stmt : statement	{runStatement($1);}
+	| definition	{runStatement($1);}
+	| binding	{runStatement($1);}
+	;
+
+/*The statement production is in charge of "determining" what the user is trying to do, whether
 //to compute an expression, to assingn a (possibly typed) variable or to execute a loop or a conditional clause*/
-stmt : expr		{printResult($1);}
-	| PRINT		{printTable();}
-	| PRINT ID	{printNode(findOrAdd($2));}
-	| TYPE ID	{
-			symbol_table *node = findOrAdd($2);
-			printf("Type of %s: %s",node->id,varType(node->value));}
+statement : expr		{$$ = newStatement(AST_PRINT_EXPR, NULL, $1);}
+	| PRINT		{$$ = newStatement(AST_PRINT_TABLE, NULL, NULL);}
+	| PRINT ID	{$$ = newStatement(AST_PRINT_NODE, findOrAdd($2), NULL);}
+	| TYPE ID	{$$ = newStatement(AST_PRINT_TYPE, findOrAdd($2), NULL);}
+	| STATS		{$$ = newStatement(AST_PRINT_STATS, NULL, NULL);}
+	| SAVE STRING_VAL	{$$ = newStatement(AST_SAVE, NULL, NULL);
+				 $$->value = makeString($2 + 1, strlen($2) - 2);}	// the path, without its quotes
+	| LOAD STRING_VAL	{$$ = newStatement(AST_LOAD, NULL, NULL);
+				 $$->value = makeString($2 + 1, strlen($2) - 2);}
      	| ass
-     	| cond		{printf("Result: %s\n", $1 ? "true" : "false"); }
+     	| cond		{$$ = newStatement(AST_PRINT_COND, NULL, $1);}
      	| ifstmt
+     	| loop
      	;
 
 /*Arithmetic expressions*/
-expr  : expr '+' expr  	{$$ = sumOrConcat($1,$3);}
-      | expr '-' expr  	{if(!($1.type == STRING_TYPE || $3.type == STRING_TYPE)){
-                        	$$ = sub($1,$3);
-                        	} else {
-                        		fprintf(stderr,"ERROR: it is not currently possible to subtract strings");
-                        		}}
-      | expr '*' expr  	{if(!($1.type == STRING_TYPE || $3.type == STRING_TYPE)){
-                        	$$ = multi($1,$3);
-                        	} else {
-                        		fprintf(stderr,"ERROR: it is not currently possible to multiply strings");
-                        		}}
-      | expr '/' expr  	{if(!($1.type == STRING_TYPE || $3.type == STRING_TYPE)){
-                        	$$ = divide($1,$3);
-                        	} else {
-                        		fprintf(stderr,"ERROR: it is not currently possible to divide strings");
-                        		}}
-      | expr INC	{if(!($1.type == STRING_TYPE)){
-      				$$ = inc($1);
-                                }else {
-                                	fprintf(stderr,"ERROR: it is not currently possible to increment strings");
-                                }}
-      | expr DEC	{if(!($1.type == STRING_TYPE)){
-                              	$$ = dec($1);
-                                }else {
-                                	fprintf(stderr,"ERROR: it is not currently possible to decrement strings");
-                                        }}
+expr  : expr '+' expr  	{$$ = newOperation(AST_BINARY, ADD_OP, $1, $3);}
+      | expr '-' expr  	{$$ = newOperation(AST_BINARY, SUB_OP, $1, $3);}
+      | expr '*' expr  	{$$ = newOperation(AST_BINARY, MUL_OP, $1, $3);}
+      | expr '/' expr  	{$$ = newOperation(AST_BINARY, DIV_OP, $1, $3);}
+      | expr INC	{$$ = newOperation(AST_UNARY, INC_OP, $1, NULL);}
+      | expr DEC	{$$ = newOperation(AST_UNARY, DEC_OP, $1, NULL);}
+      | cond '?' expr ':' expr	{$$ = newConditional($1, $3, $5);}
       | '(' expr ')'	{$$=$2;}
       | val
       ;
 
 /*This production returns the values of the specific tokens,
-// in the case of an identifier, it extrapolates the
-// value contained and returns that*/
-val: INTEGER_VAL    	{struct variable data;
-           			 data.type = INTEGER_TYPE;
-           			 data.integer_val = $1;
-           			 $$ = data;}
-           | DOUBLE_VAL	{struct variable data;
-           			 data.type = DOUBLE_TYPE;
-           			 data.double_val = $1;
-           			 $$ = data;}
-           | STRING_VAL	{struct variable data;
-     			data.type = STRING_TYPE;
-     			data.string_val = $1;
-     			$$ = data;}
-           | ID		{struct variable data;
-           		symbol_table *node = findOrAdd($1);
-			data = node->value;
-			$$= data;}
+// in the case of an identifier, it resolves the node that
+// will contain the value when the expression is executed*/
+val: INTEGER_VAL    	{$$ = newValue($1);}
+           | DOUBLE_VAL	{$$ = newValue(doubleValue($1));}
+           | STRING_VAL	{$$ = newValue(makeString($1, strlen($1)));}
+           | ID		{$$ = newName($1);}
+           | ID '(' arguments ')'	{$$ = newCall(findFunction($1), $3);}
            ;
 
+/*The arguments of a call, linked into a list*/
+arguments :			{$$ = NULL;}
+	| argumentList
+	;
+
+argumentList : expr
+	| argumentList ',' expr	{$$ = appendNode($1, $3);}
+	;
+
 /* Definition and/or assignment of a variable.
 // The code aims to handle all cases possible when defining a variable, in this way it would be possible to define a variable without having to
 // explicitly define its type and/or value, which could be defined in a second occasion. Assigning a value to the variable infers also the type
 // intended for the variable itself. Once the variable has received its type, it is no longer possible to overwrite it.*/
-ass : type ID  '=' expr			{$$ = completeTypedAssign($1,$2,$4);	}
-	| type ID shorthand val 	{$$ = completeTypedShorthand($1,$2,$3,$4);}
-	| ID '=' expr   		{$$ = completeUntypedAssign($1,$3);}
-	| ID shorthand val 		{$$ = completeUntypedShorthand($1,$2,$3);}
-	| type ID 			{$$ = typedAssign($1,$2);}
+ass : type ID  '=' expr			{$$ = newStatement(AST_TYPED_ASSIGN, findOrAdd($2), $4);
+					 $$->type = $1;}
+	| type ID shorthand val 	{$$ = newStatement(AST_TYPED_SHORTHAND, findOrAdd($2), $4);
+					 $$->type = $1;
+					 $$->op = $3;}
+	| ID '=' expr   		{$$ = newStatement(AST_ASSIGN, findOrAdd($1), $3);}
+	| ID shorthand val 		{$$ = newStatement(AST_SHORTHAND, findOrAdd($1), $3);
+					 $$->op = $2;}
+	| type ID 			{$$ = newStatement(AST_DECLARE, findOrAdd($2), NULL);
+					 $$->type = $1;}
 	;
 
-type : INTEGER	{$$ = "integer";}
-	| DOUBLE {$$ = "double";}
+type : INTEGER	{$$ = INTEGER_TYPE;}
+	| DOUBLE {$$ = DOUBLE_TYPE;}
 	;
 
-shorthand : MULTASS		{$$="multi_ass";}
-		| ADDASS	{$$="add_ass";}
-		| SUBASS	{$$="sub_ass";}
-		| DIVASS	{$$="div_ass";}
+shorthand : MULTASS		{$$ = MUL_OP;}
+		| ADDASS	{$$ = ADD_OP;}
+		| SUBASS	{$$ = SUB_OP;}
+		| DIVASS	{$$ = DIV_OP;}
 		;
 
 /*managing conditional statements*/
-cond : expr '<' expr		{$$ = lesserNum($1,$3);}
-	| expr '>' expr		{$$ = greaterNum($1,$3);}
-	| expr LEQ expr		{$$ = leqNum($1,$3);}
-	| expr GEQ expr		{$$ = geqNum($1,$3);}
-	| expr EQ expr		{$$ = equal($1,$3);}
-	| expr NEQ expr		{$$ = neqNum($1,$3);}
-	| cond AND cond 	{$$ = $1 && $3;}
-	| cond OR cond		{$$ = $1 || $3;}
+cond : expr '<' expr		{$$ = newOperation(AST_COMPARE, LT_OP, $1, $3);}
+	| expr '>' expr		{$$ = newOperation(AST_COMPARE, GT_OP, $1, $3);}
+	| expr LEQ expr		{$$ = newOperation(AST_COMPARE, LEQ_OP, $1, $3);}
+	| expr GEQ expr		{$$ = newOperation(AST_COMPARE, GEQ_OP, $1, $3);}
+	| expr EQ expr		{$$ = newOperation(AST_COMPARE, EQ_OP, $1, $3);}
+	| expr NEQ expr		{$$ = newOperation(AST_COMPARE, NEQ_OP, $1, $3);}
+	| cond AND cond 	{$$ = newOperation(AST_LOGIC, AND_OP, $1, $3);}
+	| cond OR cond		{$$ = newOperation(AST_LOGIC, OR_OP, $1, $3);}
 	;
 
 
 
 //simple if-statement implementation that prints the string contained when the condition is true
-ifstmt	: IF '(' cond ')' THEN '{' STRING_VAL '}' { if($3){printf("%s\n", $7);}; }
+ifstmt	: IF '(' cond ')' THEN '{' STRING_VAL '}' {$$ = newStatement(AST_IF, NULL, $3);
+						    $$->value = makeString($7, strlen($7));}
+	;
+
+/*Loops are parsed as a whole, up to their closing brace, so that the body is compiled only once and runs without
+// going through the scanner and the parser again. A for loop runs its first assignment once, then its body followed
+// by its second assignment for as long as the condition holds*/
+loop	: WHILE '(' cond ')' block		{$$ = newLoop(AST_WHILE, $3, $5);}
+	| FOR '(' ass ';' cond ';' ass ')' block	{$$ = newLoop(AST_FOR, $5, appendNode($9, $7));
+						 $$->right = $3;}
+	;
+
+/*Function definitions, only allowed at the top level. The parameters are in scope while the body is parsed,
+// so that their names are told apart from those of global variables (see function-utils.h)*/
+definition : DEF ID '(' parameters ')'		{openScope($4);}
+	  '=' expr				{closeScope();
+						 $$ = newStatement(AST_DEFINE, NULL, $8);
+						 $$->index = findFunction($2);
+						 $$->right = $4;}
+	;
+
+/*Reactive bindings, only allowed at the top level: the variable follows the formula whenever the variables
+// the formula reads change (see binding-utils.h)*/
+binding : ID BIND expr		{$$ = newStatement(AST_BIND, findOrAdd($1), $3);}
+	;
+
+parameters :			{$$ = NULL;}
+	| parameterList
+	;
+
+parameterList : ID			{$$ = newParameter($1, NULL);}
+	| parameterList ',' ID		{$$ = newParameter($3, $1);}
+	;
+
+/*The statements of a block are separated by semicolons or newlines, the last one may miss its separator*/
+block	: '{' body '}'			{$$ = $2;}
+	| '{' body statement '}'	{$$ = appendNode($2, $3);}
+	;
+
+body	:				{$$ = NULL;}
+	| body ';'			{$$ = $1;}
+	| body '\n'			{$$ = $1;}
+	| body statement ';'		{$$ = appendNode($1, $2);}
+	| body statement '\n'		{$$ = appendNode($1, $2);}
 	;
 
 %%
 
 #include "lex.yy.c"
 
-int yyerror (char const *message){
-	return fprintf (stderr, "%s\n", message);
-	fputs (message, stderr);
-	fputc ('\n', stderr);
+/* Reads the next token, counting it in the statistics of the session (see stats-utils.h):
+// one token every STATS_LEX_SAMPLE is timed, and the first token of every statement marks the start of its parsing*/
+int yylex(YYSTYPE *lvalp, yyscan_t scanner){
+	struct stats *stats = &session->stats;
+	int token;
+	if (++stats->tokens % STATS_LEX_SAMPLE == 0) {
+		uint64_t start = statsClock();
+		token = scanToken(lvalp, scanner);
+		stats->lexSampleNs += statsClock() - start;
+		stats->lexSamples++;
+	} else {
+		token = scanToken(lvalp, scanner);
+	}
+	if (stats->statementStart == 0 && token != 0) {	// the end of the lines pushed so far (see parseLines()) starts nothing
+		stats->statementStart = statsClock();
+	}
+	return token;
+}
+
+int yyerror (yyscan_t scanner, char const *message){
+	printError("%s\n", message); // after the results printed so far
+	session->syntaxErrors++;
 	return 0;
 }
 
-int main(void)
+/* Parses and runs the statements read from input, in the current session.
+// Returns 0 once the input is over (or after quit), 1 if there were syntax errors (the lines with errors are skipped)
+// or after an unrecoverable error, which ends the input rather than the whole process (see sessionExit())*/
+int parseInput(FILE *input){
+	yyscan_t scanner;
+	if (yylex_init(&scanner) != 0) {
+		printError("Error: could not create the scanner!\n");
+		return 1;
+	}
+	yyset_in(input, scanner);
+
+	jmp_buf exitJump;
+	int status;
+	session->exitJump = &exitJump;
+	if (setjmp(exitJump) == 0) {
+		session->syntaxErrors = 0;
+		status = yyparse(scanner) != 0 || session->syntaxErrors > 0;
+	} else {
+		status = session->exitStatus;
+		unlockTable();
+		closeScope();
+		resetVm();
+		arenaReset();
+	}
+	session->exitJump = NULL;
+	yylex_destroy(scanner);
+	return status;
+}
+
+/* Parses and runs the complete lines in text, in the current session, going on with the statement the lines before them
+// left open: the tokens are pushed to the parser, which keeps its state between the calls (see server-utils.h).
+// With last, the end of the input is pushed after the lines.
+// Returns -1 while the input goes on, then the status parseInput() would have returned for the whole input*/
+int parseLines(struct yypstate *parser, yyscan_t scanner, const char *text, size_t length, bool last){
+	YY_BUFFER_STATE buffer = yy_scan_bytes(text, (int)length, scanner);
+	jmp_buf exitJump;
+	volatile int status = YYPUSH_MORE;
+	session->exitJump = &exitJump;
+	if (setjmp(exitJump) == 0) {
+		YYSTYPE value;
+		int token;
+		while (status == YYPUSH_MORE && (token = yylex(&value, scanner)) != 0) {
+			status = yypush_parse(parser, token, &value, scanner);
+		}
+		if (status == YYPUSH_MORE && last) {
+			status = yypush_parse(parser, YYEOF, &value, scanner);
+		}
+		if (status != YYPUSH_MORE) {
+			status = status != 0 || session->syntaxErrors > 0;
+		}
+	} else {
+		status = session->exitStatus;
+		unlockTable();
+		closeScope();
+		resetVm();
+		arenaReset();
+	}
+	session->exitJump = NULL;
+	yy_delete_buffer(buffer, scanner);
+	return status == YYPUSH_MORE ? -1 : status;
+}
+
+#ifndef CALC_NO_MAIN
+/* Without arguments the calculator reads statements from the standard input.
+// In batch mode the statements are read from the script files given as arguments, each one in a session of its own,
+// and only results and errors are printed (--verbose brings back informational messages and warnings).
+// --jobs N runs the scripts on N threads (see batch-utils.h), their outputs are still printed in order.
+// --listen PATH serves the statements of the clients connecting to the Unix domain socket PATH, each one in a session
+// of its own, on N threads with --jobs N or one per processor otherwise (see server-utils.h).
+// --shared makes the clients of --listen share one symbol-table, read without locks (see shared-utils.h).
+// --journal PATH recovers the symbol-table of the standard input (or of --listen --shared) from the snapshot PATH
+// and its log, then logs every change to it, flushed to the disk every --commit-interval MS milliseconds (see journal-utils.h).
+// --dump-folded prints every statement as it is after constant folding, right before running it.
+// --jit compiles the numeric expressions of hot loops, functions and formulas to x86-64 machine code (see jit-utils.h).
+// --memo-size N sets the entries of the memo cache of every pure function, 0 disables memoization (see function-utils.h).
+// --stats-json FILE writes the statistics of the whole run to FILE at exit (see stats-utils.h).
+// The benchmarks (benchmark.c) compile the whole calculator without this function, defining CALC_NO_MAIN.*/
+int main(int argc, char **argv)
 {
-  return yyparse();
-}
\ No newline at end of file
+  bool quiet = false;
+  bool verbose = false;
+  int jobs = 0;
+  char *statsPath = NULL;
+  char *socketPath = NULL;
+  bool shared = false;
+  char *journalPath = NULL;
+  int firstScript = argc;
+  for (int i = 1; i < argc && firstScript == argc; i++) {
+    if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) {
+      quiet = true;
+    } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+      verbose = true;
+    } else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+      jobs = atoi(argv[++i]);
+      if (jobs < 1) {
+        jobs = 1;
+      }
+    } else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+      socketPath = argv[++i];
+    } else if (strcmp(argv[i], "--shared") == 0) {
+      shared = true;
+    } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+      journalPath = argv[++i];
+    } else if (strcmp(argv[i], "--commit-interval") == 0 && i + 1 < argc) {
+      commitInterval = atoi(argv[++i]);
+      if (commitInterval < 1) {
+        commitInterval = 1;
+      }
+    } else if (strcmp(argv[i], "--stats-json") == 0 && i + 1 < argc) {
+      statsPath = argv[++i];
+    } else if (strcmp(argv[i], "--memo-size") == 0 && i + 1 < argc) {
+      memoCapacity = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--dump-folded") == 0) {
+      dumpFolded = true;
+    } else if (strcmp(argv[i], "--jit") == 0) {
+#if defined(__x86_64__)
+      jitEnabled = true;
+#else
+      fprintf(stderr, "Warning: --jit is only available on x86-64, the bytecode runs instead\n");
+#endif
+    } else {
+      firstScript = i;
+    }
+  }
+
+  if (journalPath != NULL && (socketPath != NULL ? !shared : firstScript != argc)) {
+    fprintf(stderr, "Error: --journal only applies to the standard input or to --listen with --shared\n");
+    return 1;
+  }
+
+  int status;
+  if (socketPath != NULL) {
+    status = runServer(socketPath, jobs > 0 ? jobs : (int)sysconf(_SC_NPROCESSORS_ONLN), shared, journalPath, verbose);
+  } else if (firstScript == argc) {
+    createSession(stdout, stderr, OUTPUT_BUFFER_SIZE);
+    session->quietMode = quiet;
+    session->interactive = isatty(fileno(stdin));
+    if (journalPath != NULL && !openJournal(journalPath)) {
+      flushOutput();
+      endSession();
+      return 1;
+    }
+    status = parseInput(stdin);
+    flushOutput();
+    closeJournal(session->table);
+    endSession();
+  } else {
+    status = runScripts(argv + firstScript, argc - firstScript, jobs > 0 ? jobs : 1, verbose);
+  }
+
+  if (statsPath != NULL && !writeStatsJson(statsPath)) {
+    fprintf(stderr, "Error: could not write the statistics to %s\n", statsPath);
+    status = 1;
+  }
+  return status;
+}
+#endif
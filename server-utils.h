@@ -0,0 +1,424 @@
+#ifndef SERVER_UTILS_H
+#define SERVER_UTILS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "session-utils.h"
+#include "output-utils.h"
+#include "shared-utils.h"
+#include "journal-utils.h"
+
+/* SERVER MODE: with --listen PATH the calculator serves statements on a Unix domain socket, so that clients
+ * pay neither the start of a process nor the set-up of a symbol-table for every request.
+ * Every connection has a session of its own (see session-utils.h) and a parser of its own. The parser is pushed
+ * the tokens of the lines as they arrive (see parseLines() in parser.y), so a statement left open at the end of
+ * what has arrived so far, like a loop spanning several lines, waits in the parser of its connection for the lines
+ * that complete it, and no thread ever blocks on a connection.
+ * A pool of workers waits on one epoll instance. Connections are registered with EPOLLONESHOT, so a connection is
+ * handled by one worker at a time and its session needs no lock: the worker reads what has arrived, runs the complete
+ * lines, and answers with a single write holding their whole output, results and errors in the order they were printed.
+ * While a client does not read its answers the connection is not read either, so its output cannot grow without bound.
+ * With --shared the sessions all work on one symbol-table instead (see shared-utils.h): the assignments of a client are
+ * seen by the others, and the workers running statements that only read it never wait for each other or for a writer.
+ * The changes to the shared table can be journaled, so that a server restarted after a crash finds them again.
+ * The server stops on SIGINT or SIGTERM (or stopServer()), releasing the sessions of the connections still open.*/
+#define SERVER_EVENTS 8                     // events taken by a worker at a time, so that a burst is shared among the workers
+#define SERVER_READ_SIZE (16 * 1024)        // bytes read at a time, and initial size of the input of a connection
+#define SERVER_READ_LIMIT (64 * 1024)       // bytes read before running them, so that one client cannot hold a worker
+#define SERVER_LINE_LIMIT (1 << 20)         // longest line accepted, the connection is closed after a longer one
+
+struct connection{
+    int fd;
+    struct session *session;
+    struct yypstate *parser;
+    struct text_buffer input;       // bytes received and not run yet, the incomplete last line
+    size_t sent;                    // bytes of the output of the session already written
+    bool closing;                   // the input is over, the connection closes once its output has been written
+    struct connection *previous;    // list of the open connections, released when the server stops
+    struct connection *next;
+};
+
+struct server{
+    int listener;
+    int epoll;
+    int spare;                      // descriptor given up to accept (and close) a connection when there are none left
+    const char *path;
+    bool verbose;
+    struct table *table;            // symbol-table of every connection with --shared, NULL otherwise
+    pthread_mutex_t lock;           // protects the list of connections and the spare descriptor
+    struct connection *connections;
+};
+
+/*eventfd signalled to stop the workers, -1 when no server is running*/
+int serverWakeup = -1;
+
+/*defined in parser.y*/
+int parseLines(struct yypstate *parser, void *scanner, const char *text, size_t length, bool last);
+struct yypstate *yypstate_new(void);
+void yypstate_delete(struct yypstate *parser);
+int yylex_init(void **scanner);
+int yylex_destroy(void *scanner);
+
+/*Server function prototypes*/
+int runServer(const char *path, int workers, bool shared, const char *journalPath, bool verbose);
+bool openListener(struct server *server);
+void *serveConnections(void *argument);
+void acceptConnections(struct server *server);
+void handleConnection(struct server *server, struct connection *connection, uint32_t events, void *scanner);
+bool readInput(struct connection *connection, bool *ended);
+bool runInput(struct connection *connection, void *scanner, bool ended);
+bool writeOutput(struct connection *connection);
+void closeConnection(struct server *server, struct connection *connection);
+void stopServer(int signal);
+
+/* serves the socket at path on the given number of threads until the server is stopped,
+ * then returns 0, or 1 if the server could not start.
+ * With a journal path, the shared table is recovered from the journal before the first connection (see journal-utils.h)*/
+int runServer(const char *path, int workers, bool shared, const char *journalPath, bool verbose){
+    struct server server;
+    memset(&server, 0, sizeof(server));
+    server.path = path;
+    server.verbose = verbose;
+    server.table = shared ? createSharedTable() : NULL;
+    workers = workers < 1 ? 1 : workers;
+    pthread_mutex_init(&server.lock, NULL);
+
+    //every connection takes a descriptor, so the soft limit is raised as far as it goes
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (journalPath != NULL){
+        createSession(stdout, stderr, OUTPUT_BUFFER_SIZE);
+        session->quietMode = !verbose;
+        attachTable(server.table);
+        bool recovered = openJournal(journalPath);
+        flushOutput();
+        endSession();
+        if (!recovered){
+            pthread_mutex_destroy(&server.lock);
+            return 1;
+        }
+    }
+    if (!openListener(&server)){
+        pthread_mutex_destroy(&server.lock);
+        if (server.table != NULL){
+            closeJournal(server.table);
+        }
+        free(server.table);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopServer;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    //the calling thread is the first worker, the others get a thread each
+    pthread_t *threads = (pthread_t *)malloc(workers * sizeof(pthread_t));
+    if (threads == NULL){
+        fprintf(stderr, "Error: could not allocate memory for the server!\n");
+        exit(1);
+    }
+    int started = 1;
+    for (int i = 1; i < workers; i++){
+        if (pthread_create(&threads[i], NULL, serveConnections, &server) != 0){
+            break;
+        }
+        started++;
+    }
+    serveConnections(&server);
+    for (int i = 1; i < started; i++){
+        pthread_join(threads[i], NULL);
+    }
+
+    while (server.connections != NULL){
+        closeConnection(&server, server.connections);
+    }
+    if (server.table != NULL){
+        closeJournal(server.table);
+        createSession(NULL, NULL, CAPTURE_BUFFER_SIZE);     // releasing the table reports to a session
+        releaseSharedTable(server.table);
+        endSession();
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    int wakeup = serverWakeup;
+    serverWakeup = -1;
+    close(wakeup);
+    close(server.listener);
+    close(server.epoll);
+    close(server.spare);
+    unlink(path);
+    pthread_mutex_destroy(&server.lock);
+    free(threads);
+    return 0;
+}
+
+/* binds the socket (replacing a socket left at path by a server that did not stop cleanly)
+ * and registers it in the epoll instance, along with the eventfd that stops the workers*/
+bool openListener(struct server *server){
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(server->path) >= sizeof(address.sun_path)){
+        fprintf(stderr, "Error: the socket path %s is too long!\n", server->path);
+        return false;
+    }
+    strcpy(address.sun_path, server->path);
+    struct stat status;
+    if (stat(server->path, &status) == 0 && S_ISSOCK(status.st_mode)){
+        unlink(server->path);
+    }
+
+    server->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    server->epoll = epoll_create1(EPOLL_CLOEXEC);
+    serverWakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    server->spare = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (server->listener < 0 || server->epoll < 0 || serverWakeup < 0 || server->spare < 0
+        || bind(server->listener, (struct sockaddr *)&address, sizeof(address)) != 0
+        || listen(server->listener, SOMAXCONN) != 0){
+        fprintf(stderr, "Error: could not listen on %s: %s\n", server->path, strerror(errno));
+        return false;
+    }
+
+    //one worker is woken for a new connection, all of them when the server stops
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = &server->listener;
+    epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->listener, &event);
+    event.events = EPOLLIN;
+    event.data.ptr = &serverWakeup;
+    epoll_ctl(server->epoll, EPOLL_CTL_ADD, serverWakeup, &event);
+    return true;
+}
+
+/* loop of a worker: every event is a new connection, a connection with input (or room for its output), or the stop*/
+void *serveConnections(void *argument){
+    struct server *server = (struct server *)argument;
+    void *scanner;      // the scanner of a worker is switched to the lines of the connection it runs
+    if (yylex_init(&scanner) != 0){
+        fprintf(stderr, "Error: could not create the scanner!\n");
+        return NULL;
+    }
+    struct epoll_event events[SERVER_EVENTS];
+    bool running = true;
+    while (running){
+        int count = epoll_wait(server->epoll, events, SERVER_EVENTS, -1);
+        if (count < 0 && errno != EINTR){
+            fprintf(stderr, "Error: could not wait for the connections: %s\n", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < count; i++){
+            if (events[i].data.ptr == &serverWakeup){
+                running = false;
+            } else if (events[i].data.ptr == &server->listener){
+                acceptConnections(server);
+            } else {
+                handleConnection(server, (struct connection *)events[i].data.ptr, events[i].events, scanner);
+            }
+        }
+    }
+    yylex_destroy(scanner);
+    useSession(NULL);
+    return NULL;
+}
+
+/* accepts the pending connections, each one in a new session with a new parser*/
+void acceptConnections(struct server *server){
+    while (true){
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0){
+            if (errno == EMFILE || errno == ENFILE){
+                //out of descriptors: the connection is refused, rather than left pending and waking the workers forever
+                pthread_mutex_lock(&server->lock);
+                close(server->spare);
+                fd = accept(server->listener, NULL, NULL);
+                if (fd >= 0){
+                    close(fd);
+                }
+                server->spare = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                pthread_mutex_unlock(&server->lock);
+                continue;
+            }
+            return;     // nothing left to accept (EAGAIN), or the client is gone already
+        }
+
+        fcntl(fd, F_SETFL, O_NONBLOCK);     // accepted sockets do not inherit it from the listener
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        struct connection *connection = (struct connection *)calloc(1, sizeof(struct connection));
+        if (connection == NULL){
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        connection->parser = yypstate_new();
+        connection->session = createSession(NULL, NULL, CAPTURE_BUFFER_SIZE);
+        session->quietMode = !server->verbose;
+        session->errorsInOutput = true;
+        if (server->table != NULL){
+            attachTable(server->table);
+        }
+        if (connection->parser == NULL){
+            endSession();
+            free(connection);
+            close(fd);
+            continue;
+        }
+        pthread_mutex_lock(&server->lock);
+        connection->next = server->connections;
+        if (server->connections != NULL){
+            server->connections->previous = connection;
+        }
+        server->connections = connection;
+        pthread_mutex_unlock(&server->lock);
+
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = connection;
+        epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+/* writes out what is left of the last answer, then reads and runs the new lines and answers them.
+ * The connection is armed again for its next event, unless it has been closed*/
+void handleConnection(struct server *server, struct connection *connection, uint32_t events, void *scanner){
+    useSession(connection->session);
+    bool open = writeOutput(connection);
+    if (open && connection->sent == 0 && !connection->closing){
+        bool ended = false;
+        open = readInput(connection, &ended);
+        open = open && runInput(connection, scanner, ended);
+        open = open && writeOutput(connection);
+    }
+    if (!open || (connection->closing && connection->sent == 0)){
+        closeConnection(server, connection);
+        return;
+    }
+    struct epoll_event event;
+    event.events = (connection->sent > 0 ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+    event.data.ptr = connection;
+    epoll_ctl(server->epoll, EPOLL_CTL_MOD, connection->fd, &event);
+    useSession(NULL);
+}
+
+/* appends what has arrived to the input of the connection, up to SERVER_READ_LIMIT bytes
+ * (the rest is read the next time). Returns false if the connection failed*/
+bool readInput(struct connection *connection, bool *ended){
+    struct text_buffer *input = &connection->input;
+    size_t limit = input->length + SERVER_READ_LIMIT;
+    while (input->length < limit){
+        if (input->capacity - input->length < SERVER_READ_SIZE){
+            size_t capacity = input->capacity == 0 ? SERVER_READ_SIZE : input->capacity * 2;
+            char *chars = (char *)realloc(input->chars, capacity);
+            if (chars == NULL){
+                return false;
+            }
+            input->chars = chars;
+            input->capacity = capacity;
+        }
+        ssize_t length = read(connection->fd, input->chars + input->length, input->capacity - input->length);
+        if (length > 0){
+            input->length += length;
+        } else if (length == 0){
+            *ended = true;
+            return true;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+    }
+    return true;
+}
+
+/* runs the complete lines of the input and keeps the incomplete last one for later, or runs it too if the input has ended.
+ * Returns false if the line is too long to keep*/
+bool runInput(struct connection *connection, void *scanner, bool ended){
+    struct text_buffer *input = &connection->input;
+    size_t complete = input->length;
+    while (complete > 0 && input->chars[complete - 1] != '\n'){
+        complete--;
+    }
+    if (ended){
+        complete = input->length;
+    } else if (input->length - complete > SERVER_LINE_LIMIT){
+        printError("Error: the line is longer than %d bytes!\n", SERVER_LINE_LIMIT);
+        connection->closing = true;
+        return true;
+    }
+    if (complete > 0 || ended){
+        beginReading();
+        int status = parseLines(connection->parser, scanner, input->chars, complete, ended);
+        endReading();
+        if (status >= 0){
+            connection->closing = true;     // the input is over, or quit
+        }
+        memmove(input->chars, input->chars + complete, input->length - complete);
+        input->length -= complete;
+    }
+    return true;
+}
+
+/* writes out the output of the session, as much of it as the socket takes.
+ * Returns false if the connection failed*/
+bool writeOutput(struct connection *connection){
+    struct text_buffer *output = &session->output;
+    while (connection->sent < output->length){
+        ssize_t length = send(connection->fd, output->chars + connection->sent, output->length - connection->sent, MSG_NOSIGNAL);
+        if (length < 0){
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        connection->sent += length;
+    }
+    output->length = 0;
+    connection->sent = 0;
+    return true;
+}
+
+/* closes the socket and releases the session and the parser of the connection*/
+void closeConnection(struct server *server, struct connection *connection){
+    pthread_mutex_lock(&server->lock);
+    if (connection->previous != NULL){
+        connection->previous->next = connection->next;
+    } else {
+        server->connections = connection->next;
+    }
+    if (connection->next != NULL){
+        connection->next->previous = connection->previous;
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    close(connection->fd);
+    yypstate_delete(connection->parser);
+    useSession(connection->session);
+    endSession();
+    free(connection->input.chars);
+    free(connection);
+}
+
+// wakes every worker to stop the server, also from a signal handler
+void stopServer(int signal){
+    uint64_t one = 1;
+    if (serverWakeup >= 0){
+        ssize_t written = write(serverWakeup, &one, sizeof(one));
+        (void)written;      // it only fails when the server has been stopped already
+    }
+}
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef SESSION_UTILS_H
+#define SESSION_UTILS_H
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stats-utils.h"
+
+/* SESSIONS: all the state of a running calculator (output buffers, statement arena, identifier pool,
+ * symbol-table and stack of the virtual machine) is kept in a session object rather than in globals,
+ * so that several scripts can be evaluated at the same time by different threads.
+ * Every thread works on its own current session (see useSession()), which is what the functions
+ * of the other headers operate on, while the scanner and the parser are reentrant and keep their
+ * state in the scanner object passed to them (see parser.y).*/
+
+/*growable block of text, used to capture the output of a session*/
+struct text_buffer{
+    char *chars;
+    size_t length;
+    size_t capacity;
+};
+
+struct arena_block;
+struct interned_string;
+struct table_node;
+struct index_slot;
+struct variable;
+struct function;
+struct call_frame;
+struct ast_node;
+struct walk_entry;
+struct retired_memory;
+struct snapshot_map;
+struct journal;
+
+/* SYMBOL-TABLE AND IDENTIFIER POOL: every session has a table of its own, apart from the connections of a server
+ * sharing one table among all of them (see shared-utils.h)*/
+struct table{
+    //identifier pool (see intern-utils.h)
+    struct interned_string **internSlots;
+    size_t internCapacity;      // always a power of two
+    size_t internCount;
+    char *internBlock;
+    size_t internBlockLeft;
+    char *internBlocks;         // chain of all the blocks, each one starting with a pointer to the previous one
+
+    //symbol-table (see symboltable-utils.h)
+    struct table_node *head;
+    struct table_node *tail;    // last node added, new nodes are appended after it
+    bool table_init;
+    int numberOfNodes;
+    struct index_slot *tableIndex;
+    size_t indexCapacity;       // always a power of two
+    struct table_node *nodeBlock;
+    int nodesLeftInBlock;
+    struct table_node **slotTable;
+    int slotCapacity;
+    struct snapshot_map *snapshots;     // files the values may point into (see snapshot-utils.h)
+    struct journal *journal;    // log of the changes, NULL when they are not journaled (see journal-utils.h)
+
+    //sharing (see shared-utils.h)
+    bool shared;
+    pthread_mutex_t writeLock;
+    unsigned int version;       // odd while the indexes or the slot table are being replaced
+    uint64_t epoch;
+    struct retired_memory *retired;
+    int retiredCount;
+    int retiredCapacity;
+    struct session **readers;   // sessions working on the table
+    int readerCount;
+    int readerCapacity;
+};
+
+struct session{
+    //output (see output-utils.h)
+    struct text_buffer output;
+    struct text_buffer errors;  // error messages, when they are captured
+    FILE *outputSink;           // where the output is flushed, NULL if it is captured until the session ends
+    FILE *errorSink;            // where error messages go, NULL if they are captured as well
+    bool errorsInOutput;        // captured error messages go to the output, in the order they were printed
+    bool quietMode;             // suppresses informational messages and warnings
+    bool interactive;           // flushes the buffer after every statement
+
+    //statement arena (see arena-utils.h)
+    struct arena_block *arenaFirst;
+    struct arena_block *arenaCurrent;
+    char *arenaNext;            // first free byte of the current block
+    char *arenaEnd;             // end of the current block
+
+    //symbol-table and identifier pool, the session's own or a shared one (see shared-utils.h)
+    struct table *table;
+    struct table ownTable;
+    uint64_t readEpoch;         // epoch of the shared table announced while running statements, 0 otherwise
+    bool tableLocked;           // holds the write lock of the shared table
+    struct walk_entry *walk;    // stack used to walk the dependency graph (see binding-utils.h)
+    int walkCount;
+    int walkCapacity;
+    unsigned int walkMark;
+
+    //virtual machine (see vm-utils.h)
+    struct variable *vmStack;
+    int vmStackCapacity;
+    struct call_frame *frames;  // frames of the calls running
+    int frameCapacity;
+    int vmTop;                  // values and frames used by the chunks running below the current one,
+    int frameTop;               // when a chunk runs while another one is waiting for it (see refreshBinding())
+
+    //user-defined functions (see function-utils.h)
+    struct function *functions;
+    int functionCount;
+    int functionCapacity;
+    struct ast_node *scope;     // parameters of the definition being parsed, NULL outside definitions
+
+    struct stats stats;         // see stats-utils.h
+
+    int syntaxErrors;           // lines skipped because of syntax errors, in the current input
+
+    jmp_buf *exitJump;          // where sessionExit() returns to, instead of ending the process
+    int exitStatus;
+};
+
+/*session the current thread is working on*/
+_Thread_local struct session *session = NULL;
+
+/*Session function prototypes*/
+struct session *createSession(FILE *outputSink, FILE *errorSink, size_t outputCapacity);
+void useSession(struct session *newSession);
+void endSession();
+void sessionExit(int status);
+void releaseArena();
+void releaseInternPool();
+void releaseSymbolTable();
+void releaseVm();
+void releaseFunctions();
+void detachTable();
+
+/* creates a new session writing to the given streams (NULL to capture the output or the errors
+ * in the buffers of the session) and makes it the current one*/
+struct session *createSession(FILE *outputSink, FILE *errorSink, size_t outputCapacity){
+    struct session *newSession = (struct session *)calloc(1, sizeof(struct session));
+    char *buffer = (char *)malloc(outputCapacity);
+    if (newSession == NULL || buffer == NULL){
+        fprintf(stderr, "Error: could not allocate memory for the session!\n");
+        exit(1);
+    }
+    newSession->output.chars = buffer;
+    newSession->output.capacity = outputCapacity;
+    newSession->outputSink = outputSink;
+    newSession->errorSink = errorSink;
+    newSession->table = &newSession->ownTable;
+    useSession(newSession);
+    return newSession;
+}
+
+void useSession(struct session *newSession){
+    session = newSession;
+}
+
+/* releases everything belonging to the current session (captured output included, so it has to be
+ * collected first) and adds its statistics to those of the process, after which the thread has no current session*/
+void endSession(){
+    publishStats(&session->stats);
+    releaseVm();
+    releaseFunctions();
+    if (session->table->shared){
+        detachTable();      // a shared table outlives the sessions working on it
+    }
+    releaseSymbolTable();
+    releaseInternPool();
+    releaseArena();
+    free(session->output.chars);
+    free(session->errors.chars);
+    free(session);
+    session = NULL;
+}
+
+/* stops the session after an unrecoverable error: control goes back to whoever is running it
+ * (see parseInput() in parser.y), or the process ends when nobody is*/
+void sessionExit(int status){
+    if (session != NULL && session->exitJump != NULL){
+        session->exitStatus = status;
+        longjmp(*session->exitJump, 1);
+    }
+    exit(status);
+}
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef SHARED_UTILS_H
+#define SHARED_UTILS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "session-utils.h"
+#include "output-utils.h"
+#include "variable-utils.h"
+
+/* SHARED SYMBOL-TABLE: the connections of a server started with --shared (see server-utils.h) all work on the same
+ * symbol-table and identifier pool, so that what one of them assigns the others can read: typically one feeder
+ * applying assignments and many clients printing values.
+ * Readers never take a lock. Writers (assignments and declarations, and the lookups that add a node or an identifier)
+ * take the write lock of the table, one at a time, and publish their changes so that a reader sees either the old
+ * state or the new one:
+ * - a value is a single 64-bit word (see variable-utils.h), stored and loaded atomically, so it is never torn;
+ *   the other fields of a node change along with it under the version of the node (a seqlock), so that
+ *   printing a node reads them again until it has read them all from the same version
+ * - the hash indexes and the slot table are never changed in place once published, apart from filling empty slots:
+ *   growing them builds new arrays, and the version of the table (another seqlock) tells readers to read the
+ *   pointers again. New nodes and identifiers are complete before the pointers to them are stored
+ * - what a writer replaces (the string of a variable, an index that has grown) may still be in use by readers, so it is
+ *   retired rather than freed: a session announces the epoch of the table while it runs statements, announcing it
+ *   again between statements, and what is retired in an epoch is freed once every session running statements has
+ *   announced a later one (epoch-based reclamation, as in RCU)
+ * Tables that are not shared go through the same code, where the lock and the retirement cost a branch each.
+ * Bindings read and write nodes as they are read, so they are not available on a shared table.*/
+#define RECLAIM_BATCH 64    // retired blocks kept before trying to free them, on top of one per session
+
+struct retired_memory{
+    struct variable value;  // string or big integer, undefined when the block is plain memory
+    void *memory;
+    uint64_t epoch;         // epoch of the table when the block was retired
+};
+
+// atomic loads and stores of the fields that readers without the lock may be reading while a writer changes them
+#define loadShared(field) __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define publish(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+
+/*Shared table function prototypes*/
+struct table *createSharedTable();
+void releaseSharedTable(struct table *table);
+void attachTable(struct table *table);
+void detachTable();
+void lockTable();
+void unlockTable();
+void beginReading();
+void endReading();
+void beginTableChange();
+void endTableChange();
+unsigned int readTableVersion();
+bool tableChanged(unsigned int version);
+void retireValue(struct variable value);
+void retireMemory(void *memory);
+void retire(struct variable value, void *memory);
+void reclaimRetired(bool everything);
+void releaseSymbolTable();
+void releaseInternPool();
+void freeBigInteger(struct variable *value);   // defined in integer-utils.h
+
+struct table *createSharedTable(){
+    struct table *table = (struct table *)calloc(1, sizeof(struct table));
+    if (table == NULL){
+        fprintf(stderr, "Error: could not allocate memory for the shared symbol-table!\n");
+        exit(1);
+    }
+    table->shared = true;
+    table->epoch = 1;       // 0 stands for a session that is not running statements
+    pthread_mutex_init(&table->writeLock, NULL);
+    return table;
+}
+
+/* releases the table, its nodes and identifiers, once no session works on it any longer*/
+void releaseSharedTable(struct table *table){
+    struct table *own = session->table;
+    session->table = table;
+    reclaimRetired(true);   // before the snapshots the retired values may point into are unmapped
+    releaseSymbolTable();
+    releaseInternPool();
+    free(table->retired);
+    free(table->readers);
+    pthread_mutex_destroy(&table->writeLock);
+    free(table);
+    session->table = own;
+}
+
+/* makes the current session work on the shared table*/
+void attachTable(struct table *table){
+    session->table = table;
+    lockTable();
+    if (table->readerCount == table->readerCapacity){
+        table->readerCapacity = table->readerCapacity == 0 ? 64 : table->readerCapacity * 2;
+        table->readers = (struct session **)realloc(table->readers, table->readerCapacity * sizeof(struct session *));
+        if (table->readers == NULL){
+            fprintf(stderr, "Error: could not allocate memory for the shared symbol-table!\n");
+            exit(1);
+        }
+    }
+    table->readers[table->readerCount++] = session;
+    unlockTable();
+}
+
+/* takes the current session off the shared table, back to its own (empty) one*/
+void detachTable(){
+    struct table *table = session->table;
+    lockTable();
+    for (int i = 0; i < table->readerCount; i++){
+        if (table->readers[i] == session){
+            table->readers[i] = table->readers[--table->readerCount];
+            break;
+        }
+    }
+    unlockTable();
+    session->readEpoch = 0;
+    session->table = &session->ownTable;
+}
+
+// the write lock, taken by assignments and by the lookups adding to the table; nothing to take on a table of one session
+void lockTable(){
+    if (session->table->shared){
+        pthread_mutex_lock(&session->table->writeLock);
+        session->tableLocked = true;
+    }
+}
+
+// releases the write lock, also after an unrecoverable error stopped the writer holding it (see sessionExit())
+void unlockTable(){
+    if (session->tableLocked){
+        session->tableLocked = false;
+        pthread_mutex_unlock(&session->table->writeLock);
+    }
+}
+
+/* announces the current epoch, before reading the table. The announcement has to be visible to the writers
+ * before anything is read, hence the full fence*/
+void beginReading(){
+    if (session->table->shared){
+        __atomic_store_n(&session->readEpoch, loadShared(session->table->epoch), __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+// nothing read from the table is held any longer, so what has been retired can be freed without waiting for the session
+void endReading(){
+    if (session->table->shared){
+        publish(session->readEpoch, 0);
+    }
+}
+
+/* changes to the pointers of the indexes (or of the slot table) are made between these two, by a writer holding the lock*/
+void beginTableChange(){
+    struct table *table = session->table;
+    __atomic_store_n(&table->version, table->version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void endTableChange(){
+    publish(session->table->version, session->table->version + 1);
+}
+
+/* version of the table before reading the pointers of its indexes, which are consistent if tableChanged() is false after*/
+unsigned int readTableVersion(){
+    unsigned int version;
+    while ((version = loadShared(session->table->version)) & 1){
+        // a writer is replacing the pointers, which takes a few stores
+    }
+    return version;
+}
+
+bool tableChanged(unsigned int version){
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&session->table->version, __ATOMIC_RELAXED) != version;
+}
+
+// releases a string or a big integer replaced by a writer, once no reader can be using it any longer
+void retireValue(struct variable value){
+    retire(value, NULL);
+}
+
+// releases a block of memory replaced by a writer (an index that has grown), once no reader can be using it any longer
+void retireMemory(void *memory){
+    if (memory != NULL){
+        retire(undefinedValue(), memory);
+    }
+}
+
+/* frees the value or the memory right away on a table of one session, otherwise keeps it until the readers are past it.
+ * On a shared table, the caller holds the write lock and has already replaced what it retires*/
+void retire(struct variable value, void *memory){
+    struct table *table = session->table;
+    if (!table->shared){
+        if (valueType(value) == STRING_TYPE){
+            freeString(&value);
+        } else if (isBigInteger(value)){
+            freeBigInteger(&value);
+        }
+        free(memory);
+        return;
+    }
+    if (table->retiredCount == table->retiredCapacity){
+        table->retiredCapacity = table->retiredCapacity == 0 ? RECLAIM_BATCH * 2 : table->retiredCapacity * 2;
+        table->retired = (struct retired_memory *)realloc(table->retired, table->retiredCapacity * sizeof(struct retired_memory));
+        countAllocation(table->retiredCapacity * sizeof(struct retired_memory));
+        if (table->retired == NULL){
+            printError("Error: could not allocate memory for the shared symbol-table!\n");
+            sessionExit(1);
+        }
+    }
+    struct retired_memory *retired = &table->retired[table->retiredCount++];
+    retired->value = value;
+    retired->memory = memory;
+    retired->epoch = table->epoch;
+    publish(table->epoch, table->epoch + 1);
+    if (table->retiredCount >= RECLAIM_BATCH + table->readerCount){
+        reclaimRetired(false);
+    }
+}
+
+/* frees what was retired before the oldest epoch announced by the sessions running statements (or everything),
+ * by a writer holding the lock or once the table is no longer used*/
+void reclaimRetired(bool everything){
+    struct table *table = session->table;
+    uint64_t oldest = UINT64_MAX;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (int i = 0; i < table->readerCount && !everything; i++){
+        uint64_t epoch = loadShared(table->readers[i]->readEpoch);
+        if (epoch != 0 && epoch < oldest){
+            oldest = epoch;
+        }
+    }
+    int kept = 0;
+    for (int i = 0; i < table->retiredCount; i++){
+        struct retired_memory *retired = &table->retired[i];
+        if (everything || retired->epoch < oldest){
+            if (valueType(retired->value) == STRING_TYPE){
+                freeString(&retired->value);
+            } else if (isBigInteger(retired->value)){
+                freeBigInteger(&retired->value);
+            }
+            free(retired->memory);
+        } else {
+            table->retired[kept++] = *retired;
+        }
+    }
+    table->retiredCount = kept;
+}
+
+#endif
@@ -0,0 +1,419 @@
+#ifndef SNAPSHOT_UTILS_H
+#define SNAPSHOT_UTILS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "output-utils.h"
+#include "variable-utils.h"
+#include "integer-utils.h"
+#include "intern-utils.h"
+#include "symboltable-utils.h"
+#include "binding-utils.h"
+#include "shared-utils.h"
+
+/* SNAPSHOTS: save "file" writes the variables of the symbol-table to a binary file and load "file" brings them back,
+ * so that a session can start from the state a long set-up script has built instead of running the script again.
+ * The file is a header, one record per node (in insertion order), then the identifiers and the blocks of the strings
+ * and big integers the values point to, every part padded to 8 bytes:
+ * - the header holds a magic number, the version of the format, the layout of the headers of strings and big integers
+ *   the blocks were written with, the size of what follows and a checksum of it
+ * - a record holds the flags of a node, the offset of its identifier and its value, where the address of a string
+ *   or of a big integer is replaced by its offset in the file
+ * - the blocks are laid out as strings and big integers are in memory (see variable-utils.h and integer-utils.h),
+ *   marked as not owned, so that the values of the nodes can point straight into the file
+ * Loading maps the file instead of reading it: no string or big integer is parsed or copied. The checksum and the
+ * records are still checked first, which reads the whole file, so a load takes time in proportion to its size.
+ * The mapping is private and kept until the table is released, since what a variable does not own is never freed,
+ * nor written in place, and may have been shared with other variables or memo caches since: every load of a file
+ * holding strings or big integers adds a mapping of its size, which a long-lived table (--shared) keeps even once
+ * no variable points into it any more.
+ * Identifiers still go through the pool and the hash index (see intern-utils.h), one lookup per variable.
+ * Bound variables are saved with the value of their formula, and functions are not saved.*/
+const char SNAPSHOT_MAGIC[8] = {'C', 'A', 'L', 'C', 'S', 'N', 'A', 'P'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct snapshot_header{
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;        // see snapshotLayout(), files written by a build laying blocks out differently are refused
+    uint64_t nodeCount;
+    uint64_t dataSize;      // bytes after the header
+    uint64_t checksum;      // of the bytes after the header
+};
+
+struct snapshot_record{
+    uint64_t value;         // bits of the value, with an offset in the file as payload for strings and big integers
+    uint64_t id;            // offset of the identifier, null-terminated
+    uint32_t idLength;
+    uint8_t type_declared;
+    uint8_t initialised;
+    uint16_t unused;
+};
+
+/* files mapped by load, which the values of the table may point into (see session-utils.h)*/
+struct snapshot_map{
+    void *address;
+    size_t size;
+    struct snapshot_map *next;
+};
+
+/*Snapshot function prototypes*/
+void saveSnapshot(const char *path);
+bool loadSnapshot(const char *path);
+unsigned char *buildSnapshot(size_t *size);
+bool replaceFile(const char *path, const unsigned char *data, size_t size);
+bool syncDirectory(const char *path);
+symbol_table *restoreNode(const char *id, size_t idLength, struct variable value, bool type_declared, bool initialised);
+bool checkSnapshot(const unsigned char *file, size_t size, const char *path);
+bool checkRecord(const struct snapshot_record *record, const unsigned char *file, size_t size, size_t dataStart);
+size_t snapshotBlockSize(struct variable value);
+size_t snapshotPadding(size_t size);
+uint32_t snapshotLayout();
+uint64_t snapshotChecksum(const unsigned char *data, size_t size);
+void releaseSnapshots();
+void journalNode(symbol_table *node);       // defined in journal-utils.h
+
+/* writes every node of the table to the file at path. On a shared table, writers wait until it has been copied*/
+void saveSnapshot(const char *path){
+    size_t size;
+    lockTable();
+    unsigned char *file = buildSnapshot(&size);
+    unlockTable();
+    if (file == NULL){
+        printError("Error: could not allocate memory for the snapshot!\n");
+        return;
+    }
+    if (replaceFile(path, file, size)){
+        printInfo("Info: Saved %llu variable(s) to %s\n", (unsigned long long)((struct snapshot_header *)file)->nodeCount, path);
+    } else {
+        outPrintf("Error: could not write the snapshot %s: %s\n", path, strerror(errno));
+    }
+    free(file);
+}
+
+/* returns the snapshot of every node of the table, or NULL if there is not enough memory for it.
+ * A writer must not change the table meanwhile, the caller holds the write lock of a shared table*/
+unsigned char *buildSnapshot(size_t *snapshotSize){
+    struct table *table = session->table;
+    size_t count = table->numberOfNodes;
+    size_t dataStart = sizeof(struct snapshot_header) + count * sizeof(struct snapshot_record);
+    size_t size = dataStart;
+    for (size_t slot = 0; slot < count; slot++){
+        symbol_table *node = table->slotTable[slot];
+        size += snapshotPadding(internedLength(node->id) + 1) + snapshotBlockSize(node->value);
+    }
+    unsigned char *file = (unsigned char *)calloc(1, size);    // zeroed, so that the padding is the same every time
+    if (file == NULL){
+        return NULL;
+    }
+
+    struct snapshot_header *header = (struct snapshot_header *)file;
+    struct snapshot_record *records = (struct snapshot_record *)(file + sizeof(struct snapshot_header));
+    size_t offset = dataStart;
+    for (size_t slot = 0; slot < count; slot++){
+        symbol_table *node = table->slotTable[slot];
+        struct snapshot_record *record = &records[slot];
+        size_t idLength = internedLength(node->id);
+        memcpy(file + offset, node->id, idLength + 1);
+        record->id = offset;
+        record->idLength = (uint32_t)idLength;
+        record->type_declared = node->type_declared;
+        record->initialised = node->initialised;
+        offset += snapshotPadding(idLength + 1);
+
+        struct variable value = node->value;
+        if (valueTag(value) == TAG_STRING || valueTag(value) == TAG_SHARED_STRING){
+            struct string_header *block = (struct string_header *)(file + offset);
+            block->length = block->capacity = stringLength(&value);
+            block->owned = false;
+            memcpy(block->chars, stringChars(&value), block->length + 1);
+            record->value = boxValue(TAG_SHARED_STRING, offset + offsetof(struct string_header, chars)).bits;
+        } else if (isBigInteger(value)){
+            struct big_integer *source = bigHeader(value);
+            struct big_integer *block = (struct big_integer *)(file + offset);
+            block->owned = false;
+            block->negative = source->negative;
+            block->length = source->length;
+            memcpy(block->limbs, source->limbs, source->length * sizeof(uint32_t));
+            record->value = boxValue(TAG_BIG_INTEGER, offset).bits;
+        } else {
+            record->value = value.bits;
+        }
+        offset += snapshotBlockSize(value);
+    }
+
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header->version = SNAPSHOT_VERSION;
+    header->layout = snapshotLayout();
+    header->nodeCount = count;
+    header->dataSize = size - sizeof(struct snapshot_header);
+    header->checksum = snapshotChecksum(file + sizeof(struct snapshot_header), header->dataSize);
+    *snapshotSize = size;
+    return file;
+}
+
+/* writes the data to a temporary file next to path and renames it to path once it is on disk, so that the file
+ * at path is never left half written, even by a crash. Returns false (with errno set) if it could not.
+ * It reports nothing, since the journal calls it from a thread of its own (see journal-utils.h)*/
+bool replaceFile(const char *path, const unsigned char *data, size_t size){
+    size_t length = strlen(path);
+    char *temporary = (char *)malloc(length + 5);
+    if (temporary == NULL){
+        errno = ENOMEM;
+        return false;
+    }
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, ".tmp", 5);
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool written = fd >= 0;
+    for (size_t done = 0; written && done < size; ){
+        ssize_t count = write(fd, data + done, size - done);
+        written = count > 0 || (count < 0 && errno == EINTR);
+        done += count > 0 ? (size_t)count : 0;
+    }
+    written = written && fsync(fd) == 0;
+    if (fd >= 0){
+        written = close(fd) == 0 && written;
+    }
+    written = written && rename(temporary, path) == 0 && syncDirectory(path);
+    if (!written){
+        int error = errno;
+        unlink(temporary);
+        errno = error;
+    }
+    free(temporary);
+    return written;
+}
+
+// flushes the directory holding path, so that a file created or renamed in it survives a crash
+bool syncDirectory(const char *path){
+    const char *slash = strrchr(path, '/');
+    char *directory = slash == NULL ? strdup(".") : strndup(path, slash == path ? 1 : (size_t)(slash - path));
+    if (directory == NULL){
+        errno = ENOMEM;
+        return false;
+    }
+    int fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(directory);
+    bool synced = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0){
+        close(fd);
+    }
+    return synced;
+}
+
+/* maps the file at path and sets the variables it holds, adding those the table does not have yet.
+ * The variables keep the types they were saved with, and lose the formula they were bound to.
+ * Returns false, leaving the table as it was, if the file could not be loaded*/
+bool loadSnapshot(const char *path){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0){
+        outPrintf("Error: could not open the snapshot %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(struct snapshot_header)){
+        close(fd);
+        outPrintf("Error: %s is not a snapshot!\n", path);
+        return false;
+    }
+    size_t size = (size_t)status.st_size;
+    //writable but private: a page is only copied if something writes to it, and the file is never changed
+    unsigned char *file = (unsigned char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED){
+        outPrintf("Error: could not map the snapshot %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    if (!checkSnapshot(file, size, path)){
+        munmap(file, size);
+        return false;
+    }
+
+    uint64_t count = ((const struct snapshot_header *)file)->nodeCount;
+    const struct snapshot_record *records = (const struct snapshot_record *)(file + sizeof(struct snapshot_header));
+    bool mapped = false;    // whether a value points into the file
+    uint64_t loaded = 0;
+    lockTable();
+    for (uint64_t i = 0; i < count; i++){
+        const struct snapshot_record *record = &records[i];
+        struct variable value = {record->value};
+        if (valueTag(value) == TAG_SHARED_STRING || valueTag(value) == TAG_BIG_INTEGER){
+            value = boxValue(valueTag(value), (uint64_t)(uintptr_t)(file + (value.bits & PAYLOAD_MASK)));
+            mapped = true;
+        }
+        if (restoreNode((const char *)file + record->id, record->idLength, value, record->type_declared,
+                        record->initialised) != NULL){
+            loaded++;
+        }
+    }
+    if (mapped){
+        struct snapshot_map *map = (struct snapshot_map *)malloc(sizeof(struct snapshot_map));
+        countAllocation(sizeof(struct snapshot_map));
+        if (map == NULL){
+            unlockTable();
+            printError("Error: could not allocate memory for the snapshot!\n");
+            sessionExit(1);
+        }
+        map->address = file;
+        map->size = size;
+        map->next = session->table->snapshots;
+        session->table->snapshots = map;
+    } else {
+        munmap(file, size);
+    }
+    unlockTable();
+    printInfo("Info: Loaded %llu variable(s) from %s\n", (unsigned long long)loaded, path);
+    return true;
+}
+
+/* sets the node of the given identifier (adding it if the table does not have it yet) to the value and the flags
+ * it had when it was saved, releasing the value it held. The node takes the value as it is, without copying it.
+ * A variable whose type has been declared keeps it, since compiled and folded code relies on it (see staticType()):
+ * a value of another type is reported and not set, and NULL is returned.
+ * The caller holds the write lock of a shared table*/
+symbol_table *restoreNode(const char *id, size_t idLength, struct variable value, bool type_declared, bool initialised){
+    unsigned int hash = hashChars(id, idLength);
+    char *handle = findInterned(id, idLength, hash);
+    if (handle == NULL){
+        handle = addInterned(id, idLength, hash);
+    }
+    symbol_table *node = findNode(handle, hash);
+    if (node == NULL){
+        node = addNode(handle, hash);
+    }
+    if (node->type_declared && (!type_declared || valueType(node->value) != valueType(value))){
+        outPrintf("Error: %s is already defined with type %s, the value saved was not loaded!\n", node->id,
+                  varType(node->value));
+        return NULL;
+    }
+    if (node->binding != NULL){
+        printInfo("Info: %s is no longer bound to its formula\n", node->id);
+        unbind(node);
+    }
+
+    struct variable old = node->value;
+    bool held = node->initialised;
+    beginUpdate(node);
+    setValue(node, value);
+    node->type_declared = type_declared;
+    node->initialised = initialised;
+    endUpdate(node);
+    if (held && (valueType(old) == STRING_TYPE || isBigInteger(old))){
+        retireValue(old);
+    }
+    invalidate(node);
+    journalNode(node);
+    return node;
+}
+
+/* checks the header, the checksum and every record of a mapped snapshot, reporting the first problem found.
+ * Once it returns true, every offset of the file points to something complete inside it*/
+bool checkSnapshot(const unsigned char *file, size_t size, const char *path){
+    const struct snapshot_header *header = (const struct snapshot_header *)file;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0){
+        outPrintf("Error: %s is not a snapshot!\n", path);
+        return false;
+    }
+    if (header->version != SNAPSHOT_VERSION || header->layout != snapshotLayout()){
+        outPrintf("Error: the snapshot %s was written by another version of the calculator!\n", path);
+        return false;
+    }
+    if (header->dataSize != size - sizeof(struct snapshot_header) || header->dataSize % 8 != 0
+        || header->nodeCount > header->dataSize / sizeof(struct snapshot_record)
+        || header->checksum != snapshotChecksum(file + sizeof(struct snapshot_header), header->dataSize)){
+        outPrintf("Error: the snapshot %s is corrupted!\n", path);
+        return false;
+    }
+    const struct snapshot_record *records = (const struct snapshot_record *)(file + sizeof(struct snapshot_header));
+    size_t dataStart = sizeof(struct snapshot_header) + header->nodeCount * sizeof(struct snapshot_record);
+    for (uint64_t i = 0; i < header->nodeCount; i++){
+        if (!checkRecord(&records[i], file, size, dataStart)){
+            outPrintf("Error: the snapshot %s is corrupted!\n", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* whether the identifier and the block of a record lie after the records and inside the file*/
+bool checkRecord(const struct snapshot_record *record, const unsigned char *file, size_t size, size_t dataStart){
+    if (record->id < dataStart || record->id >= size || record->idLength == 0 || record->idLength >= size - record->id
+        || file[record->id + record->idLength] != '\0' || record->type_declared > 1 || record->initialised > 1){
+        return false;
+    }
+    struct variable value = {record->value};
+    uint64_t tag = valueTag(value);
+    uint64_t offset = value.bits & PAYLOAD_MASK;
+    if (tag == TAG_SHORT_STRING || tag == TAG_SHARED_SHORT_STRING){
+        return memchr(&value.bits, '\0', SHORT_STRING_CAPACITY) != NULL;
+    } else if (tag == TAG_STRING){
+        return false;       // strings are always saved as shared, see saveSnapshot()
+    } else if (tag == TAG_SHARED_STRING){
+        //the value points to the characters, which follow the header of the block
+        size_t start = offset - offsetof(struct string_header, chars);
+        const struct string_header *block = (const struct string_header *)(file + start);
+        return offset >= dataStart + offsetof(struct string_header, chars) && start % 8 == 0
+               && start + sizeof(struct string_header) <= size && block->length < size - offset
+               && block->capacity == block->length && !block->owned && block->chars[block->length] == '\0';
+    } else if (tag == TAG_BIG_INTEGER){
+        const struct big_integer *block = (const struct big_integer *)(file + offset);
+        return offset >= dataStart && offset % 8 == 0 && offset + sizeof(struct big_integer) <= size
+               && block->length > 0 && (size_t)block->length <= (size - offset - sizeof(struct big_integer)) / sizeof(uint32_t)
+               && !block->owned;
+    }
+    return true;
+}
+
+/* bytes taken in the file by the block of a value, 0 for values held in the value itself*/
+size_t snapshotBlockSize(struct variable value){
+    if (valueTag(value) == TAG_STRING || valueTag(value) == TAG_SHARED_STRING){
+        return snapshotPadding(sizeof(struct string_header) + stringLength(&value) + 1);
+    } else if (isBigInteger(value)){
+        return snapshotPadding(sizeof(struct big_integer) + bigHeader(value)->length * sizeof(uint32_t));
+    }
+    return 0;
+}
+
+// rounds a size up to a multiple of 8 bytes, so that every block starts aligned
+size_t snapshotPadding(size_t size){
+    return (size + 7) & ~(size_t)7;
+}
+
+// sizes of the headers of strings and big integers, which a snapshot has to share with the build reading it
+uint32_t snapshotLayout(){
+    return (uint32_t)(offsetof(struct string_header, chars) << 16 | sizeof(struct big_integer));
+}
+
+/* FNV-1a over 64-bit words (the data is padded to whole words): changing any single word always changes the result*/
+uint64_t snapshotChecksum(const unsigned char *data, size_t size){
+    uint64_t checksum = 0xcbf29ce484222325;
+    for (size_t i = 0; i + 8 <= size; i += 8){
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        checksum = (checksum ^ word) * 0x100000001b3;
+    }
+    return checksum;
+}
+
+/* unmaps the snapshots loaded into the current table, once its values are released*/
+void releaseSnapshots(){
+    struct table *table = session->table;
+    while (table->snapshots != NULL){
+        struct snapshot_map *map = table->snapshots;
+        table->snapshots = map->next;
+        munmap(map->address, map->size);
+        free(map);
+    }
+}
+
+#endif
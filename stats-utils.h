@@ -0,0 +1,270 @@
+#ifndef STATS_UTILS_H
+#define STATS_UTILS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* RUNTIME STATISTICS: every session counts what it does (tokens, statements, symbol-table probes,
+ * allocations, arithmetic operations) and how long statements take, in plain counters of its own,
+ * so that recording never needs a lock and costs an increment or two.
+ * Only the time spent in the scanner is sampled (one token every STATS_LEX_SAMPLE), since reading the clock
+ * costs about as much as scanning a token; the time of every statement is measured instead.
+ * The `stats` statement prints the statistics of the current session; when a session ends its statistics
+ * are added to those of the whole process, which can be written out as JSON at exit (--stats-json).*/
+#define STATS_LEX_SAMPLE 64
+#define STATS_KINDS 32              // room for every statement kind (see enum ast_kind in ast-utils.h)
+#define STATS_OPERATORS 4           // ADD_OP, SUB_OP, MUL_OP, DIV_OP
+#define STATS_TYPES 4               // UNDEFINED_TYPE, INTEGER_TYPE, DOUBLE_TYPE, STRING_TYPE
+
+/* LATENCY HISTOGRAMS: durations in nanoseconds are counted in buckets that are exact up to 8ns,
+ * then split every power of two in 4, so a percentile read from the histogram is within 25% of the real one*/
+#define HISTOGRAM_BUCKETS 160
+
+struct histogram{
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+struct stats{
+    //scanner and parser
+    uint64_t tokens;
+    uint64_t lexSamples;            // tokens whose scanning was timed
+    uint64_t lexSampleNs;
+    uint64_t statements;
+    uint64_t parseNs;               // from the first token of each statement to the moment it runs
+    uint64_t evaluationNs;          // folding, compiling and running the statements
+    uint64_t statementStart;        // when the first token of the current statement was read, 0 if it was not yet
+
+    //symbol-table
+    uint64_t lookups;
+    uint64_t probes;                // slots of the hash index examined
+    uint64_t hits;
+    uint64_t misses;
+
+    //memory
+    uint64_t heapAllocations;       // calls to malloc, calloc and realloc
+    uint64_t heapBytes;
+    uint64_t arenaAllocations;
+    uint64_t arenaBytes;
+
+    //user-defined functions
+    uint64_t calls;
+    uint64_t memoHits;
+    uint64_t memoMisses;
+
+    //reactive bindings
+    uint64_t invalidations;         // bound nodes marked as dirty
+    uint64_t recomputations;        // formulas run again
+
+    //machine code (see jit-utils.h)
+    uint64_t jitFragments;          // expressions compiled
+    uint64_t jitRuns;               // runs of their machine code
+    uint64_t jitFallbacks;          // runs left to the bytecode by a failed guard
+
+    //arithmetic, by operator and types of the operands
+    uint64_t operations[STATS_OPERATORS][STATS_TYPES][STATS_TYPES];
+
+    struct histogram latency[STATS_KINDS];  // evaluation time by statement kind
+};
+
+/*statistics of the sessions that have ended, in the whole process*/
+struct stats processStats;
+pthread_mutex_t processStatsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*Recording, called where the events happen (session is the current session, see session-utils.h)*/
+#define countAllocation(bytes) (session->stats.heapAllocations++, session->stats.heapBytes += (bytes))
+#define countArenaAllocation(bytes) (session->stats.arenaAllocations++, session->stats.arenaBytes += (bytes))
+#define countOperation(op, n1, n2) (session->stats.operations[(int)(op)][(int)valueType(n1)][(int)valueType(n2)]++)
+
+/*Statistics function prototypes*/
+uint64_t statsClock();
+void recordLatency(struct histogram *histogram, uint64_t ns);
+int histogramBucket(uint64_t ns);
+uint64_t bucketValue(int bucket);
+uint64_t percentile(const struct histogram *histogram, uint64_t perMille);
+void mergeStats(struct stats *into, const struct stats *from);
+void publishStats(const struct stats *stats);
+void printStats(const struct stats *stats);
+bool writeStatsJson(const char *path);
+const char *statementName(int kind);    // defined in ast-utils.h
+void outPrintf(const char *format, ...); // defined in output-utils.h
+
+// monotonic time in nanoseconds
+uint64_t statsClock(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+void recordLatency(struct histogram *histogram, uint64_t ns){
+    histogram->count++;
+    histogram->totalNs += ns;
+    histogram->buckets[histogramBucket(ns)]++;
+}
+
+int histogramBucket(uint64_t ns){
+    if (ns < 8){
+        return (int)ns;
+    }
+    int exponent = 63 - __builtin_clzll(ns);    // ns is in [2^exponent, 2^(exponent + 1))
+    int bucket = 8 + (exponent - 3) * 4 + (int)((ns >> (exponent - 2)) & 3);
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+// middle of the range of durations counted by a bucket
+uint64_t bucketValue(int bucket){
+    if (bucket < 8){
+        return bucket;
+    }
+    int exponent = (bucket - 8) / 4 + 3;
+    uint64_t width = (uint64_t)1 << (exponent - 2);
+    return (4 + (bucket - 8) % 4) * width + width / 2;
+}
+
+// duration below which the given per mille of the recorded durations falls
+uint64_t percentile(const struct histogram *histogram, uint64_t perMille){
+    if (histogram->count == 0){
+        return 0;
+    }
+    uint64_t rank = (histogram->count * perMille + 999) / 1000;     // nearest rank, rounded up
+    if (rank == 0){
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++){
+        seen += histogram->buckets[bucket];
+        if (seen >= rank){
+            return bucketValue(bucket);
+        }
+    }
+    return bucketValue(HISTOGRAM_BUCKETS - 1);
+}
+
+// adds every counter of from to into
+void mergeStats(struct stats *into, const struct stats *from){
+    //all the fields of the structure are counters, apart from statementStart which is not used in the totals
+    uint64_t *target = (uint64_t *)into;
+    const uint64_t *source = (const uint64_t *)from;
+    for (size_t i = 0; i < sizeof(struct stats) / sizeof(uint64_t); i++){
+        target[i] += source[i];
+    }
+}
+
+// adds the statistics of a session to those of the process, when the session ends
+void publishStats(const struct stats *stats){
+    pthread_mutex_lock(&processStatsLock);
+    mergeStats(&processStats, stats);
+    pthread_mutex_unlock(&processStatsLock);
+}
+
+/* prints the statistics in readable form (the `stats` statement)*/
+void printStats(const struct stats *stats){
+    static const char *operatorNames[] = {"sumOrConcat", "sub", "multi", "divide"};
+    outPrintf("Statements: %llu (parsing %.3f ms, evaluation %.3f ms)\n", (unsigned long long)stats->statements,
+              stats->parseNs / 1e6, stats->evaluationNs / 1e6);
+    outPrintf("Tokens: %llu (scanning about %.3f ms)\n", (unsigned long long)stats->tokens,
+              stats->lexSamples == 0 ? 0.0 : (double)stats->lexSampleNs / stats->lexSamples * stats->tokens / 1e6);
+    outPrintf("Symbol-table lookups: %llu (%llu probes, %llu hits, %llu misses)\n",
+              (unsigned long long)stats->lookups, (unsigned long long)stats->probes,
+              (unsigned long long)stats->hits, (unsigned long long)stats->misses);
+    outPrintf("Allocations: %llu on the heap (%llu bytes), %llu in the arena (%llu bytes)\n",
+              (unsigned long long)stats->heapAllocations, (unsigned long long)stats->heapBytes,
+              (unsigned long long)stats->arenaAllocations, (unsigned long long)stats->arenaBytes);
+    outPrintf("Function calls: %llu (memo cache %llu hits, %llu misses)\n", (unsigned long long)stats->calls,
+              (unsigned long long)stats->memoHits, (unsigned long long)stats->memoMisses);
+    outPrintf("Bindings: %llu invalidated, %llu recomputed\n", (unsigned long long)stats->invalidations,
+              (unsigned long long)stats->recomputations);
+    if (stats->jitFragments > 0){
+        outPrintf("JIT: %llu expressions compiled, %llu native runs, %llu fallbacks to the bytecode\n",
+                  (unsigned long long)stats->jitFragments, (unsigned long long)stats->jitRuns,
+                  (unsigned long long)stats->jitFallbacks);
+    }
+    outPrintf("Operations:");
+    for (int op = 0; op < STATS_OPERATORS; op++){
+        uint64_t calls = 0;
+        for (int left = 0; left < STATS_TYPES; left++){
+            for (int right = 0; right < STATS_TYPES; right++){
+                calls += stats->operations[op][left][right];
+            }
+        }
+        outPrintf(" %s %llu", operatorNames[op], (unsigned long long)calls);
+    }
+    outPrintf("\n");
+    for (int kind = 0; kind < STATS_KINDS; kind++){
+        const struct histogram *latency = &stats->latency[kind];
+        if (latency->count > 0){
+            outPrintf("Latency of %s: %llu statements, p50 %llu ns, p99 %llu ns\n", statementName(kind),
+                      (unsigned long long)latency->count, (unsigned long long)percentile(latency, 500),
+                      (unsigned long long)percentile(latency, 990));
+        }
+    }
+}
+
+/* writes the statistics of the whole process to the given file as JSON, returning false if it could not*/
+bool writeStatsJson(const char *path){
+    static const char *operatorNames[] = {"sumOrConcat", "sub", "multi", "divide"};
+    static const char *typeNames[] = {"undefined", "int", "double", "string"};
+    FILE *file = fopen(path, "w");
+    if (file == NULL){
+        return false;
+    }
+    pthread_mutex_lock(&processStatsLock);
+    const struct stats *stats = &processStats;
+    fprintf(file, "{\n");
+    fprintf(file, "  \"statements\": %llu,\n", (unsigned long long)stats->statements);
+    fprintf(file, "  \"parse_ns\": %llu,\n", (unsigned long long)stats->parseNs);
+    fprintf(file, "  \"evaluation_ns\": %llu,\n", (unsigned long long)stats->evaluationNs);
+    fprintf(file, "  \"lex\": {\"tokens\": %llu, \"sampled_tokens\": %llu, \"sampled_ns\": %llu},\n",
+            (unsigned long long)stats->tokens, (unsigned long long)stats->lexSamples, (unsigned long long)stats->lexSampleNs);
+    fprintf(file, "  \"find_or_add\": {\"lookups\": %llu, \"probes\": %llu, \"hits\": %llu, \"misses\": %llu},\n",
+            (unsigned long long)stats->lookups, (unsigned long long)stats->probes,
+            (unsigned long long)stats->hits, (unsigned long long)stats->misses);
+    fprintf(file, "  \"allocations\": {\"heap\": %llu, \"heap_bytes\": %llu, \"arena\": %llu, \"arena_bytes\": %llu},\n",
+            (unsigned long long)stats->heapAllocations, (unsigned long long)stats->heapBytes,
+            (unsigned long long)stats->arenaAllocations, (unsigned long long)stats->arenaBytes);
+    fprintf(file, "  \"functions\": {\"calls\": %llu, \"memo_hits\": %llu, \"memo_misses\": %llu},\n",
+            (unsigned long long)stats->calls, (unsigned long long)stats->memoHits, (unsigned long long)stats->memoMisses);
+    fprintf(file, "  \"bindings\": {\"invalidations\": %llu, \"recomputations\": %llu},\n",
+            (unsigned long long)stats->invalidations, (unsigned long long)stats->recomputations);
+    fprintf(file, "  \"jit\": {\"fragments\": %llu, \"native_runs\": %llu, \"fallbacks\": %llu},\n",
+            (unsigned long long)stats->jitFragments, (unsigned long long)stats->jitRuns,
+            (unsigned long long)stats->jitFallbacks);
+    fprintf(file, "  \"operations\": {");
+    for (int op = 0; op < STATS_OPERATORS; op++){
+        fprintf(file, "%s\n    \"%s\": {", op > 0 ? "," : "", operatorNames[op]);
+        bool first = true;
+        for (int left = 0; left < STATS_TYPES; left++){
+            for (int right = 0; right < STATS_TYPES; right++){
+                if (stats->operations[op][left][right] > 0){
+                    fprintf(file, "%s\"%s,%s\": %llu", first ? "" : ", ", typeNames[left], typeNames[right],
+                            (unsigned long long)stats->operations[op][left][right]);
+                    first = false;
+                }
+            }
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n  },\n  \"latency\": {");
+    bool first = true;
+    for (int kind = 0; kind < STATS_KINDS; kind++){
+        const struct histogram *latency = &stats->latency[kind];
+        if (latency->count > 0){
+            fprintf(file, "%s\n    \"%s\": {\"count\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu}",
+                    first ? "" : ",", statementName(kind), (unsigned long long)latency->count,
+                    (unsigned long long)(latency->totalNs / latency->count),
+                    (unsigned long long)percentile(latency, 500), (unsigned long long)percentile(latency, 990));
+            first = false;
+        }
+    }
+    fprintf(file, "\n  }\n}\n");
+    pthread_mutex_unlock(&processStatsLock);
+    fclose(file);
+    return true;
+}
+
+#endif
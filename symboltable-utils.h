@@ -1,123 +1,331 @@
+#ifndef SYMBOLTABLE_UTILS_H
+#define SYMBOLTABLE_UTILS_H
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "output-utils.h"
+#include "intern-utils.h"
+#include "variable-utils.h"
+#include "integer-utils.h"
+#include "shared-utils.h"
 
 
-/*main structure for variable handling: a unique object that can have one of three values*/
-struct variable{
-    union{
-        int integer_val;
-        double double_val;
-        char *string_val;
-
-    };
-    char fromID;
-    char type;
-};
-
-/* SYMBOL-TABLE IMPLEMENTATION: The table is implemented as a linked list of nodes,
- * each node holds a pointer to the next one, as well as the actual variable values.
+/* SYMBOL-TABLE IMPLEMENTATION: The nodes of the table are still chained as a linked list,
+ * each node holds a pointer to the next one in insertion order (which is the order used when printing
+ * the whole table), as well as the actual variable values.
  * It also holds two boolean variables in order to check whether the variable wrapped
  * in the node is initialised or not without risking of incurring into errors when evaluating
- * uninitialised variables.*/
+ * uninitialised variables.
+ * Lookups do not walk the list, they go through the hash index defined below.
+ * Nodes bound to a formula, and those formulas read, also belong to the dependency graph (see binding-utils.h).
+ * The table may be shared by the connections of a server (see shared-utils.h): the value and the flags of a node
+ * then change between beginUpdate() and endUpdate(), and readers take them with readNode().*/
+struct binding;
+struct node_list;
+
 struct table_node{
-    char *id;
+    char *id;              // interned handle of the identifier (see intern-utils.h)
+    unsigned int hash;     // cached hash of the id, computed once when the node is created
+    int slot;              // position of the node in insertion order, used by compiled code to address it
     bool type_declared;    // specifies whether the variable type has been declared or not
     bool initialised; // specifies whether the variable has a value defined or not
+    bool dirty;            // bound to a formula whose value has to be computed again before it is read
+    unsigned int mark;     // last walk of the dependency graph that reached the node
+    unsigned int version;  // odd while the value or the flags are being changed
     struct table_node *next;
     struct variable value;
+    struct binding *binding;        // formula the node is bound to, NULL for plain variables
+    struct node_list *dependents;   // bound nodes whose formula reads this node, NULL if there are none
 };
 
-/*Initialisation of global variables*/
+/*The table itself (head, tail and number of nodes) is the table of the current session (see session-utils.h)*/
 typedef struct table_node symbol_table;
-symbol_table *head = (symbol_table *)0;
 
-const int MAX_SIZE_SYMBOL_TABLE = 64; // max number of symbols in the symbol table
-bool table_init = false;
-int numberOfNodes = 0;
+/*fields of a node read together, as they were at the same moment*/
+struct node_state{
+    struct variable value;
+    bool type_declared;
+    bool initialised;
+};
+
+/* HASH INDEX: open-addressing table (linear probing) of pointers to the nodes.
+ * Every slot caches the hash of the node it points to, so a probe only dereferences a node
+ * when the hashes match, and growing the index never has to hash the ids again.
+ * Since ids are interned, a match is decided by comparing the handles themselves.
+ * Nodes are allocated in blocks and never moved, so a node pointer stays valid for the whole session.*/
+struct index_slot{
+    unsigned int hash;
+    symbol_table *node;   // NULL marks an empty slot
+};
+const size_t INITIAL_INDEX_CAPACITY = 64;
+const int NODE_BLOCK_SIZE = 256; // number of nodes allocated at once
 
-const char UNDEFINED_TYPE = 0;
-const char INTEGER_TYPE = 1;
-const char DOUBLE_TYPE = 2;
-const char STRING_TYPE = 3;
+/* slot table (session->table->slotTable): maps the slot index of every node to the node itself, so that compiled code
+ * can address variables by index without going through the hash index at run time*/
 
 /*Symbol-table management function prototypes*/
 symbol_table *findOrAdd(char *string);
+symbol_table *findNode(char *string, unsigned int hash);
 void setHead(symbol_table *node);
-symbol_table *addNode(char *str, symbol_table *lastNode);
+symbol_table *addNode(char *str, unsigned int hash);
+void growIndex();
+void growSlotTable();
+void beginUpdate(symbol_table *node);
+void endUpdate(symbol_table *node);
+struct node_state readNode(const symbol_table *node);
+struct variable nodeValue(const symbol_table *node);
+void setValue(symbol_table *node, struct variable value);
+void releaseSymbolTable();
 void printID(symbol_table *string);
 void printTable();
 char *varType(struct variable data);
 void recPrintTable(symbol_table *node,int nodeNo);
+void releaseBindings(symbol_table *node);  // defined in binding-utils.h
+void releaseSnapshots();                    // defined in snapshot-utils.h
 
-/* Assignment functions
- * depending on the type of assignments (i.e. the arguments passed) the compiler
- * should behave differently based on if the user is trying to declare a new
- * undefined variable or if it already defines one or more fields of it*/
-symbol_table *completeTypedAssign(char *type, char *id, struct variable expression);
-symbol_table *completeTypedShorthand(char *type, char *id, char* shorthand, struct variable expression);
-symbol_table *completeUntypedAssign(char *id, struct variable expression);
-symbol_table *completeUntypedShorthand(char *id, char *shorthand, struct variable expression);
-symbol_table *typedAssign(char *type, char *id);
+/* Assignments are resolved by assign() in assignment-utils.h, which stores strings and integers through these functions*/
+void storeString(symbol_table *node, struct variable expression);
+void storeInteger(symbol_table *node, struct variable expression);
 
-/* Comparison and equality functions */
-bool greaterNum(struct variable, struct variable);
-bool lesserNum(struct variable, struct variable);
-bool equal(struct variable n1, struct variable n2);
-bool neqNum(struct variable, struct variable);
-bool geqNum(struct variable, struct variable);
-bool leqNum(struct variable, struct variable);
 
 /*SYMBOL-TABLE IMPLEMENTATION FUNCTIONS*/
 
-/* looks for a node with the given string as ID,
- * if the symbol-table is yet to be initialised, it initialises it and returns the head,
+/* looks for a node with the given interned handle as ID,
+ * if the symbol-table is yet to be initialised, it initialises it and returns the new node,
  * if it finds a match in the table, returns that node
- * if no match is found, the table is extended with a new node which is returned*/
+ * if no match is found, the table is extended with a new node which is returned.
+ * Looking up takes no lock, extending the table takes the write lock of a shared table (see shared-utils.h)*/
 symbol_table *findOrAdd(char *string){
+    unsigned int hash = internedHash(string);
+    session->stats.lookups++;
+    symbol_table *node = findNode(string, hash);
+    if (node != NULL){
+        session->stats.hits++;
+        printInfo("Info: Found a match for node %s\n", node->id);
+        return node;
+    }
 
-    //the symbol-table is yet to be initialised
-    if (head == NULL) {
-        table_init = true;
-        printf("Initialising the symbol table\n");
-        head = (symbol_table *)malloc(sizeof(symbol_table));
-        head->id = strdup(string);
-        head->type_declared = false;
-        head->initialised = false;
-        head->next = NULL;
-        numberOfNodes++;
-        return head;
-    } else {
-        symbol_table *node = head;
-        //search the symbol table for a match
-        while (strcmp(node->id,string) != 0){
-            //the current node is the last one of the table, no match was found
-            if(node->next==NULL && numberOfNodes< MAX_SIZE_SYMBOL_TABLE){
-                printf("Info: Match not found, adding %s to the symbol table.\n",string);
-                return addNode(string,node);
-            }
-            node = node->next;
+    lockTable();
+    node = findNode(string, hash);      // another writer may have added it in the meantime
+    if (node == NULL){
+        //the symbol-table is yet to be initialised
+        if (session->table->head == NULL) {
+            session->table->table_init = true;
+            printInfo("Initialising the symbol table\n");
+        } else {
+            printInfo("Info: Match not found, adding %s to the symbol table.\n",string);
         }
-        printf("Info: Found a match for node %s\n",node->id);
-        return node;
+        session->stats.misses++;
+        node = addNode(string, hash);
+    }
+    unlockTable();
+    return node;
+}
+
+/* searches the index for the node with the given handle, stopping at the first empty slot. Returns NULL if there is none*/
+symbol_table *findNode(char *string, unsigned int hash){
+    struct table *table = session->table;
+    struct index_slot *index;
+    size_t capacity;
+    unsigned int version;
+    do {
+        version = readTableVersion();
+        index = __atomic_load_n(&table->tableIndex, __ATOMIC_RELAXED);
+        capacity = __atomic_load_n(&table->indexCapacity, __ATOMIC_RELAXED);
+    } while (tableChanged(version));
+
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+    symbol_table *node;
+    while (capacity > 0 && (node = loadShared(index[i].node)) != NULL){
+        session->stats.probes++;
+        if (node->id == string){
+            return node;
+        }
+        i = (i + 1) & mask;
     }
+    return NULL;
 }
 
-/*Appends a new node with the given string as ID to the last node, extending the table by 1*/
-symbol_table *addNode(char *str, symbol_table *lastNode){
-    symbol_table *addedNode = (symbol_table *)malloc(sizeof(symbol_table));
-    addedNode->id = strdup(str);
+/* Creates a new node with the given string as ID, appends it to the last node of the list
+ * and registers it in the hash index, growing the index first if it is getting too full.
+ * The node is complete, and in the slot table, before the list and the index lead to it*/
+symbol_table *addNode(char *str, unsigned int hash){
+    struct table *table = session->table;
+    //keep the load factor under 3/4
+    if ((size_t)(table->numberOfNodes + 1) * 4 > table->indexCapacity * 3){
+        growIndex();
+    }
+
+    if (table->nodesLeftInBlock == 0){
+        table->nodeBlock = (symbol_table *)malloc(NODE_BLOCK_SIZE * sizeof(symbol_table));
+        countAllocation(NODE_BLOCK_SIZE * sizeof(symbol_table));
+        if (table->nodeBlock == NULL){
+            printError("Error: could not allocate memory for the symbol table!\n");
+            sessionExit(1);
+        }
+        table->nodesLeftInBlock = NODE_BLOCK_SIZE;
+    }
+    symbol_table *addedNode = table->nodeBlock++;
+    table->nodesLeftInBlock--;
+
+    memset(addedNode, 0, sizeof(symbol_table));
+    addedNode->id = str;
+    addedNode->hash = hash;
     addedNode->next = NULL;
     addedNode->type_declared = false;
     addedNode->initialised=false;
-    lastNode->next = addedNode;
+    addedNode->value = undefinedValue();
+
+    if (table->numberOfNodes == table->slotCapacity){
+        growSlotTable();
+    }
+    addedNode->slot = table->numberOfNodes;
+    publish(table->slotTable[table->numberOfNodes], addedNode);
+
+    if (table->tail == NULL){
+        publish(table->head, addedNode);
+    } else {
+        publish(table->tail->next, addedNode);
+    }
+    table->tail = addedNode;
+
+    size_t mask = table->indexCapacity - 1;
+    size_t i = hash & mask;
+    while (table->tableIndex[i].node != NULL){
+        i = (i + 1) & mask;
+    }
+    table->tableIndex[i].hash = hash;
+    publish(table->tableIndex[i].node, addedNode);
 
-    numberOfNodes++;
+    publish(table->numberOfNodes, table->numberOfNodes + 1);
 
     return addedNode;
 }
 
+/* Doubles the capacity of the hash index (or creates it), re-inserting every node
+ * by means of the cached hashes. The new index replaces the old one as a whole (see shared-utils.h)*/
+void growIndex(){
+    struct table *table = session->table;
+    size_t newCapacity = table->indexCapacity == 0 ? INITIAL_INDEX_CAPACITY : table->indexCapacity * 2;
+    struct index_slot *newIndex = (struct index_slot *)calloc(newCapacity, sizeof(struct index_slot));
+    countAllocation(newCapacity * sizeof(struct index_slot));
+    if (newIndex == NULL){
+        printError("Error: could not allocate memory for the symbol table!\n");
+        sessionExit(1);
+    }
+    size_t mask = newCapacity - 1;
+    for (size_t j = 0; j < table->indexCapacity; j++){
+        if (table->tableIndex[j].node != NULL){
+            size_t i = table->tableIndex[j].hash & mask;
+            while (newIndex[i].node != NULL){
+                i = (i + 1) & mask;
+            }
+            newIndex[i] = table->tableIndex[j];
+        }
+    }
+    struct index_slot *oldIndex = table->tableIndex;
+    beginTableChange();
+    __atomic_store_n(&table->tableIndex, newIndex, __ATOMIC_RELAXED);
+    __atomic_store_n(&table->indexCapacity, newCapacity, __ATOMIC_RELAXED);
+    endTableChange();
+    retireMemory(oldIndex);
+}
+
+/* Doubles the capacity of the slot table (or creates it). Compiled code running in other sessions may still be
+ * reading the old one, which holds every node it can address*/
+void growSlotTable(){
+    struct table *table = session->table;
+    int newCapacity = table->slotCapacity == 0 ? NODE_BLOCK_SIZE : table->slotCapacity * 2;
+    symbol_table **newSlots = (symbol_table **)malloc(newCapacity * sizeof(symbol_table *));
+    countAllocation(newCapacity * sizeof(symbol_table *));
+    if (newSlots == NULL){
+        printError("Error: could not allocate memory for the symbol table!\n");
+        sessionExit(1);
+    }
+    if (table->numberOfNodes > 0){
+        memcpy(newSlots, table->slotTable, table->numberOfNodes * sizeof(symbol_table *));
+    }
+    symbol_table **oldSlots = table->slotTable;
+    publish(table->slotTable, newSlots);
+    table->slotCapacity = newCapacity;
+    retireMemory(oldSlots);
+}
+
+/* frees the nodes, their strings and the indexes, when the session ends.
+ * Nodes are allocated in blocks of NODE_BLOCK_SIZE in slot order, so every block starts
+ * with the node whose slot is a multiple of NODE_BLOCK_SIZE*/
+void releaseSymbolTable(){
+    struct table *table = session->table;
+    for (int slot = 0; slot < table->numberOfNodes; slot++){
+        symbol_table *node = table->slotTable[slot];
+        if (valueType(node->value) == STRING_TYPE){
+            freeString(&node->value);
+        } else if (isBigInteger(node->value)){
+            freeBigInteger(&node->value);
+        }
+        releaseBindings(node);
+    }
+    free(session->walk);
+    session->walk = NULL;
+    session->walkCount = session->walkCapacity = 0;
+    for (int slot = 0; slot < table->numberOfNodes; slot += NODE_BLOCK_SIZE){
+        free(table->slotTable[slot]);
+    }
+    free(table->slotTable);
+    free(table->tableIndex);
+    table->head = table->tail = NULL;
+    table->table_init = false;
+    table->numberOfNodes = 0;
+    table->tableIndex = NULL;
+    table->indexCapacity = 0;
+    table->nodeBlock = NULL;
+    table->nodesLeftInBlock = 0;
+    table->slotTable = NULL;
+    table->slotCapacity = 0;
+    releaseSnapshots();
+}
+
+/* NODE UPDATES: a writer changes the value and the flags of a node between beginUpdate() and endUpdate(),
+ * which make the version of the node odd then even again, while readNode() reads them again until the version
+ * was even and has not changed (a seqlock). Readers that only need the value load it with nodeValue(),
+ * the value being a single word, stored with setValue() once whatever it points to is complete*/
+void beginUpdate(symbol_table *node){
+    __atomic_store_n(&node->version, node->version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void endUpdate(symbol_table *node){
+    publish(node->version, node->version + 1);
+}
+
+struct node_state readNode(const symbol_table *node){
+    struct node_state state;
+    unsigned int version;
+    do {
+        while ((version = loadShared(node->version)) & 1){
+            // an assignment to the node is in progress
+        }
+        state.value.bits = loadShared(node->value.bits);
+        state.type_declared = __atomic_load_n(&node->type_declared, __ATOMIC_RELAXED);
+        state.initialised = __atomic_load_n(&node->initialised, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&node->version, __ATOMIC_RELAXED) != version);
+    return state;
+}
+
+struct variable nodeValue(const symbol_table *node){
+    struct variable value;
+    value.bits = loadShared(node->value.bits);
+    return value;
+}
+
+void setValue(symbol_table *node, struct variable value){
+    publish(node->value.bits, value.bits);
+}
+
 /* Prints the content of the specified node in a format of enhanced readability.
  * Including the actual value stored*/
 void printNode(symbol_table *nodeToPrint){
@@ -128,26 +336,31 @@ void printNode(symbol_table *nodeToPrint){
     char* init;
     char* nextNodeId; //the next node field may be empty
     char* val; //the variable value may be not initialised
+    char* label = (char *)""; //strings are printed directly, after their label, since they can be of any length
     char v[256] = {0}; //needed in order to append the actual value to the final string to be printed
+    struct node_state state = readNode(nodeToPrint); //all the fields as they were at the same moment
 
     //checking if the node has a type specified
-    if(nodeToPrint->type_declared){
+    if(state.type_declared){
         declared = (char *)"yes";
 
         //checking if the node stores a value, and appending that value accordingly
-        if(nodeToPrint->initialised){
+        if(state.initialised){
             init = (char *)"yes";
-            if(nodeToPrint->value.type==INTEGER_TYPE){
-                snprintf(v, 255,"(Integer value) %i",nodeToPrint->value.integer_val);
-                val = (char *) &v;
-            } else if(nodeToPrint->value.type==DOUBLE_TYPE){
-                snprintf(v, 255,"(Double value) %f",nodeToPrint->value.double_val);
+            if(valueType(state.value)==INTEGER_TYPE){
+                const char *digits;
+                formatIntegerValue(state.value, v, &digits);
+                label = (char *)"(Integer value) ";
+                val = (char *)digits;
+            } else if(valueType(state.value)==DOUBLE_TYPE){
+                formatDouble(v + sprintf(v, "(Double value) "), asDouble(state.value));
                 val = (char *) &v;
-            } else if(nodeToPrint->value.type==STRING_TYPE){
-                val = strcat("(String value) %s",nodeToPrint->value.string_val);
+            } else if(valueType(state.value)==STRING_TYPE){
+                label = (char *)"(String value) ";
+                val = (char *)stringChars(&state.value);
             } else {
-                printf("Error: error while trying to access the value stored in node %s\n", nodeToPrint->id);
-                exit(1);
+                printError("Error: error while trying to access the value stored in node %s\n", nodeToPrint->id);
+                sessionExit(1);
             }
         } else {
             val = (char *)"NULL";
@@ -159,44 +372,47 @@ void printNode(symbol_table *nodeToPrint){
         init = (char *)"no";
     }
 
-    if(nodeToPrint->next!= NULL){
-        nextNodeId = nodeToPrint->next->id;
+    symbol_table *next = loadShared(nodeToPrint->next);
+    if(next != NULL){
+        nextNodeId = next->id;
     } else {
         nextNodeId = (char *)"NULL";
     }
-    printf("-----------------------------------------------\n");
-    printf("Node ID: %s\n"
+    outPrintf("-----------------------------------------------\n");
+    outPrintf("Node ID: %s\n"
            "Type Declared: %s\n"
            "Value initialised: %s\n"
            "Next node: %s\n"
-           "Value: %s\n",nodeToPrint->id,declared,init,nextNodeId,val);
-    printf("-----------------------------------------------\n\n");
+           "Value: %s%s\n",nodeToPrint->id,declared,init,nextNodeId,label,val);
+    if(nodeToPrint->binding != NULL){
+        outPrintf("Bound to a formula: yes\n");
+    }
+    outPrintf("-----------------------------------------------\n\n");
 
 }
 
-/* Recursive method composed of two parts:
- * printTable()     which is in charge of starting the recursion and printing the header of the print statement
- * recPrintTable()  which is in charge of printing the node separators and print each node*/
+/* Printing of the whole table, composed of two parts:
+ * printTable()     which is in charge of printing the header of the print statement and walking the list
+ * recPrintTable()  which is in charge of printing the node separators and print each node
+ * The list is walked iteratively, so that printing a large table cannot overflow the stack*/
 void printTable(){
-    if(table_init){
+    if(loadShared(session->table->head) != NULL){
         int nodeNo = 0;
-        printf("PRINTING THE WHOLE SYMBOL_TABLE\n for single nodes use print ID\n");
-        symbol_table *ptr = head;
-        recPrintTable(ptr,nodeNo);
+        outPrintf("PRINTING THE WHOLE SYMBOL_TABLE\n for single nodes use print ID\n");
+        for(symbol_table *ptr = loadShared(session->table->head); ptr != NULL; ptr = loadShared(ptr->next)){
+            recPrintTable(ptr,nodeNo++);
+        }
     } else {
-        printf("Error: Please initialise the symbol table first by declaring one variable at least!\n");
+        outPrintf("Error: Please initialise the symbol table first by declaring one variable at least!\n");
     }
 
 }
 void recPrintTable(symbol_table *nodeToPrint, int nodeNo){
     nodeNo++;
-    printf("##########################################\n");
-    printf("Printing node number %i\n",nodeNo);
-    printf("##########################################\n");
+    outPrintf("##########################################\n");
+    outPrintf("Printing node number %i\n",nodeNo);
+    outPrintf("##########################################\n");
     printNode(nodeToPrint);
-    if(nodeNo<MAX_SIZE_SYMBOL_TABLE&&nodeToPrint->next!=NULL){
-        recPrintTable(nodeToPrint->next,nodeNo);
-    }
 }
 
 // returns type of data of the specified variable
@@ -204,7 +420,7 @@ char* varType(struct variable data){
 
     char* type;
 
-    switch(data.type) {
+    switch(valueType(data)) {
 
         case 1:
             type="int";
@@ -225,803 +441,47 @@ char* varType(struct variable data){
 
 /*Prints the result of arithmetic operations (or string concatenations) accordingly to the type*/
 void printResult(struct variable var){
-    if(var.type==STRING_TYPE){
-        printf("Result: %s\n",var.string_val);
-    } else if(var.type == INTEGER_TYPE){
-        printf("Result: %d\n",var.integer_val);
-    } else if(var.type == DOUBLE_TYPE){
-        printf("Result: %f\n",var.double_val);
-    } else if (var.type == UNDEFINED_TYPE){
-        printf("Result is uninitialised!\nUse the print ID command to print the information about a specific ID\n");
+    if(valueType(var)==STRING_TYPE){
+        outPrintf("Result: %s\n",stringChars(&var));
+    } else if(valueType(var) == INTEGER_TYPE){
+        outWrite("Result: ", 8);
+        outIntegerValue(var);
+        outWrite("\n", 1);
+    } else if(valueType(var) == DOUBLE_TYPE){
+        outWrite("Result: ", 8);
+        outDouble(asDouble(var));
+        outWrite("\n", 1);
+    } else if (valueType(var) == UNDEFINED_TYPE){
+        outPrintf("Result is uninitialised!\nUse the print ID command to print the information about a specific ID\n");
     } else {
-        printf("Error while trying to print variable of type %i!\n",var.type);
-        exit(1);
+        printError("Error while trying to print variable of type %i!\n",valueType(var));
+        sessionExit(1);
     }
 }
 
-/* Methods for handling variable initialisation, which runs differently based on the inputs provided
- * and if the declared variable already exists/contains some values*/
-symbol_table * completeTypedAssign (char* type, char* id, struct  variable expression){
-    symbol_table *node = findOrAdd(id);
-    if (node->type_declared) {//node has a type
-        if (node->initialised) {//node already stores a value
-            if (strcmp("integer", type) == 0) {
-                if (node->value.type == INTEGER_TYPE) {
-                    if (expression.type == INTEGER_TYPE) { //everything is integer, assign the value
-                        node->initialised = true;
-                        node->value.integer_val = expression.integer_val;
-                    } else if (expression.type == DOUBLE_TYPE) {
-                        node->initialised = true;
-                        node->value.integer_val = (int) expression.double_val;
-                    } else {
-                        printf("Error: could not recognise the type of the expression!\n");
-                    }
-                } else {
-                    printf("Error: the type of the node does not match the type declared!\n");
-                }
-            } else if (strcmp("double", type) == 0) {
-                if (node->value.type == DOUBLE_TYPE) {
-                    if (expression.type == DOUBLE_TYPE) {//everything is double, assign the value
-                        node->initialised = true;
-                        node->value.double_val = expression.double_val;
-                    } else if (expression.type == INTEGER_TYPE) {
-                        node->initialised = true;
-                        node->value.double_val = (double) expression.integer_val;
-                    } else {
-                        printf("Error: could not recognise the type of the expression!\n");
-                    }
-                } else {
-                    printf("Error: the type of the node does not match the type declared!\n");
-                }
-            } else {
-                printf("ERROR: couldn't recognise the specified type declaration!\n");
-                exit(1);
-            }
-        } else {//node stores no value
-            if (strcmp("integer", type) == 0) {
-                if (node->value.type == INTEGER_TYPE) {
-                    if (expression.type == INTEGER_TYPE) { //everything is integer, assign the value
-                        node->initialised = true;
-                        node->value.integer_val = expression.integer_val;
-                    } else if (expression.type == DOUBLE_TYPE) { //cast double value to int with warning
-                        node->initialised = true;
-                        printf("Warning: casting double to integer, approximation may occur!\n");
-                        node->value.integer_val = (int) expression.double_val;
-                    } else {
-                        printf("Error: could not recognise the type of the expression!\n");
-                    }
-                } else {
-                    printf("Error: the type of the node does not match the type declared!\n");
-                }
-            } else if (strcmp("double", type) == 0) {
-                if (node->value.type == DOUBLE_TYPE) {
-                    if (expression.type == DOUBLE_TYPE) {//everything is double, assign the value
-                        node->initialised = true;
-                        node->value.double_val = expression.double_val;
-                    } else if (expression.type == INTEGER_TYPE) {
-                        node->initialised = true;
-                        node->value.double_val = (double) expression.integer_val;
-                    } else {
-                        printf("Error: could not recognise the type of the expression!\n");
-                    }
-                } else {
-                    printf("Error: the type of the node does not match the type declared!\n");
-                }
-            } else {
-                printf("ERROR: couldn't recognise the specified type declaration!\n");
-                exit(1);
-            }
-        }
-    } else {
-        if (node->initialised) {//node already stores a value
-            //node has no type defined, but it stores a value, this should be an impossible case
-            printf("ERROR: The node %s currently stores a value, but has no type defined!\n", node->id);
-            exit(1);
-        } else { //node stores no value
-            node->initialised = true;
-            node->type_declared = true;
-            if (strcmp("integer", type) == 0) {
-                node->value.type = INTEGER_TYPE;
-                if (expression.type == INTEGER_TYPE) {
-                    node->value.integer_val = expression.integer_val;
-                } else if (expression.type == DOUBLE_TYPE) {
-                    printf("Warning: casting double to integer, approximation may occur!\n");
-                    node->value.integer_val = (int) expression.double_val;
-                } else {
-                    printf("Error: could not recognise the type of the expression!\n");
-                }
-            } else if (strcmp("double", type) == 0) {
-                node->value.type = DOUBLE_TYPE;
-                if (expression.type == DOUBLE_TYPE) {
-                    node->value.double_val = expression.double_val;
-                } else if (expression.type == INTEGER_TYPE) {
-                    node->value.double_val = (double) expression.integer_val;
-                } else {
-                    printf("Error: could not recognise the type of the expression!\n");
-                }
-            } else {
-                printf("Error: could not recognise the type declared!\n");
-            }
-        }
-    }
-    return node;
-
-}
-symbol_table * completeTypedShorthand(char *type, char *id, char* shorthand, struct variable expression){
-    //complete assignment
-    symbol_table *node = findOrAdd(id);
-    if (node->type_declared) {//node has a type
-        if (node->initialised) {//node already stores a value
-            if (strcmp(type, "integer") == 0) {
-                if (node->value.type == INTEGER_TYPE) {
-                    node->initialised = true;
-                    if (expression.type == INTEGER_TYPE) { //everything is integer, assign the value
-                        int tmp = (int) node->value.integer_val;
-                        if (strcmp(shorthand, "multi_ass") == 0) {
-                            node->value.integer_val = tmp * expression.integer_val;
-                        } else if (strcmp(shorthand, "add_ass") == 0) {
-                            node->value.integer_val = tmp + expression.integer_val;
-                        } else if (strcmp(shorthand, "sub_ass") == 0) {
-                            node->value.integer_val = tmp - expression.integer_val;
-                        } else if (strcmp(shorthand, "div_ass") == 0) {
-                            node->value.integer_val = tmp / expression.integer_val;
-                        } else {
-                            printf("Error: Could not recognise the shorthand operation!\n");
-                        }
-                    } else if (expression.type == DOUBLE_TYPE) {
-                        printf("Warning: casting double to integer, approximation may occur!\n");
-                        int tmp = (int) node->value.integer_val;
-                        if (strcmp(shorthand, "multi_ass") == 0) {
-                            node->value.integer_val = (int) tmp * expression.double_val;
-                        } else if (strcmp(shorthand, "add_ass") == 0) {
-                            node->value.integer_val = (int) tmp + expression.double_val;
-                        } else if (strcmp(shorthand, "sub_ass") == 0) {
-                            node->value.integer_val = (int) tmp - expression.double_val;
-                        } else if (strcmp(shorthand, "div_ass") == 0) {
-                            node->value.integer_val = (int) tmp / expression.double_val;
-                        } else {
-                            printf("Error: Could not recognise the shorthand operation!\n");
-                        }
-                    } else {
-                        node->initialised = false;
-                        printf("Error: could not recognise the type of the expression!\n");
-                    }
-                } else {
-                    printf("Error: the type of the node does not match the type declared!\n");
-                }
-            } else if (strcmp(type, "double") == 0) {
-                if (node->value.type == DOUBLE_TYPE) {
-                    if (expression.type == DOUBLE_TYPE) {//everything is double, assign the value
-                        node->initialised = true;
-                        double tmp = node->value.double_val;
-                        if (strcmp(shorthand, "multi_ass") == 0) {
-                            node->value.double_val = tmp * expression.double_val;
-                        } else if (strcmp(shorthand, "add_ass") == 0) {
-                            node->value.double_val = tmp + expression.double_val;
-                        } else if (strcmp(shorthand, "sub_ass") == 0) {
-                            node->value.double_val = tmp - expression.double_val;
-                        } else if (strcmp(shorthand, "div_ass") == 0) {
-                            node->value.double_val = tmp / expression.double_val;
-                        } else {
-                            printf("Error: Could not recognise the shorthand operation!\n");
-                        }
-                    } else if (expression.type == INTEGER_TYPE) {
-                        node->initialised = true;
-                        double tmp = node->value.double_val;
-                        if (strcmp(shorthand, "multi_ass") == 0) {
-                            node->value.double_val = (double) tmp * expression.integer_val;
-                        } else if (strcmp(shorthand, "add_ass") == 0) {
-                            node->value.double_val = (double) tmp + expression.integer_val;
-                        } else if (strcmp(shorthand, "sub_ass") == 0) {
-                            node->value.double_val = (double) tmp - expression.integer_val;
-                        } else if (strcmp(shorthand, "div_ass") == 0) {
-                            node->value.double_val = (double) tmp / expression.integer_val;
-                        } else {
-                            printf("Error: Could not recognise the shorthand operation!\n");
-                        }
-                    } else {
-                        printf("Error: could not recognise the type of the expression!\n");
-                    }
-                } else {
-                    printf("Error: the type of the node does not match the type declared!\n");
-                }
-            } else {
-                printf("ERROR: couldn't recognise the specified type declaration!\n");
-                exit(1);
-            }
-        } else {//node stores no value
-            if (strcmp(type, "integer") == 0) {
-                if (node->value.type == INTEGER_TYPE) {
-                    node->initialised = true;
-                    if (expression.type == INTEGER_TYPE) { //everything is integer, assign the value
-                        node->value.integer_val = expression.integer_val;
-                    } else if (expression.type == DOUBLE_TYPE) { //cast double value to int with warning
-                        printf("Warning: casting double to integer, approximation may occur!\n");
-                        node->value.integer_val = (int) expression.double_val;
-                    } else {
-                        node->initialised = false;
-                        printf("Error: could not recognise the type of the expression!\n");
-                    }
-                } else {
-                    printf("Error: the type of the node does not match the type declared!\n");
-                }
-            } else if (strcmp(type, "double") == 0) {
-                if (node->value.type == DOUBLE_TYPE) {
-                    if (expression.type == DOUBLE_TYPE) {//everything is double, assign the value
-                        node->initialised = true;
-                        node->value.double_val = expression.double_val;
-                    } else if (expression.type == INTEGER_TYPE) {
-                        node->initialised = true;
-                        node->value.double_val = (double) expression.integer_val;
-                    } else {
-                        printf("Error: could not recognise the type of the expression!\n");
-                    }
-                } else {
-                    printf("Error: the type of the node does not match the type declared!\n");
-                }
-            } else {
-                printf("ERROR: couldn't recognise the specified type declaration!\n");
-                exit(1);
-            }
-            printf("Warning: the variable you declared was not holding any value! Assigning the value to the variable itself\n");
-        }
-    } else {
-        if (node->initialised) {//node already stores a value
-            //node has no type defined, but it stores a value, this should be an impossible case
-            printf("ERROR: The node %s currently stores a value, but has no type defined!\n", node->id);
-            exit(1);
-        } else { //node stores no value
-            node->initialised = true;
-            node->type_declared = true;
-            if (strcmp(type, "integer") == 0) {
-                node->value.type = INTEGER_TYPE;
-                if (expression.type == INTEGER_TYPE) {
-                    node->value.integer_val = expression.integer_val;
-                } else if (expression.type == DOUBLE_TYPE) {
-                    printf("Warning: casting double to integer, approximation may occur!\n");
-                    node->value.integer_val = (int) expression.double_val;
-                } else {
-                    printf("Error: could not recognise the type of the expression!\n");
-                }
-            } else if (strcmp(type, "double") == 0) {
-                node->value.type = DOUBLE_TYPE;
-                if (expression.type == DOUBLE_TYPE) {
-                    node->value.double_val = expression.double_val;
-                } else if (expression.type == INTEGER_TYPE) {
-                    node->value.double_val = (double) expression.integer_val;
-                } else {
-                    printf("Error: could not recognise the type of the expression!\n");
-                }
-            } else {
-                printf("Error: could not recognise the type declared!\n");
-            }
-            printf("Warning: the variable you declared was not holding any value! Assigning the value to the variable itself\n");
-        }
-    }
-    return node;
-}
-symbol_table * completeUntypedAssign(char *id, struct variable expression){
-    symbol_table *node = findOrAdd(id);
-    if (node->type_declared) {
-        if (node->initialised == 0) {
-            //node has type defined but it stores no value
-            if (node->value.type == INTEGER_TYPE) {
-                if (expression.type == INTEGER_TYPE) {
-                    node->initialised = true;
-                    node->value.integer_val = expression.integer_val;
-                } else if (expression.type == DOUBLE_TYPE) {
-                    node->initialised = true;
-                    node->value.integer_val = (int) expression.double_val;
-                    printf("Warning: casting the double result to an integer!");
-                } else {
-                    printf("Error: type mismatch! Node %s has type %i (integer), but the expression has type %i instead!\n",
-                           node->id, node->value.type, expression.type);
-                }
-            } else if (node->value.type == DOUBLE_TYPE) {
-                if (expression.type == INTEGER_TYPE) {
-                    node->initialised = true;
-                    node->value.double_val = (double) expression.integer_val;
-                } else if (expression.type == DOUBLE_TYPE) {
-                    node->initialised = true;
-                    node->value.double_val = expression.double_val;
-                }
-                {
-                    printf("Error: type mismatch! Node %s has type %i (double), but the expression has type %i instead!\n",
-                           node->id, node->value.type, expression.type);
-                }
-            } else {
-                printf("Error: the type of node %s could not be recognised!\n", node->id);
-                exit(1);
-            }
-        } else {
-            //node has type defined and it stores a value
-            if (node->value.type == expression.type) {
-                if (node->value.type == INTEGER_TYPE) {
-                    node->value.integer_val = expression.integer_val;
-                    printf("Info: Updated variable %s to the new value %i", node->id, expression.integer_val);
-                } else if (node->value.type == DOUBLE_TYPE) {
-                    node->value.double_val = expression.double_val;
-                    printf("Info: Updated variable %s to the new value %f", node->id, expression.double_val);
-                } else {
-                    printf("Error: the type of node %s could not be recognised!\n", node->id);
-                    exit(1);
-                }
-            } else {
-                printf("Error: type mismatch! Node %s has type %i (double), but the expression has type %i instead!\n",
-                       node->id, node->value.type, expression.type);
-                exit(1);
-            }
-        }
-    } else {
-        if (node->initialised) {
-            //node has no type defined, but it stores a value, this should be an impossible case
-            printf("Error: The node %s currently stores a value, but has no type defined!\n", node->id);
-            exit(1);
-        } else {
-            //node has neither type defined nor it stores a value
-            if (expression.type == INTEGER_TYPE) {
-                node->initialised = true;
-                node->value.type = INTEGER_TYPE;
-                node->value.integer_val = expression.integer_val;
-                node->type_declared = true;
-            } else if (expression.type == DOUBLE_TYPE) {
-                node->initialised = true;
-                node->value.type = DOUBLE_TYPE;
-                node->value.double_val = expression.double_val;
-                node->type_declared = true;
-            } else {
-                printf("ERROR: the type of the expression could not be recognised!\n");
-                exit(1);
-            }
-        }
-    }
-    return node;
+/* stores a copy of the given string in the node, releasing the string the node held before (if any).
+ * The copy is owned by the node, so that it survives the statement arena and can later be extended in place by +=
+ * (on a table that is not shared, see shared-utils.h)*/
+void storeString(symbol_table *node, struct variable expression){
+    struct variable copy = ownedCopy(&expression);
+    struct variable old = node->value;
+    setValue(node, shareValue(copy));
+    if (node->initialised && valueType(old) == STRING_TYPE) {
+        retireValue(old);
+    }
+    node->initialised = true;
 }
-symbol_table * completeUntypedShorthand(char *id, char *shorthand, struct variable expression){
-    //untyped assignment, no type specified
-    symbol_table *node = findOrAdd(id);
-    if (node->type_declared) {
-        if (node->initialised) {
-            //node has type defined and it stores a value
-            if (node->value.type == INTEGER_TYPE) {
-                node->initialised = true;
-                if (expression.type == INTEGER_TYPE) { //everything is integer, assign the value
-                    int tmp = (int) node->value.integer_val;
-                    if (strcmp(shorthand, "multi_ass") == 0) {
-                        node->value.integer_val = tmp * expression.integer_val;
-                    } else if (strcmp(shorthand, "add_ass") == 0) {
-                        node->value.integer_val = tmp + expression.integer_val;
-                    } else if (strcmp(shorthand, "sub_ass") == 0) {
-                        node->value.integer_val = tmp - expression.integer_val;
-                    } else if (strcmp(shorthand, "div_ass") == 0) {
-                        node->value.integer_val = tmp / expression.integer_val;
-                    } else {
-                        printf("Error: Could not recognise the shorthand operation!\n");
-                    }
-                } else if (expression.type == DOUBLE_TYPE) {
-                    printf("Warning: casting double to integer, approximation may occur!\n");
-                    int tmp = (int) node->value.integer_val;
-                    if (strcmp(shorthand, "multi_ass") == 0) {
-                        node->value.integer_val = (int) tmp * expression.double_val;
-                    } else if (strcmp(shorthand, "add_ass") == 0) {
-                        node->value.integer_val = (int) tmp + expression.double_val;
-                    } else if (strcmp(shorthand, "sub_ass") == 0) {
-                        node->value.integer_val = (int) tmp - expression.double_val;
-                    } else if (strcmp(shorthand, "div_ass") == 0) {
-                        node->value.integer_val = (int) tmp / expression.double_val;
-                    } else {
-                        printf("Error: Could not recognise the shorthand operation!\n");
-                    }
-                } else {
-                    node->initialised = false;
-                    printf("Error: could not recognise the type of the expression!\n");
-                }
-            } else if (node->value.type == DOUBLE_TYPE) {
-                if (expression.type == DOUBLE_TYPE) {//everything is double, assign the value
-                    node->initialised = true;
-                    double tmp = node->value.double_val;
-                    if (strcmp(shorthand, "multi_ass") == 0) {
-                        node->value.double_val = tmp * expression.double_val;
-                    } else if (strcmp(shorthand, "add_ass") == 0) {
-                        node->value.double_val = tmp + expression.double_val;
-                    } else if (strcmp(shorthand, "sub_ass") == 0) {
-                        node->value.double_val = tmp - expression.double_val;
-                    } else if (strcmp(shorthand, "div_ass") == 0) {
-                        node->value.double_val = tmp / expression.double_val;
-                    } else {
-                        printf("Error: Could not recognise the shorthand operation!\n");
-                    }
-                } else if (expression.type == INTEGER_TYPE) {
-                    node->initialised = true;
-                    double tmp = node->value.double_val;
-                    if (strcmp(shorthand, "multi_ass") == 0) {
-                        node->value.double_val = (double) tmp * expression.integer_val;
-                    } else if (strcmp(shorthand, "add_ass") == 0) {
-                        node->value.double_val = (double) tmp + expression.integer_val;
-                    } else if (strcmp(shorthand, "sub_ass") == 0) {
-                        node->value.double_val = (double) tmp - expression.integer_val;
-                    } else if (strcmp(shorthand, "div_ass") == 0) {
-                        node->value.double_val = (double) tmp / expression.integer_val;
-                    } else {
-                        printf("Error: Could not recognise the shorthand operation!\n");
-                    }
-                } else {
-                    printf("Error: could not recognise the type of the expression!\n");
-                }
-            } else {
-                printf("Error: the type of the node does not match the type declared!\n");
-            }
-        } else {
-            //node has type defined but it stores no value
-            if (node->value.type == INTEGER_TYPE) {
-                if (expression.type == INTEGER_TYPE) {
-                    node->initialised = true;
-                    node->value.integer_val = expression.integer_val;
-                } else {
-                    printf("Error: type mismatch! Node %s has type %i (integer), but the expression has type %i instead!\n",
-                           node->id, node->value.type, expression.type);
-                }
-            } else if (node->value.type == DOUBLE_TYPE) {
-                if (expression.type == INTEGER_TYPE) {
-                    node->initialised = true;
-                    node->value.double_val = expression.double_val;
-                } else {
-                    printf("Error: type mismatch! Node %s has type %i (double), but the expression has type %i instead!\n",
-                           node->id, node->value.type, expression.type);
-                }
-            } else {
-                printf("Error: the type of node %s could not be recognised!\n", node->id);
-                exit(1);
-            }
-        }
-    } else {
-        if (node->initialised) {
-            //node has no type defined, but it stores a value, this should be an impossible case
-            printf("Error: The node %s currently stores a value, but has no type defined!\n", node->id);
-            exit(1);
-        } else {
-            //node has neither type defined nor it stores a value
-            printf("Warning: the variable declared has no value stored, assigning the result instead!\n");
-            node->initialised = true;
-            if (expression.type == INTEGER_TYPE) {
-                node->value.type = INTEGER_TYPE;
-                node->value.integer_val = expression.integer_val;
-                node->type_declared = true;
-            } else if (expression.type == DOUBLE_TYPE) {
-                node->value.type = DOUBLE_TYPE;
-                node->value.double_val = expression.double_val;
-                node->type_declared = true;
-            } else {
-                node->initialised = false;
-                printf("Error: the type of the expression could not be recognised!\n");
-                exit(1);
-            }
-        }
-    }
-    return node;
-}
-symbol_table * typedAssign(char *type, char *id){
-    symbol_table *node = findOrAdd(id);
-    if(node->type_declared==0){
-        if(strcmp("integer",type)==0){
-            printf("Set the variable type to integer\n");
-            node->value.type=INTEGER_TYPE;
-        } else if(strcmp("double",type)==0){
-            node->value.type=DOUBLE_TYPE;
-            printf("Set the variable type to double\n");
-        }
-        node->type_declared=1;
-    } else {
-        char* node_type = varType(node->value);
-        if(strcmp(node_type,type)==0){
-            printf("Error: the variable you specified is already defined with type %s!\n",node_type);
-        } else {
-            printf("Info: the variable you specified is already defined with the same type!\n");
-        }
-    }
-    return node;
-}
-
-/* EXTENDED ARITHMETIC FUNCTIONS
- * implementation of the four basic operations as well as the increase/decrease operator and string concatenation*/
-struct variable sumOrConcat(struct variable n1, struct variable n2){
-    struct variable result;
-
-    //if one of the two variables is a string, concatenate
-    if(n1.type==STRING_TYPE || n2.type == STRING_TYPE){
-        if (n1.type == STRING_TYPE && n2.type == STRING_TYPE){
-            result.string_val = n1.string_val;
-            strcat(result.string_val, n2.string_val);
-            result.type = STRING_TYPE;
-        } else if (n1.type == INTEGER_TYPE){
-            char v [20];
-            sprintf(v,"%i",n1.integer_val);
-            result.string_val = strcat(v,n2.string_val);
-            result.type = STRING_TYPE;
-        } else if (n1.type == DOUBLE_TYPE){
-            char v [20] = {0};
-            sprintf(v,"%f",n1.double_val);
-            result.string_val= strcat(v,n2.string_val);
-            result.type = STRING_TYPE;
-        } else if (n2.type == INTEGER_TYPE){
-            result.string_val = n1.string_val;
-            char v [20];
-            sprintf(v,"%i",n2.integer_val);
-            strcat(result.string_val, v);
-            result.type = STRING_TYPE;
-        } else if (n2.type == DOUBLE_TYPE){
-            result.string_val = n1.string_val;
-            char v [20];
-            sprintf(v,"%f",n2.double_val);
-            strcat(result.string_val, v);
-            result.type = STRING_TYPE;
-        } else {
-            result.type = 8;
-        }
-    } else if (n1.type == UNDEFINED_TYPE || n2.type == UNDEFINED_TYPE){
-        if (n1.type == INTEGER_TYPE) {
-            result.integer_val = n1.integer_val;
-            result.type = INTEGER_TYPE;
-        } else if (n2.type == INTEGER_TYPE){
-            result.integer_val = n2.integer_val;
-            result.type = INTEGER_TYPE;
-        } else if (n1.type == DOUBLE_TYPE){
-            result.double_val = n1.double_val;
-            result.type = DOUBLE_TYPE;
-        } else if (n2.type == DOUBLE_TYPE) {
-            result.double_val = n1.double_val;
-            result.type = DOUBLE_TYPE;
-        } else if (n1.type == STRING_TYPE) {
-            result.string_val = n1.string_val;
-            result.type = STRING_TYPE;
-        } else if (n2.type == STRING_TYPE){
-            result.string_val = n2.string_val;
-            result.type = STRING_TYPE;
-        } else {
-            result.type = 8;
-        }
-    }
-    else if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
-        result.integer_val = n1.integer_val + n2.integer_val;
-        result.type = INTEGER_TYPE;
-    } else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
-        result.double_val = n1.integer_val + n2.double_val;
-        result.type = DOUBLE_TYPE;
-    } else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
-        result.double_val = n1.double_val + n2.integer_val;
-        result.type = DOUBLE_TYPE;
-    } else if (n1.type == DOUBLE_TYPE && n2.type == DOUBLE_TYPE){
-        result.double_val = n1.double_val + n2.double_val;
-        result.type = DOUBLE_TYPE;
-    } else{
-        result.type = 9; // ERROR TYPE
-    }
-
-    return result;
-}
-
-struct variable sub(struct variable n1, struct variable n2){
-    struct variable result;
-    if(n1.type == UNDEFINED_TYPE){
-        result.type = n2.type;
-        if(n2.type == INTEGER_TYPE){
-            result.integer_val = n2.integer_val;
-        } else if(n2.type == DOUBLE_TYPE){
-            result.double_val = n2.double_val;
-        }
-    } else if(n2.type == UNDEFINED_TYPE){
-        result.type = n1.type;
-        if(n1.type == INTEGER_TYPE){
-            result.integer_val = n1.integer_val;
-        } else if(n1.type == DOUBLE_TYPE){
-            result.double_val = n1.double_val;
-        }
-    }
-    if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
-        result.integer_val = n1.integer_val - n2.integer_val;
-        result.type = INTEGER_TYPE;
-    }
-    else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
-        result.double_val = n1.integer_val - n2.double_val;
-        result.type = DOUBLE_TYPE;
-    }
-    else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
-        result.double_val = n1.double_val - n2.integer_val;
-        result.type = DOUBLE_TYPE;
-    }
-    else{
-        result.double_val = n1.double_val - n2.double_val;
-        result.type = DOUBLE_TYPE;
-    }
-
-    return result;
-}
-
-struct variable multi(struct variable n1, struct variable n2){
-
-    struct variable result;
-    if(n1.type == UNDEFINED_TYPE){
-        result.type = n2.type;
-        if(n2.type == INTEGER_TYPE){
-            result.integer_val = 0;
-        } else if(n2.type == DOUBLE_TYPE){
-            result.double_val = 0;
-        }
-    } else if(n2.type == UNDEFINED_TYPE){
-        result.type = n1.type;
-        if(n1.type == INTEGER_TYPE){
-            result.integer_val = 0;
-        } else if(n1.type == DOUBLE_TYPE){
-            result.double_val = 0;
-        }
-    }
 
-    if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
-        result.integer_val = n1.integer_val * n2.integer_val;
-        result.type = INTEGER_TYPE;
-    }
-    else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
-        result.double_val = n1.integer_val * n2.double_val;
-        result.type = DOUBLE_TYPE;
+/* stores an integer in the node, releasing the big integer the node held before (if any).
+ * Big integers are copied to the heap, like strings, so that they survive the statement arena*/
+void storeInteger(symbol_table *node, struct variable expression){
+    struct variable copy = copyBigInteger(expression, true);
+    struct variable old = node->value;
+    setValue(node, copy);
+    if (node->initialised && isBigInteger(old)){
+        retireValue(old);
     }
-    else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
-        result.double_val = n1.double_val * n2.integer_val;
-        result.type = DOUBLE_TYPE;
-    }
-    else{
-        result.double_val = n1.double_val * n2.double_val;
-        result.type = DOUBLE_TYPE;
-    }
-
-    return result;
-}
-
-struct variable divide(struct variable n1, struct variable n2){
-
-    struct variable result;
-    if(n2.double_val == 0.0 || n2.integer_val == 0|| n2.type == UNDEFINED_TYPE){
-        printf("ERROR: cannot divide by 0");
-        exit(0);
-    }
-    else if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
-        result.integer_val = n1.integer_val / n2.integer_val;
-        result.type = INTEGER_TYPE;
-    }
-    else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
-        result.double_val = n1.integer_val / n2.double_val;
-        result.type = DOUBLE_TYPE;
-    }
-    else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
-        result.double_val = n1.double_val / n2.integer_val;
-        result.type = DOUBLE_TYPE;
-    }
-    else{
-        result.double_val = n1.double_val / n2.double_val;
-        result.type = DOUBLE_TYPE;
-    }
-
-    return result;
-}
-
-struct variable inc(struct variable n){
-    struct variable result;
-    if(n.type==STRING_TYPE){
-        printf("cannot increment a string!\n");
-    } else if (n.type == INTEGER_TYPE){
-        result.integer_val = n.integer_val+1;
-        result.type = INTEGER_TYPE;
-    } else if (n.type == DOUBLE_TYPE){
-        result.double_val = n.double_val+1;
-        result.type = DOUBLE_TYPE;
-    } else if (n.type == UNDEFINED_TYPE){
-        printf("cannot increment nothing!\n");
-    } else {
-        printf("Failed to recognise type of variable to be incremented!\n");
-    }
-    return result;
-}
-
-struct variable dec(struct variable n){
-    struct variable result;
-    if(n.type==STRING_TYPE){
-        printf("cannot decrement a string!\n");
-        exit(0);
-    } else if (n.type == INTEGER_TYPE){
-        result.integer_val = n.integer_val-1;
-        result.type = INTEGER_TYPE;
-    } else if (n.type == DOUBLE_TYPE){
-        result.double_val = n.double_val-1;
-        result.type = DOUBLE_TYPE;
-    } else if (n.type == UNDEFINED_TYPE){
-        printf("cannot decrement nothing!\n");
-    } else {
-        printf("Failed to recognise type of variable to be decremented!\n");
-    }
-    return result;
-}
-
-
-/*COMPARISON/LOGIC FUNCTIONS */
-bool greaterNum(struct variable n1, struct variable n2){
-    if (n1.type == INTEGER_TYPE && n2.type == UNDEFINED_TYPE){
-        if (n1.integer_val > 0){
-            return true;
-        }
-    } else if (n1.type == DOUBLE_TYPE && n2.type == UNDEFINED_TYPE){
-        if (n1.double_val > 0){
-            return true;
-        }
-    } else if (n1.type == UNDEFINED_TYPE && n2.type == INTEGER_TYPE){
-        if (0 > n2.integer_val){
-            return true;
-        }
-    } else if (n1.type == UNDEFINED_TYPE && n2.type == DOUBLE_TYPE){
-        if (0 > n2.double_val){
-            return true;
-        }
-    } else if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
-        if (n1.integer_val > n2.integer_val){
-            return true;
-        }
-    } else if (n1.type == DOUBLE_TYPE && n2.type == DOUBLE_TYPE){
-        if (n1.double_val > n2.double_val){
-            return true;
-        }
-    } else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
-        if (n1.double_val > n2.integer_val){
-            return true;
-        }
-    } else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
-        if (n1.integer_val > n2.double_val){
-            return true;
-        }
-    }
-    return false;
-}
-
-bool equal(struct variable n1, struct variable n2){
-    if(n1.type == UNDEFINED_TYPE && n2.type == UNDEFINED_TYPE){
-        return true;
-    }
-    if (n1.type == INTEGER_TYPE && n2.type == INTEGER_TYPE){
-        if (n1.integer_val == n2.integer_val){
-            return true;
-        }
-    }
-    else if (n1.type == DOUBLE_TYPE && n2.type == DOUBLE_TYPE){
-        if (n1.double_val == n2.double_val){
-            return true;
-        }
-    }
-    else if (n1.type == DOUBLE_TYPE && n2.type == INTEGER_TYPE){
-        if (n1.double_val == n2.integer_val){
-            return true;
-        }
-    }
-    else if (n1.type == INTEGER_TYPE && n2.type == DOUBLE_TYPE){
-        if (n1.integer_val == n2.double_val){
-            return true;
-        }
-    } else if (n1.type == STRING_TYPE && n2.type == STRING_TYPE){
-        if(strcmp(n1.string_val,n2.string_val) == 0){
-            return true;
-        }
-    }
-    return false;
-}
-
-bool lesserNum(struct variable n1, struct variable n2){
-    return !equal(n1, n2) && !greaterNum(n1, n2);
-}
-
-bool neqNum(struct variable n1, struct variable n2){
-    return !equal(n1, n2);
-}
-
-bool geqNum(struct variable n1, struct variable n2){
-    return greaterNum(n1,n2) || equal(n1, n2);
+    node->initialised = true;
 }
 
-bool leqNum(struct variable n1, struct variable n2){
-    return lesserNum(n1,n2) || equal(n1, n2);
-}
\ No newline at end of file
+#endif
@@ -0,0 +1,323 @@
+#ifndef VARIABLE_UTILS_H
+#define VARIABLE_UTILS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output-utils.h"
+#include "arena-utils.h"
+#include "number-utils.h"
+
+/* VALUES: every value is a single 64-bit word ("NaN boxing"), so that values are passed in one register
+ * and a node of the symbol-table or an element of the stack takes 8 bytes instead of 16.
+ * - a double is stored as it is: its bits are the value itself
+ * - any other value is stored in the bits of a NaN the hardware never produces (sign, exponent and quiet bit set
+ *   and a non-zero tag in the next 3 bits), with the tag in the top 16 bits and the payload in the lower 48:
+ *   an integer of up to 48 bits (two's complement), the address of the characters of a string or of the limbs
+ *   of a big integer (pointers fit in 48 bits), or up to 5 characters of a short string, null-terminated,
+ *   in the lower bytes
+ * - integers that do not fit in 48 bits are big integers (see integer-utils.h), which are the same type:
+ *   the arithmetic works on 64 bits and checks for overflow, and only falls back to big integers when
+ *   the result does not fit, while big results that fit again are stored in the value itself
+ * - NaNs produced by arithmetic are replaced by the positive quiet NaN, so they can never be taken for a tag
+ * Strings tagged as shared belong to a variable or to compiled code, so they must not be modified in place.*/
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "short strings are stored in the lower bytes of a value, which requires a little-endian machine"
+#endif
+
+struct variable{
+    uint64_t bits;
+};
+
+#define SHORT_STRING_CAPACITY 6    // strings of up to 5 characters are stored inside the value itself
+
+const uint64_t TAG_UNDEFINED = 0xFFF9;
+const uint64_t TAG_INTEGER = 0xFFFA;
+const uint64_t TAG_BIG_INTEGER = 0xFFFB;    // pointer to a big_integer, never modified once built
+const uint64_t TAG_STRING = 0xFFFC;         // pointer to the characters of a string_header
+const uint64_t TAG_SHARED_STRING = 0xFFFD;
+const uint64_t TAG_SHORT_STRING = 0xFFFE;   // characters in the payload
+const uint64_t TAG_SHARED_SHORT_STRING = 0xFFFF;
+const uint64_t SHARED_BIT = 1;              // set in the tags of shared strings
+const uint64_t PAYLOAD_MASK = 0xFFFFFFFFFFFF;
+const uint64_t CANONICAL_NAN = 0x7FF8000000000000;
+
+const char UNDEFINED_TYPE = 0;
+const char INTEGER_TYPE = 1;
+const char DOUBLE_TYPE = 2;
+const char STRING_TYPE = 3;
+
+/*type of every tag, from TAG_UNDEFINED to TAG_SHARED_SHORT_STRING*/
+const char TAG_TYPES[] = {0, 1, 1, 3, 3, 3, 3};
+
+const int64_t SMALL_INTEGER_MIN = -((int64_t)1 << 47);    // range of the integers stored in the value itself
+const int64_t SMALL_INTEGER_MAX = ((int64_t)1 << 47) - 1;
+
+/*Value function prototypes*/
+char valueType(struct variable value);
+uint64_t valueTag(struct variable value);
+struct variable undefinedValue();
+struct variable integerValue(int64_t integer);
+bool isSmallInteger(int64_t integer);
+struct variable doubleValue(double real);
+struct variable boxValue(uint64_t tag, uint64_t payload);
+struct variable bigFromInteger(int64_t integer);                    // defined in integer-utils.h
+size_t formatIntegerValue(struct variable value, char *buffer, const char **text);  // defined in integer-utils.h
+int64_t asInteger(struct variable value);
+bool isBigInteger(struct variable value);
+double asDouble(struct variable value);
+bool isShared(struct variable value);
+struct variable shareValue(struct variable value);
+
+char valueType(struct variable value){
+    uint64_t tag = valueTag(value);
+    return tag < TAG_UNDEFINED ? DOUBLE_TYPE : TAG_TYPES[tag - TAG_UNDEFINED];
+}
+
+// top 16 bits of the value, which are the tag unless the value is a double
+uint64_t valueTag(struct variable value){
+    return value.bits >> 48;
+}
+
+struct variable undefinedValue(){
+    return boxValue(TAG_UNDEFINED, 0);
+}
+
+// stores the integer in the value if it fits, in a temporary big integer otherwise
+struct variable integerValue(int64_t integer){
+    if (!isSmallInteger(integer)){
+        return bigFromInteger(integer);
+    }
+    return boxValue(TAG_INTEGER, (uint64_t)integer & PAYLOAD_MASK);
+}
+
+// whether the integer fits in the value itself: one comparison, since the range is shifted to start at 0
+bool isSmallInteger(int64_t integer){
+    return (uint64_t)integer - (uint64_t)SMALL_INTEGER_MIN <= (uint64_t)SMALL_INTEGER_MAX - (uint64_t)SMALL_INTEGER_MIN;
+}
+
+struct variable doubleValue(double real){
+    struct variable value;
+    if (real != real){
+        value.bits = CANONICAL_NAN;
+    } else {
+        memcpy(&value.bits, &real, sizeof(double));
+    }
+    return value;
+}
+
+struct variable boxValue(uint64_t tag, uint64_t payload){
+    struct variable value;
+    value.bits = tag << 48 | payload;
+    return value;
+}
+
+// value of an integer stored in the value itself, big integers have to be checked for first (see isBigInteger())
+int64_t asInteger(struct variable value){
+    return (int64_t)(value.bits << 16) >> 16;
+}
+
+bool isBigInteger(struct variable value){
+    return valueTag(value) == TAG_BIG_INTEGER;
+}
+
+double asDouble(struct variable value){
+    double real;
+    memcpy(&real, &value.bits, sizeof(double));
+    return real;
+}
+
+// whether the value is a string that must not be modified in place
+bool isShared(struct variable value){
+    return valueTag(value) >= TAG_STRING && (valueTag(value) & SHARED_BIT);
+}
+
+// marks a string as shared (see isShared()), other values are returned as they are
+struct variable shareValue(struct variable value){
+    if (valueTag(value) >= TAG_STRING){
+        value.bits |= SHARED_BIT << 48;
+    }
+    return value;
+}
+
+/* STRING VALUES: longer strings live out of the variable, right after a header recording their length and
+ * the capacity of the buffer. Appending grows the buffer geometrically, so building a string
+ * by repeated appends takes linear time, and the length is never recomputed with strlen.
+ * Temporary strings (literals and intermediate results) are allocated in the statement arena
+ * (see arena-utils.h) and disappear with it, while strings stored in variables are owned:
+ * they are allocated on the heap, grow in place and are freed when overwritten.
+ * Strings shorter than SHORT_STRING_CAPACITY need no buffer at all, their characters are stored in the value.*/
+struct string_header{
+    size_t length;
+    size_t capacity;    // characters that fit in the buffer, terminator excluded
+    bool owned;         // heap buffer belonging to a variable, rather than an arena one
+    char chars[];
+};
+
+const size_t MIN_STRING_CAPACITY = 16;
+
+/*String function prototypes*/
+struct variable makeString(const char *chars, size_t length);
+struct variable makeOwnedString(const char *chars, size_t length);
+struct variable newString(const char *chars, size_t length, bool owned);
+struct variable copyString(const struct variable *string);
+struct variable ownedCopy(const struct variable *string);
+const char *stringChars(const struct variable *string);
+size_t stringLength(const struct variable *string);
+void appendToString(struct variable *string, const char *chars, size_t length);
+void appendValue(struct variable *string, const struct variable *value);
+void freeString(struct variable *string);
+char *allocateString(size_t capacity, bool owned);
+struct string_header *stringHeader(const char *chars);
+
+// returns a new temporary string holding the given characters
+struct variable makeString(const char *chars, size_t length){
+    return newString(chars, length, false);
+}
+
+// returns a new string holding the given characters, that can be kept after the end of the statement
+struct variable makeOwnedString(const char *chars, size_t length){
+    return newString(chars, length, true);
+}
+
+struct variable newString(const char *chars, size_t length, bool owned){
+    struct variable string;
+    if (length < SHORT_STRING_CAPACITY){
+        string = boxValue(TAG_SHORT_STRING, 0);
+        memcpy(&string.bits, chars, length);
+    } else {
+        char *heapChars = allocateString(length, owned);
+        memcpy(heapChars, chars, length);
+        heapChars[length] = '\0';
+        stringHeader(heapChars)->length = length;
+        string = boxValue(TAG_STRING, (uint64_t)(uintptr_t)heapChars);
+    }
+    return string;
+}
+
+// returns a temporary copy of a string, that can be modified independently of the original
+struct variable copyString(const struct variable *string){
+    return makeString(stringChars(string), stringLength(string));
+}
+
+// returns an owned copy of a string, to be stored in a variable
+struct variable ownedCopy(const struct variable *string){
+    return makeOwnedString(stringChars(string), stringLength(string));
+}
+
+const char *stringChars(const struct variable *string){
+    if (valueTag(*string) >= TAG_SHORT_STRING){
+        return (const char *)&string->bits;
+    }
+    return (const char *)(uintptr_t)(string->bits & PAYLOAD_MASK);
+}
+
+size_t stringLength(const struct variable *string){
+    if (valueTag(*string) >= TAG_SHORT_STRING){
+        return strlen((const char *)&string->bits);
+    }
+    return stringHeader(stringChars(string))->length;
+}
+
+/* appends the given characters to the string itself, which must not be shared by anything else:
+ * a short string moves out of the value when it gets too long (to the heap if the string is marked as shared,
+ * since it then belongs to a variable, to the arena otherwise), a longer string doubles its buffer when it is full*/
+void appendToString(struct variable *string, const char *chars, size_t length){
+    size_t oldLength = stringLength(string);
+    size_t newLength = oldLength + length;
+    char *buffer;
+    if (valueTag(*string) >= TAG_SHORT_STRING){
+        if (newLength < SHORT_STRING_CAPACITY){
+            memcpy((char *)&string->bits + oldLength, chars, length);
+            return;
+        }
+        size_t capacity = newLength * 2 > MIN_STRING_CAPACITY ? newLength * 2 : MIN_STRING_CAPACITY;
+        buffer = allocateString(capacity, isShared(*string));
+        memcpy(buffer, (const char *)&string->bits, oldLength);
+    } else {
+        buffer = (char *)stringChars(string);
+        struct string_header *header = stringHeader(buffer);
+        if (newLength > header->capacity){
+            size_t capacity = header->capacity * 2 > newLength ? header->capacity * 2 : newLength;
+            if (header->owned){
+                //the characters appended may be the string's own (s += s), which realloc() may free
+                bool own = chars >= buffer && chars <= buffer + oldLength;
+                size_t offset = own ? (size_t)(chars - buffer) : 0;
+                header = (struct string_header *)realloc(header, sizeof(struct string_header) + capacity + 1);
+                countAllocation(sizeof(struct string_header) + capacity + 1);
+                if (header == NULL){
+                    printError("Error: could not allocate memory for the string!\n");
+                    sessionExit(1);
+                }
+                header->capacity = capacity;
+                buffer = header->chars;
+                if (own){
+                    chars = buffer + offset;
+                }
+            } else {
+                //buffers that are not owned cannot be resized: an arena one is simply left behind until the arena
+                //is reset, and a variable holding one (see snapshot-utils.h) moves to a heap buffer of its own
+                char *newChars = allocateString(capacity, isShared(*string));
+                memcpy(newChars, buffer, oldLength);
+                buffer = newChars;
+            }
+        }
+    }
+    memcpy(buffer + oldLength, chars, length);
+    buffer[newLength] = '\0';
+    stringHeader(buffer)->length = newLength;
+    //the string keeps its shared mark, only its characters may have moved
+    *string = boxValue(TAG_STRING | (valueTag(*string) & SHARED_BIT), (uint64_t)(uintptr_t)buffer);
+}
+
+/* appends a value of any type to the string, converting numbers to text first*/
+void appendValue(struct variable *string, const struct variable *value){
+    char v[NUMBER_TEXT_SIZE];
+    char type = valueType(*value);
+    if (type == STRING_TYPE){
+        appendToString(string, stringChars(value), stringLength(value));
+    } else if (type == INTEGER_TYPE){
+        const char *text;
+        size_t length = formatIntegerValue(*value, v, &text);
+        appendToString(string, text, length);
+    } else if (type == DOUBLE_TYPE){
+        appendToString(string, v, formatDouble(v, asDouble(*value)));
+    }
+}
+
+// releases an owned string, temporary strings are released all together by arenaReset()
+void freeString(struct variable *string){
+    if (valueTag(*string) < TAG_SHORT_STRING && stringHeader(stringChars(string))->owned){
+        free(stringHeader(stringChars(string)));
+    }
+    *string = boxValue(TAG_SHORT_STRING, 0);
+}
+
+// allocates an empty string with room for capacity characters (on the heap if owned, in the arena otherwise), returning its characters
+char *allocateString(size_t capacity, bool owned){
+    struct string_header *header;
+    if (owned){
+        header = (struct string_header *)malloc(sizeof(struct string_header) + capacity + 1);
+        countAllocation(sizeof(struct string_header) + capacity + 1);
+        if (header == NULL){
+            printError("Error: could not allocate memory for the string!\n");
+            sessionExit(1);
+        }
+    } else {
+        header = (struct string_header *)arenaAlloc(sizeof(struct string_header) + capacity + 1);
+    }
+    header->length = 0;
+    header->capacity = capacity;
+    header->owned = owned;
+    header->chars[0] = '\0';
+    return header->chars;
+}
+
+struct string_header *stringHeader(const char *chars){
+    return (struct string_header *)(chars - offsetof(struct string_header, chars));
+}
+
+#endif
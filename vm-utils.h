@@ -0,0 +1,809 @@
+#ifndef VM_UTILS_H
+#define VM_UTILS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "symboltable-utils.h"
+#include "ast-utils.h"
+#include "arithmetic-utils.h"
+#include "fold-utils.h"
+#include "assignment-utils.h"
+#include "function-utils.h"
+#include "binding-utils.h"
+#include "snapshot-utils.h"
+#include "journal-utils.h"
+
+/* BYTECODE: every statement is compiled into a chunk of instructions for a stack machine.
+ * Instructions are 8 bytes long, variables are addressed by the slot of their node (see slotTable
+ * in symboltable-utils.h) and literals by their index in the constant pool of the chunk.*/
+enum opcode{
+    OP_CONST,           // push constants[operand]
+    OP_LOAD,            // push the value of slotTable[operand]
+    OP_PARAM,           // push the argument number operand of the running function
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV,     // same order as ADD_OP ... DIV_OP, see arithmetic-utils.h
+    OP_INC, OP_DEC,
+    OP_LT, OP_GT, OP_LEQ, OP_GEQ, OP_EQ, OP_NEQ,
+    OP_AND, OP_OR,      // jump to operand keeping the condition on top if it decides the result, pop it otherwise
+    OP_PRINT_RESULT,    // pop and print the result of an expression
+    OP_PRINT_TRUTH,     // pop and print the result of a condition
+    OP_PRINT_TABLE,
+    OP_PRINT_NODE,      // print slotTable[operand]
+    OP_PRINT_TYPE,      // print the type of slotTable[operand]
+    OP_PRINT_STATS,     // print the statistics of the session
+    OP_PRINT_STRING,    // print constants[operand]
+    OP_SAVE_TABLE,      // save the symbol-table to the file constants[operand], see snapshot-utils.h
+    OP_LOAD_TABLE,      // load the symbol-table saved in the file constants[operand]
+    OP_JUMP_IF_FALSE,   // pop a condition, jump to operand if it is false
+    OP_JUMP,            // jump to operand
+    OP_LOOP,            // jump back to operand, releasing the memory used by the iteration that has ended
+    OP_CALL,            // call the function number operand on the arguments on top of the stack
+    OP_RETURN,          // return the value on top of the stack to the caller
+    OP_ASSIGN,          // pop an expression and assign it to slotTable[operand], see assignment-utils.h
+    OP_UPDATE,          // pop the result of a formula and store it in the node bound to it, slotTable[operand]
+    OP_DECLARE,         // give a type to slotTable[operand]
+    OP_NATIVE,          // push the value of the expression compiled to machine code in fragments[operand], see jit-utils.h
+    OP_HALT
+};
+
+struct instruction{
+    unsigned char opcode;
+    char type;          // declared type of assignments, UNDEFINED_TYPE if they have none
+    char op;            // operator of assignments, ASSIGN_OP for plain ones
+    unsigned char arguments;    // number of arguments of calls
+    int operand;        // constant index, slot or jump target
+};
+
+/* expression compiled to machine code by the JIT (see jit-utils.h), which replaces its first instruction by OP_NATIVE.
+ * The bytecode of the expression is kept, and runs instead when a guard of the machine code fails*/
+struct native_fragment{
+    uint64_t (*entry)(symbol_table **slots, const struct variable *arguments);  // bits of the value, or JIT_BAIL
+    struct instruction original;    // the instruction replaced by OP_NATIVE
+    int end;                        // instruction following the expression
+    int failures;                   // runs left to the bytecode
+};
+
+struct chunk{
+    struct instruction *code;
+    int length;
+    int capacity;
+    struct variable *constants;
+    int constantCount;
+    int constantCapacity;
+    int depth;          // stack depth reached so far while compiling
+    int maxStack;       // stack space needed to run the chunk
+    int runs;           // runs of the chunk of a function or of a formula, counted to find the hot ones
+    struct native_fragment *fragments;  // see jit-utils.h
+    int fragmentCount;
+    int fragmentCapacity;
+    struct native_pages *pages;         // executable memory holding the machine code of the fragments
+};
+
+/*compilation of hot code to machine code (--jit, see jit-utils.h)*/
+bool jitEnabled = false;
+#define JIT_THRESHOLD 64        // runs of a function or a formula, or iterations of a loop, before its expressions are compiled
+#define JIT_MAX_FAILURES 64     // failed guards after which a fragment is given up for the bytecode
+const uint64_t JIT_BAIL = 0xFFF8000000000000;   // returned when a guard fails: a negative NaN, which no value ever holds
+
+/*Compiler and VM function prototypes*/
+struct chunk *compile(struct ast_node *statement);
+struct chunk *newChunk();
+void compileFunction(struct ast_node *definition);
+void compileBinding(struct ast_node *binding);
+int collectFormulaInputs(const struct chunk *code, symbol_table ***nodes, int function, bool *calls);
+void recheckBindings(int function);
+void collectInputs(const struct chunk *code, struct node_list **inputs, bool *visited);
+void ownConstants(struct chunk *code);
+void compileStatement(struct chunk *chunk, struct ast_node *tree);
+void compileExpression(struct chunk *chunk, struct ast_node *tree);
+int emit(struct chunk *chunk, unsigned char opcode, int operand, int stackEffect);
+int addConstant(struct chunk *chunk, struct variable value);
+void freeChunk(struct chunk *chunk);
+void releaseCode(struct chunk *code);
+struct variable *reserveStack(int size);
+void execute(struct chunk *chunk);
+void runStatement(struct ast_node *statement);
+void resetVm();
+void releaseVm();
+struct variable truthValue(bool truth);
+void jitChunk(struct chunk *chunk, int start, int end, symbol_table **slots, const struct variable *arguments);   // defined in jit-utils.h
+void releaseNative(struct chunk *chunk);    // defined in jit-utils.h
+
+/* COMPILER*/
+
+/* compiles a single statement into a new chunk, terminated by OP_HALT*/
+struct chunk *compile(struct ast_node *statement){
+    struct chunk *chunk = newChunk();
+    compileStatement(chunk, statement);
+    emit(chunk, OP_HALT, 0, 0);
+    return chunk;
+}
+
+struct chunk *newChunk(){
+    struct chunk *chunk = (struct chunk *)calloc(1, sizeof(struct chunk));
+    countAllocation(sizeof(struct chunk));
+    if (chunk == NULL){
+        printError("Error: could not allocate memory for the bytecode!\n");
+        sessionExit(1);
+    }
+    return chunk;
+}
+
+/* compiles the body of a definition into a chunk of its own, terminated by OP_RETURN, which replaces the one
+ * the function had. Definitions are only found at the top level, where a statement is compiled right before
+ * it runs, so the function is defined here rather than by an instruction*/
+void compileFunction(struct ast_node *definition){
+    struct function *function = &session->functions[definition->index];
+    struct chunk *code = newChunk();
+    compileExpression(code, definition->left);
+    emit(code, OP_RETURN, 0, 0);
+    ownConstants(code);
+
+    if (function->code != NULL){
+        releaseCode(function->code);
+    }
+    free(function->parameters);
+    free(function->callees);
+    freeMemo(function);
+    function->code = code;
+    function->arity = 0;
+    for (struct ast_node *parameter = definition->right; parameter != NULL; parameter = parameter->next){
+        function->arity++;
+    }
+    function->parameters = (char **)malloc((function->arity + 1) * sizeof(char *));
+    countAllocation((function->arity + 1) * sizeof(char *));
+    if (function->parameters == NULL){
+        printError("Error: could not allocate memory for the functions!\n");
+        sessionExit(1);
+    }
+    for (struct ast_node *parameter = definition->right; parameter != NULL; parameter = parameter->next){
+        function->parameters[parameter->index] = parameter->name;
+    }
+    function->readsGlobals = false;
+    function->callees = NULL;
+    function->calleeCount = 0;
+    collectDependencies(function, definition->left);
+    updatePurity();
+    printInfo("Info: Defined function %s, with %i parameter(s)%s\n", function->name, function->arity,
+              function->pure && function->memoResults != NULL ? ", its results are memoized" : "");
+    recheckBindings(definition->index);
+}
+
+/* compiles the formula of a binding into a chunk of its own, which stores its result in the bound node
+ * and is run whenever the node is read after one of the variables it depends on has changed (see binding-utils.h).
+ * Like definitions, bindings are only found at the top level, so the node is bound here*/
+void compileBinding(struct ast_node *binding){
+    if (session->table->shared){
+        outPrintf("Error: formulas cannot be bound on a shared symbol-table!\n");
+        return;
+    }
+    symbol_table *node = binding->node;
+    struct chunk *code = newChunk();
+    compileExpression(code, binding->left);
+    emit(code, OP_UPDATE, node->slot, -1);
+    emit(code, OP_HALT, 0, 0);
+    ownConstants(code);
+
+    symbol_table **nodes;
+    bool calls;
+    int count = collectFormulaInputs(code, &nodes, -1, &calls);
+    if (dependsOn(nodes, count, node)){
+        outPrintf("Error: %s cannot be bound to a formula depending on %s itself!\n", node->id, node->id);
+        releaseCode(code);
+        free(nodes);
+        return;
+    }
+    bindNode(node, code, nodes, count);
+    printInfo("Info: Bound variable %s to a formula of %i variable(s)\n", node->id, count);
+}
+
+/* collects the variables read by a formula, also through the functions it calls, into nodes (NULL if there are none)
+ * and returns how many there are. calls tells whether the function given (-1 for none) is one of those it calls*/
+int collectFormulaInputs(const struct chunk *code, symbol_table ***nodes, int function, bool *calls){
+    struct node_list *inputs = NULL;
+    bool *visited = (bool *)calloc(session->functionCount + 1, sizeof(bool));
+    countAllocation((session->functionCount + 1) * sizeof(bool));
+    if (visited == NULL){
+        printError("Error: could not allocate memory for the binding!\n");
+        sessionExit(1);
+    }
+    collectInputs(code, &inputs, visited);
+    *calls = function >= 0 && visited[function];
+    free(visited);
+    *nodes = inputs != NULL ? inputs->nodes : NULL;
+    int count = inputs != NULL ? inputs->count : 0;
+    free(inputs);
+    return count;
+}
+
+/* after a function has been (re)defined, the formulas calling it may read other variables, or their own node:
+ * their inputs are collected again and they are computed again, and those that would now depend on themselves
+ * are unbound, keeping the last value they computed*/
+void recheckBindings(int function){
+    for (int slot = 0; slot < session->table->numberOfNodes; slot++){
+        symbol_table *node = session->table->slotTable[slot];
+        if (node->binding == NULL){
+            continue;
+        }
+        symbol_table **nodes;
+        bool calls;
+        int count = collectFormulaInputs(node->binding->code, &nodes, function, &calls);
+        if (!calls){
+            free(nodes);
+        } else if (dependsOn(nodes, count, node)){
+            outPrintf("Error: %s would depend on itself through %s, it is no longer bound to its formula!\n", node->id,
+                      session->functions[function].name);
+            free(nodes);
+            unbind(node);
+        } else {
+            replaceInputs(node, nodes, count);
+        }
+    }
+}
+
+/* adds the variables read by the code to the inputs (once), along with those read by the functions it calls*/
+void collectInputs(const struct chunk *code, struct node_list **inputs, bool *visited){
+    for (int i = 0; i < code->length; i++){
+        const struct instruction *instruction = &code->code[i];
+        if (instruction->opcode == OP_NATIVE){
+            instruction = &code->fragments[instruction->operand].original;
+        }
+        if (instruction->opcode == OP_LOAD){
+            symbol_table *input = session->table->slotTable[instruction->operand];
+            bool found = false;
+            for (int j = 0; *inputs != NULL && j < (*inputs)->count && !found; j++){
+                found = (*inputs)->nodes[j] == input;
+            }
+            if (!found){
+                addToList(inputs, input);
+            }
+        } else if (instruction->opcode == OP_CALL && !visited[instruction->operand]){
+            visited[instruction->operand] = true;
+            if (session->functions[instruction->operand].code != NULL){
+                collectInputs(session->functions[instruction->operand].code, inputs, visited);
+            }
+        }
+    }
+}
+
+// copies the string literals and big integers of a chunk out of the statement arena, for chunks that outlive the statement
+void ownConstants(struct chunk *code){
+    for (int i = 0; i < code->constantCount; i++){
+        if (valueType(code->constants[i]) == STRING_TYPE){
+            code->constants[i] = shareValue(ownedCopy(&code->constants[i]));
+        } else if (isBigInteger(code->constants[i])){
+            code->constants[i] = copyBigInteger(code->constants[i], true);
+        }
+    }
+}
+
+void compileStatement(struct chunk *chunk, struct ast_node *tree){
+    int at, start;
+    switch (tree->kind){
+        case AST_PRINT_EXPR:
+            compileExpression(chunk, tree->left);
+            emit(chunk, OP_PRINT_RESULT, 0, -1);
+            break;
+        case AST_PRINT_COND:
+            compileExpression(chunk, tree->left);
+            emit(chunk, OP_PRINT_TRUTH, 0, -1);
+            break;
+        case AST_PRINT_TABLE:
+            emit(chunk, OP_PRINT_TABLE, 0, 0);
+            break;
+        case AST_PRINT_NODE:
+            emit(chunk, OP_PRINT_NODE, tree->node->slot, 0);
+            break;
+        case AST_PRINT_TYPE:
+            emit(chunk, OP_PRINT_TYPE, tree->node->slot, 0);
+            break;
+        case AST_PRINT_STATS:
+            emit(chunk, OP_PRINT_STATS, 0, 0);
+            break;
+        case AST_SAVE:
+            emit(chunk, OP_SAVE_TABLE, addConstant(chunk, tree->value), 0);
+            break;
+        case AST_LOAD:
+            emit(chunk, OP_LOAD_TABLE, addConstant(chunk, tree->value), 0);
+            break;
+        case AST_IF:
+            compileExpression(chunk, tree->left);
+            at = emit(chunk, OP_JUMP_IF_FALSE, 0, -1);
+            emit(chunk, OP_PRINT_STRING, addConstant(chunk, tree->value), 0);
+            chunk->code[at].operand = chunk->length;
+            break;
+        case AST_TYPED_ASSIGN:
+        case AST_TYPED_SHORTHAND:
+        case AST_ASSIGN:
+        case AST_SHORTHAND:
+            //the four forms only differ by their declared type and operator
+            compileExpression(chunk, tree->left);
+            at = emit(chunk, OP_ASSIGN, tree->node->slot, -1);
+            chunk->code[at].type = tree->kind == AST_TYPED_ASSIGN || tree->kind == AST_TYPED_SHORTHAND ? tree->type : UNDEFINED_TYPE;
+            chunk->code[at].op = tree->kind == AST_TYPED_ASSIGN || tree->kind == AST_ASSIGN ? ASSIGN_OP : tree->op;
+            break;
+        case AST_DECLARE:
+            at = emit(chunk, OP_DECLARE, tree->node->slot, 0);
+            chunk->code[at].type = tree->type;
+            break;
+        case AST_DEFINE:
+            compileFunction(tree);
+            break;
+        case AST_BIND:
+            compileBinding(tree);
+            break;
+        case AST_FOR:
+            compileStatement(chunk, tree->right);
+            //fall through, the rest of a for loop is a while loop
+        case AST_WHILE:
+            start = chunk->length;
+            compileExpression(chunk, tree->left);
+            at = emit(chunk, OP_JUMP_IF_FALSE, 0, -1);
+            for (struct ast_node *statement = tree->body; statement != NULL; statement = statement->next){
+                compileStatement(chunk, statement);
+            }
+            emit(chunk, OP_LOOP, start, 0);
+            chunk->code[at].operand = chunk->length;
+            break;
+        default:
+            printError("Error: could not compile statement of kind %i!\n", tree->kind);
+            sessionExit(1);
+    }
+}
+
+/* compiles an expression or condition, leaving its value on top of the stack*/
+void compileExpression(struct chunk *chunk, struct ast_node *tree){
+    static const unsigned char operatorOpcodes[] = {
+        OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+        OP_INC, OP_DEC,
+        OP_LT, OP_GT, OP_LEQ, OP_GEQ, OP_EQ, OP_NEQ,
+        OP_AND, OP_OR
+    };
+    switch (tree->kind){
+        case AST_VALUE:
+            emit(chunk, OP_CONST, addConstant(chunk, tree->value), 1);
+            break;
+        case AST_ID:
+            emit(chunk, OP_LOAD, tree->node->slot, 1);
+            break;
+        case AST_PARAM:
+            emit(chunk, OP_PARAM, tree->index, 1);
+            break;
+        case AST_CALL: {
+            int count = 0;
+            for (struct ast_node *argument = tree->left; argument != NULL; argument = argument->next){
+                compileExpression(chunk, argument);
+                count++;
+            }
+            int at = emit(chunk, OP_CALL, tree->index, 1 - count);
+            chunk->code[at].arguments = count;
+            break;
+        }
+        case AST_CONDITIONAL: {
+            compileExpression(chunk, tree->left);
+            int otherwise = emit(chunk, OP_JUMP_IF_FALSE, 0, -1);
+            compileExpression(chunk, tree->right);
+            int end = emit(chunk, OP_JUMP, 0, 0);
+            chunk->code[otherwise].operand = chunk->length;
+            chunk->depth--;     // only one of the two expressions leaves its value on the stack
+            compileExpression(chunk, tree->body);
+            chunk->code[end].operand = chunk->length;
+            break;
+        }
+        case AST_UNARY:
+            compileExpression(chunk, tree->left);
+            emit(chunk, operatorOpcodes[(int)tree->op], 0, 0);
+            break;
+        case AST_BINARY:
+        case AST_COMPARE:
+            compileExpression(chunk, tree->left);
+            compileExpression(chunk, tree->right);
+            emit(chunk, operatorOpcodes[(int)tree->op], 0, -1);
+            break;
+        case AST_LOGIC: {
+            //short circuit: the right condition is skipped when the left one already decides the result
+            compileExpression(chunk, tree->left);
+            int at = emit(chunk, operatorOpcodes[(int)tree->op], 0, -1);
+            compileExpression(chunk, tree->right);
+            chunk->code[at].operand = chunk->length;
+            break;
+        }
+        default:
+            printError("Error: could not compile expression of kind %i!\n", tree->kind);
+            sessionExit(1);
+    }
+}
+
+/* appends an instruction, keeping track of the stack space it needs, and returns its position*/
+int emit(struct chunk *chunk, unsigned char opcode, int operand, int stackEffect){
+    if (chunk->length == chunk->capacity){
+        chunk->capacity = chunk->capacity == 0 ? 16 : chunk->capacity * 2;
+        chunk->code = (struct instruction *)realloc(chunk->code, chunk->capacity * sizeof(struct instruction));
+        countAllocation(chunk->capacity * sizeof(struct instruction));
+        if (chunk->code == NULL){
+            printError("Error: could not allocate memory for the bytecode!\n");
+            sessionExit(1);
+        }
+    }
+    struct instruction *instruction = &chunk->code[chunk->length];
+    instruction->opcode = opcode;
+    instruction->type = UNDEFINED_TYPE;
+    instruction->op = 0;
+    instruction->arguments = 0;
+    instruction->operand = operand;
+
+    chunk->depth += stackEffect;
+    if (chunk->depth > chunk->maxStack){
+        chunk->maxStack = chunk->depth;
+    }
+    return chunk->length++;
+}
+
+int addConstant(struct chunk *chunk, struct variable value){
+    if (chunk->constantCount == chunk->constantCapacity){
+        chunk->constantCapacity = chunk->constantCapacity == 0 ? 8 : chunk->constantCapacity * 2;
+        chunk->constants = (struct variable *)realloc(chunk->constants, chunk->constantCapacity * sizeof(struct variable));
+        countAllocation(chunk->constantCapacity * sizeof(struct variable));
+        if (chunk->constants == NULL){
+            printError("Error: could not allocate memory for the bytecode!\n");
+            sessionExit(1);
+        }
+    }
+    chunk->constants[chunk->constantCount] = shareValue(value); // constants are shared by every run of the chunk
+    return chunk->constantCount++;
+}
+
+void freeChunk(struct chunk *chunk){
+    releaseNative(chunk);
+    free(chunk->code);
+    free(chunk->constants);
+    free(chunk);
+}
+
+// frees the chunk of a function, along with the strings and big integers it copied out of the arena
+void releaseCode(struct chunk *code){
+    for (int i = 0; i < code->constantCount; i++){
+        if (valueType(code->constants[i]) == STRING_TYPE){
+            freeString(&code->constants[i]);
+        } else if (isBigInteger(code->constants[i])){
+            freeBigInteger(&code->constants[i]);
+        }
+    }
+    freeChunk(code);
+}
+
+/* grows the operand stack of the session to hold at least size values, and returns it*/
+struct variable *reserveStack(int size){
+    if (size > session->vmStackCapacity){
+        session->vmStackCapacity = size > session->vmStackCapacity * 2 ? size : session->vmStackCapacity * 2;
+        session->vmStack = (struct variable *)realloc(session->vmStack, session->vmStackCapacity * sizeof(struct variable));
+        countAllocation(session->vmStackCapacity * sizeof(struct variable));
+        if (session->vmStack == NULL){
+            printError("Error: could not allocate memory for the stack!\n");
+            sessionExit(1);
+        }
+    }
+    return session->vmStack;
+}
+
+/* VIRTUAL MACHINE*/
+
+/* runs a compiled chunk until OP_HALT, on the operand stack of the session (grown on demand).
+ * The stack pointer, the instruction pointer and the slot table are kept in locals
+ * so that the dispatch loop works on registers only.
+ * The statements of a loop leave nothing on the stack and copy to the heap whatever they store,
+ * so at the end of every iteration the arena goes back to where it was when the chunk started running,
+ * and a loop runs in constant memory however many times it iterates.
+ * Calls to user-defined functions run in the same loop: the caller is saved in a frame (session->frames)
+ * and the callee reads its arguments where the caller pushed them, until OP_RETURN replaces them with the result.
+ * With --jit, the expressions of the loops, functions and formulas that have run JIT_THRESHOLD times are compiled
+ * to machine code (see jit-utils.h)*/
+/* brings dirty bindings up to date while a chunk runs: their formulas run above the values and the frames in use,
+ * which are found again afterwards, since the stack may have moved (only used inside execute())*/
+#define REFRESH(call) do { \
+        int top = sp - stack; \
+        int base = arguments - stack; \
+        session->vmTop = top; \
+        session->frameTop = frameBase + depth; \
+        call; \
+        session->vmTop = bottom; \
+        session->frameTop = frameBase; \
+        stack = session->vmStack; \
+        sp = stack + top; \
+        arguments = stack + base; \
+    } while (0)
+
+void execute(struct chunk *chunk){
+    int bottom = session->vmTop;                        // values and frames of the chunks waiting for this one
+    int frameBase = session->frameTop;
+    struct variable *stack = reserveStack(bottom + chunk->maxStack);
+    struct variable *sp = stack + bottom;               // next free element of the stack
+    struct variable *arguments = sp;                    // arguments of the running function
+    const struct chunk *running = chunk;
+    const struct instruction *ip = chunk->code;
+    const struct variable *constants = chunk->constants;
+    symbol_table **slots = loadShared(session->table->slotTable);   // holds every node the chunk refers to
+    struct arena_mark iteration = arenaMark();
+    int depth = 0;                                      // calls running
+    if (jitEnabled && ++chunk->runs == JIT_THRESHOLD){
+        jitChunk(chunk, 0, chunk->length, slots, NULL);     // the formula of a binding, run again and again
+    }
+
+    for (;;){
+        const struct instruction *instruction = ip++;
+    dispatch:
+        switch (instruction->opcode){
+            case OP_CONST:
+                *sp++ = constants[instruction->operand];
+                break;
+            case OP_LOAD: {
+                symbol_table *node = slots[instruction->operand];
+                if (node->dirty){
+                    REFRESH(refreshBinding(node));
+                }
+                *sp++ = nodeValue(node);
+                break;
+            }
+            case OP_PARAM:
+                //shared, so that a concatenation in the body does not extend the argument in place for the next reads
+                *sp++ = shareValue(arguments[instruction->operand]);
+                break;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+                sp--;
+                sp[-1] = BINARY_OPERATION(instruction->opcode - OP_ADD, sp[-1], sp[0]);
+                break;
+            case OP_INC:
+            case OP_DEC:
+                sp[-1] = UNARY_OPERATION(instruction->opcode - OP_INC + INC_OP, sp[-1]);
+                break;
+            case OP_LT:
+            case OP_GT:
+            case OP_LEQ:
+            case OP_GEQ:
+            case OP_EQ:
+            case OP_NEQ:
+                sp--;
+                sp[-1] = truthValue(compareOperation(instruction->opcode - OP_LT + LT_OP, sp[-1], sp[0]));
+                break;
+            case OP_AND:
+                //the condition on the left decides alone when it is false, otherwise the right one is the result
+                if (!asInteger(sp[-1])){
+                    ip = running->code + instruction->operand;
+                } else {
+                    sp--;
+                }
+                break;
+            case OP_OR:
+                if (asInteger(sp[-1])){
+                    ip = running->code + instruction->operand;
+                } else {
+                    sp--;
+                }
+                break;
+            case OP_PRINT_RESULT:
+                printResult(*--sp);
+                break;
+            case OP_PRINT_TRUTH:
+                outPrintf("Result: %s\n", asInteger(*--sp) ? "true" : "false");
+                break;
+            case OP_PRINT_TABLE:
+                REFRESH(refreshAll());
+                printTable();
+                break;
+            case OP_PRINT_NODE: {
+                symbol_table *node = slots[instruction->operand];
+                if (node->dirty){
+                    REFRESH(refreshBinding(node));
+                }
+                printNode(node);
+                break;
+            }
+            case OP_PRINT_TYPE: {
+                symbol_table *node = slots[instruction->operand];
+                if (node->dirty){
+                    REFRESH(refreshBinding(node));
+                }
+                outPrintf("Type of %s: %s",node->id,varType(nodeValue(node)));
+                break;
+            }
+            case OP_PRINT_STATS:
+                printStats(&session->stats);
+                printFunctions();
+                break;
+            case OP_PRINT_STRING:
+                outPrintf("%s\n", stringChars(&constants[instruction->operand]));
+                break;
+            case OP_SAVE_TABLE:
+                REFRESH(refreshAll());     // bound variables are saved with the value of their formula
+                saveSnapshot(stringChars(&constants[instruction->operand]));
+                break;
+            case OP_LOAD_TABLE:
+                loadSnapshot(stringChars(&constants[instruction->operand]));
+                slots = loadShared(session->table->slotTable);     // the nodes it added may have moved it
+                break;
+            case OP_JUMP_IF_FALSE:
+                if (!asInteger(*--sp)){
+                    ip = running->code + instruction->operand;
+                }
+                break;
+            case OP_JUMP:
+                ip = running->code + instruction->operand;
+                break;
+            case OP_LOOP:
+                arenaRelease(iteration);
+                //loops only run in the chunk of a statement, whose OP_LOOP instructions count their iterations
+                if (jitEnabled && running == chunk){
+                    struct instruction *loop = &chunk->code[instruction - chunk->code];
+                    if (loop->arguments < JIT_THRESHOLD && ++loop->arguments == JIT_THRESHOLD){
+                        jitChunk(chunk, instruction->operand, instruction - chunk->code, slots, NULL);
+                    }
+                }
+                ip = running->code + instruction->operand;
+                break;
+            case OP_ASSIGN: {
+                symbol_table *node = slots[instruction->operand];
+                if (node->dirty && instruction->op != ASSIGN_OP){
+                    REFRESH(refreshBinding(node));     // a shorthand starts from the value of the formula
+                }
+                assign(node, instruction->type, instruction->op, *--sp);
+                break;
+            }
+            case OP_UPDATE:
+                updateBinding(slots[instruction->operand], *--sp);
+                break;
+            case OP_DECLARE:
+                declare(slots[instruction->operand], instruction->type);
+                break;
+            case OP_CALL: {
+                //the arguments stay on the stack, where the callee reads them, until it returns
+                struct function *function = &session->functions[instruction->operand];
+                int count = instruction->arguments;
+                sp -= count;
+                function->calls++;
+                session->stats.calls++;
+                if (function->code == NULL){
+                    outPrintf("Error: function %s is not defined!\n", function->name);
+                    *sp++ = undefinedValue();
+                    break;
+                }
+                if (function->arity != count){
+                    outPrintf("Error: function %s takes %i arguments, but %i were given!\n", function->name, function->arity, count);
+                    *sp++ = undefinedValue();
+                    break;
+                }
+                bool memoize = function->pure && function->memoResults != NULL;
+                if (memoize){
+                    if (memoLookup(function, sp, sp)){
+                        sp++;
+                        break;
+                    }
+                }
+                if (jitEnabled && ++function->code->runs == JIT_THRESHOLD){
+                    jitChunk(function->code, 0, function->code->length, slots, sp);
+                }
+                if (depth == MAX_CALL_DEPTH){
+                    outPrintf("Error: more than %i nested calls, %s was not called!\n", MAX_CALL_DEPTH, function->name);
+                    *sp++ = undefinedValue();
+                    break;
+                }
+                if (frameBase + depth == session->frameCapacity){
+                    session->frameCapacity = session->frameCapacity == 0 ? 64 : session->frameCapacity * 2;
+                    session->frames = (struct call_frame *)realloc(session->frames, session->frameCapacity * sizeof(struct call_frame));
+                    countAllocation(session->frameCapacity * sizeof(struct call_frame));
+                    if (session->frames == NULL){
+                        printError("Error: could not allocate memory for the calls!\n");
+                        sessionExit(1);
+                    }
+                }
+                if ((sp - stack) + count + function->code->maxStack > session->vmStackCapacity){
+                    int top = sp - stack;
+                    int base = arguments - stack;
+                    stack = reserveStack(top + count + function->code->maxStack);
+                    sp = stack + top;
+                    arguments = stack + base;
+                }
+                struct call_frame *frame = &session->frames[frameBase + depth++];
+                frame->chunk = running;
+                frame->ip = ip;
+                frame->base = arguments - stack;
+                frame->function = instruction->operand;
+                frame->memoize = memoize;
+                arguments = sp;
+                sp += count;
+                running = function->code;
+                ip = running->code;
+                constants = running->constants;
+                break;
+            }
+            case OP_RETURN: {
+                const struct call_frame *frame = &session->frames[frameBase + --depth];
+                struct variable result = sp[-1];
+                if (frame->memoize){
+                    memoStore(&session->functions[frame->function], arguments, result);
+                }
+                sp = arguments;
+                *sp++ = result;
+                arguments = stack + frame->base;
+                running = frame->chunk;
+                ip = frame->ip;
+                constants = running->constants;
+                break;
+            }
+            case OP_NATIVE: {
+                struct native_fragment *fragment = &running->fragments[instruction->operand];
+                uint64_t bits = fragment->entry(slots, arguments);
+                if (bits != JIT_BAIL){
+                    sp++->bits = bits;
+                    ip = running->code + fragment->end;
+                    session->stats.jitRuns++;
+                    break;
+                }
+                //a guard failed: the bytecode runs instead, from the instruction the fragment replaced
+                session->stats.jitFallbacks++;
+                if (++fragment->failures == JIT_MAX_FAILURES){
+                    running->code[instruction - running->code] = fragment->original;
+                }
+                instruction = &fragment->original;
+                goto dispatch;
+            }
+            case OP_HALT:
+                return;
+            default:
+                printError("Error: unknown instruction %i!\n", instruction->opcode);
+                sessionExit(1);
+        }
+    }
+}
+
+/* folds, compiles and runs a statement built by the parser, then releases the bytecode and resets the statement arena,
+ * which releases the tree and every temporary value at once.
+ * The time spent parsing and running the statement is added to the statistics of the session*/
+void runStatement(struct ast_node *statement){
+    struct stats *stats = &session->stats;
+    int kind = statement->kind;
+    uint64_t start = statsClock();
+    if (stats->statementStart != 0){
+        stats->parseNs += start - stats->statementStart;
+    }
+
+    struct chunk *chunk = compile(foldStatement(statement));
+    execute(chunk);
+    freeChunk(chunk);
+    arenaReset();
+    if (session->readEpoch != 0){
+        beginReading();     // nothing from before the statement is held any longer, see shared-utils.h
+    }
+
+    uint64_t evaluation = statsClock() - start;
+    stats->statements++;
+    stats->evaluationNs += evaluation;
+    recordLatency(&stats->latency[kind], evaluation);
+    stats->statementStart = 0;
+    if (session->interactive){
+        flushOutput();
+    }
+}
+
+/* forgets the chunks that were running, after an unrecoverable error stopped them (see parseInput() in parser.y)*/
+void resetVm(){
+    session->vmTop = 0;
+    session->frameTop = 0;
+    session->walkCount = 0;
+}
+
+// frees the operand stack, when the session ends
+void releaseVm(){
+    free(session->vmStack);
+    session->vmStack = NULL;
+    session->vmStackCapacity = 0;
+}
+
+// conditions are kept on the stack as integers valued 0 or 1
+struct variable truthValue(bool truth){
+    return integerValue(truth);
+}
+
+#endif